@@ -0,0 +1,645 @@
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "WavKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define WAVKERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define WAVKERNELS_TARGET(isa)
+#else
+#define WAVKERNELS_TARGET(isa) __attribute__((target(isa)))
+#endif
+#if defined(__GNUC__) && !defined(__clang__)
+// AVX-512F implies FMA, where GCC would fuse the multiplies and adds of the intrinsics
+#pragma GCC optimize("fp-contract=off")
+// false positives on the _mm512_undefined_*() of GCC's own AVX-512 headers
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#endif
+
+// keeps the scalar versions out of the SIMD ones, where the compiler could contract them into FMAs
+#ifdef _MSC_VER
+#define WAVKERNELS_NOINLINE __declspec(noinline)
+#else
+#define WAVKERNELS_NOINLINE __attribute__((noinline))
+#endif
+
+/*
+Scalar versions, also used for the tails of the SIMD ones. The SIMD versions do
+the same operations in the same order, clamping with min/max in the operand
+order of minps/maxps, so that NaNs come out the same way.
+*/
+
+WAVKERNELS_NOINLINE
+static void s_S16ToF32_Scalar(const int16_t* in, float* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = (float)in[i] / 32767.0f;
+}
+
+WAVKERNELS_NOINLINE
+static void s_F32ToS16_Scalar(const float* in, int16_t* out, size_t count, float amplitude)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float v = in[i] * 32767.0f*amplitude + 0.5f;
+		v = v < 32767.0f ? v : 32767.0f;
+		v = v > -32768.0f ? v : -32768.0f;
+		out[i] = (int16_t)(int32_t)v;
+	}
+}
+
+WAVKERNELS_NOINLINE
+static float s_MaxAbsF32_Scalar(const float* in, size_t count)
+{
+	float maxV = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		float v = in[i] < 0.0f ? -in[i] : in[i];
+		maxV = v > maxV ? v : maxV;
+	}
+	return maxV;
+}
+
+WAVKERNELS_NOINLINE
+static void s_AccumulateF32_Scalar(float* dst, const float* src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i];
+}
+
+WAVKERNELS_NOINLINE
+static void s_MixMonoF32_Scalar(float* dst, const float* src, size_t count, float gain)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] += gain*src[i];
+}
+
+WAVKERNELS_NOINLINE
+static void s_MixStereoF32_Scalar(float* dst, const float* src, size_t frames, const float* m)
+{
+	for (size_t i = 0; i < frames; i++)
+	{
+		float l = src[i * 2];
+		float r = src[i * 2 + 1];
+		dst[i * 2] += m[0] * l + m[1] * r;
+		dst[i * 2 + 1] += m[3] * r + m[2] * l;
+	}
+}
+
+WAVKERNELS_NOINLINE
+static void s_MixMonoToStereoF32_Scalar(float* dst, const float* src, size_t frames, float gainL, float gainR)
+{
+	for (size_t i = 0; i < frames; i++)
+	{
+		dst[i * 2] += gainL*src[i];
+		dst[i * 2 + 1] += gainR*src[i];
+	}
+}
+
+WAVKERNELS_NOINLINE
+static void s_MixStereoToMonoF32_Scalar(float* dst, const float* src, size_t frames, float gain)
+{
+	for (size_t i = 0; i < frames; i++)
+		dst[i] += gain*(src[i * 2] + src[i * 2 + 1]);
+}
+
+// xorshift32 step, then the sum of the two 16-bit halves of the state as a TPDF in (-1, 1)
+static inline float s_DitherStep(uint32_t& x)
+{
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return ((float)(x >> 16) + (float)(x & 0xFFFF)) * (1.0f / 65536.0f) - 1.0f;
+}
+
+WAVKERNELS_NOINLINE
+static void s_QuantizeF32_Scalar(const float* in, int32_t* out, size_t count, float scale, uint32_t* dither)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float v = in[i] * scale;
+		if (dither != nullptr) v = v + s_DitherStep(dither[i % WavDitherLanes]);
+		v = v < scale ? v : scale;
+		v = v > -scale ? v : -scale;
+		out[i] = (int32_t)lrintf(v);
+	}
+}
+
+#ifdef WAVKERNELS_X86
+
+static inline float s_ContinueMaxAbs(float maxV, const float* in, size_t count)
+{
+	float tail = s_MaxAbsF32_Scalar(in, count);
+	return tail > maxV ? tail : maxV;
+}
+
+// SSE2, 4 floats per step
+
+WAVKERNELS_TARGET("sse2")
+static void s_S16ToF32_SSE2(const int16_t* in, float* out, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+		_mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(out + i + 4, _mm_div_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+	s_S16ToF32_Scalar(in + i, out + i, count - i);
+}
+
+WAVKERNELS_TARGET("sse2")
+static void s_F32ToS16_SSE2(const float* in, int16_t* out, size_t count, float amplitude)
+{
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128 amp = _mm_set1_ps(amplitude);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 hiLimit = _mm_set1_ps(32767.0f);
+	const __m128 loLimit = _mm_set1_ps(-32768.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128 a = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), amp), half);
+		__m128 b = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), amp), half);
+		a = _mm_max_ps(_mm_min_ps(a, hiLimit), loLimit);
+		b = _mm_max_ps(_mm_min_ps(b, hiLimit), loLimit);
+		__m128i s = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+		_mm_storeu_si128((__m128i*)(out + i), s);
+	}
+	s_F32ToS16_Scalar(in + i, out + i, count - i, amplitude);
+}
+
+WAVKERNELS_TARGET("sse2")
+static float s_MaxAbsF32_SSE2(const float* in, size_t count)
+{
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 m0 = _mm_setzero_ps();
+	__m128 m1 = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		m0 = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(in + i), absMask), m0);
+		m1 = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(in + i + 4), absMask), m1);
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, _mm_max_ps(m0, m1));
+	float maxV = s_MaxAbsF32_Scalar(lanes, 4);
+	return s_ContinueMaxAbs(maxV, in + i, count - i);
+}
+
+WAVKERNELS_TARGET("sse2")
+static void s_AccumulateF32_SSE2(float* dst, const float* src, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_loadu_ps(src + i + 4)));
+	}
+	s_AccumulateF32_Scalar(dst + i, src + i, count - i);
+}
+
+WAVKERNELS_TARGET("sse2")
+static void s_MixMonoF32_SSE2(float* dst, const float* src, size_t count, float gain)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(g, _mm_loadu_ps(src + i))));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_mul_ps(g, _mm_loadu_ps(src + i + 4))));
+	}
+	s_MixMonoF32_Scalar(dst + i, src + i, count - i, gain);
+}
+
+// (l, r) pairs: direct terms m[0]*l, m[3]*r, then the cross terms of the swapped pairs
+WAVKERNELS_TARGET("sse2")
+static void s_MixStereoF32_SSE2(float* dst, const float* src, size_t frames, const float* m)
+{
+	const __m128 direct = _mm_setr_ps(m[0], m[3], m[0], m[3]);
+	const __m128 cross = _mm_setr_ps(m[1], m[2], m[1], m[2]);
+	size_t i = 0;
+	for (; i + 2 <= frames; i += 2)
+	{
+		__m128 v = _mm_loadu_ps(src + i * 2);
+		__m128 swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 mixed = _mm_add_ps(_mm_mul_ps(direct, v), _mm_mul_ps(cross, swapped));
+		_mm_storeu_ps(dst + i * 2, _mm_add_ps(_mm_loadu_ps(dst + i * 2), mixed));
+	}
+	s_MixStereoF32_Scalar(dst + i * 2, src + i * 2, frames - i, m);
+}
+
+WAVKERNELS_TARGET("sse2")
+static void s_MixMonoToStereoF32_SSE2(float* dst, const float* src, size_t frames, float gainL, float gainR)
+{
+	const __m128 g = _mm_setr_ps(gainL, gainR, gainL, gainR);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(src + i);
+		__m128 lo = _mm_unpacklo_ps(v, v);
+		__m128 hi = _mm_unpackhi_ps(v, v);
+		_mm_storeu_ps(dst + i * 2, _mm_add_ps(_mm_loadu_ps(dst + i * 2), _mm_mul_ps(g, lo)));
+		_mm_storeu_ps(dst + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(dst + i * 2 + 4), _mm_mul_ps(g, hi)));
+	}
+	s_MixMonoToStereoF32_Scalar(dst + i * 2, src + i, frames - i, gainL, gainR);
+}
+
+WAVKERNELS_TARGET("sse2")
+static void s_MixStereoToMonoF32_SSE2(float* dst, const float* src, size_t frames, float gain)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4)
+	{
+		__m128 a = _mm_loadu_ps(src + i * 2);
+		__m128 b = _mm_loadu_ps(src + i * 2 + 4);
+		__m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(g, _mm_add_ps(l, r))));
+	}
+	s_MixStereoToMonoF32_Scalar(dst + i, src + i * 2, frames - i, gain);
+}
+
+WAVKERNELS_TARGET("sse2")
+static inline __m128 s_DitherStep_SSE2(__m128i& x)
+{
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+	__m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(x, 16));
+	__m128 lo = _mm_cvtepi32_ps(_mm_and_si128(x, _mm_set1_epi32(0xFFFF)));
+	return _mm_sub_ps(_mm_mul_ps(_mm_add_ps(hi, lo), _mm_set1_ps(1.0f / 65536.0f)), _mm_set1_ps(1.0f));
+}
+
+// 16 samples per step, one dither state vector per 4 lanes
+WAVKERNELS_TARGET("sse2")
+static void s_QuantizeF32_SSE2(const float* in, int32_t* out, size_t count, float scale, uint32_t* dither)
+{
+	const __m128 hiLimit = _mm_set1_ps(scale);
+	const __m128 loLimit = _mm_set1_ps(-scale);
+	__m128i x[4];
+	for (int k = 0; k < 4; k++)
+		x[k] = dither != nullptr ? _mm_loadu_si128((const __m128i*)(dither + k * 4)) : _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		for (int k = 0; k < 4; k++)
+		{
+			__m128 v = _mm_mul_ps(_mm_loadu_ps(in + i + k * 4), hiLimit);
+			if (dither != nullptr) v = _mm_add_ps(v, s_DitherStep_SSE2(x[k]));
+			v = _mm_max_ps(_mm_min_ps(v, hiLimit), loLimit);
+			_mm_storeu_si128((__m128i*)(out + i + k * 4), _mm_cvtps_epi32(v));
+		}
+	}
+	if (dither != nullptr)
+	{
+		for (int k = 0; k < 4; k++)
+			_mm_storeu_si128((__m128i*)(dither + k * 4), x[k]);
+	}
+	s_QuantizeF32_Scalar(in + i, out + i, count - i, scale, dither);
+}
+
+// AVX2, 8 floats per step
+
+WAVKERNELS_TARGET("avx2")
+static void s_S16ToF32_AVX2(const int16_t* in, float* out, size_t count)
+{
+	const __m256 scale = _mm256_set1_ps(32767.0f);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i + 8)));
+		_mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(lo), scale));
+		_mm256_storeu_ps(out + i + 8, _mm256_div_ps(_mm256_cvtepi32_ps(hi), scale));
+	}
+	s_S16ToF32_Scalar(in + i, out + i, count - i);
+}
+
+WAVKERNELS_TARGET("avx2")
+static void s_F32ToS16_AVX2(const float* in, int16_t* out, size_t count, float amplitude)
+{
+	const __m256 scale = _mm256_set1_ps(32767.0f);
+	const __m256 amp = _mm256_set1_ps(amplitude);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 hiLimit = _mm256_set1_ps(32767.0f);
+	const __m256 loLimit = _mm256_set1_ps(-32768.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 a = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), amp), half);
+		a = _mm256_max_ps(_mm256_min_ps(a, hiLimit), loLimit);
+		__m256i v = _mm256_cvttps_epi32(a);
+		__m128i s = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		_mm_storeu_si128((__m128i*)(out + i), s);
+	}
+	s_F32ToS16_Scalar(in + i, out + i, count - i, amplitude);
+}
+
+WAVKERNELS_TARGET("avx2")
+static float s_MaxAbsF32_AVX2(const float* in, size_t count)
+{
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	__m256 m0 = _mm256_setzero_ps();
+	__m256 m1 = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		m0 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(in + i), absMask), m0);
+		m1 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(in + i + 8), absMask), m1);
+	}
+	float lanes[8];
+	_mm256_storeu_ps(lanes, _mm256_max_ps(m0, m1));
+	float maxV = s_MaxAbsF32_Scalar(lanes, 8);
+	return s_ContinueMaxAbs(maxV, in + i, count - i);
+}
+
+WAVKERNELS_TARGET("avx2")
+static void s_AccumulateF32_AVX2(float* dst, const float* src, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+		_mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), _mm256_loadu_ps(src + i + 8)));
+	}
+	s_AccumulateF32_Scalar(dst + i, src + i, count - i);
+}
+
+WAVKERNELS_TARGET("avx2")
+static void s_MixMonoF32_AVX2(float* dst, const float* src, size_t count, float gain)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(g, _mm256_loadu_ps(src + i))));
+		_mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), _mm256_mul_ps(g, _mm256_loadu_ps(src + i + 8))));
+	}
+	s_MixMonoF32_Scalar(dst + i, src + i, count - i, gain);
+}
+
+WAVKERNELS_TARGET("avx2")
+static void s_MixStereoF32_AVX2(float* dst, const float* src, size_t frames, const float* m)
+{
+	const __m256 direct = _mm256_setr_ps(m[0], m[3], m[0], m[3], m[0], m[3], m[0], m[3]);
+	const __m256 cross = _mm256_setr_ps(m[1], m[2], m[1], m[2], m[1], m[2], m[1], m[2]);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4)
+	{
+		__m256 v = _mm256_loadu_ps(src + i * 2);
+		__m256 swapped = _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1));
+		__m256 mixed = _mm256_add_ps(_mm256_mul_ps(direct, v), _mm256_mul_ps(cross, swapped));
+		_mm256_storeu_ps(dst + i * 2, _mm256_add_ps(_mm256_loadu_ps(dst + i * 2), mixed));
+	}
+	s_MixStereoF32_Scalar(dst + i * 2, src + i * 2, frames - i, m);
+}
+
+WAVKERNELS_TARGET("avx2")
+static void s_MixMonoToStereoF32_AVX2(float* dst, const float* src, size_t frames, float gainL, float gainR)
+{
+	const __m256 g = _mm256_setr_ps(gainL, gainR, gainL, gainR, gainL, gainR, gainL, gainR);
+	const __m256i dup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4)
+	{
+		__m256 v = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + i)), dup);
+		_mm256_storeu_ps(dst + i * 2, _mm256_add_ps(_mm256_loadu_ps(dst + i * 2), _mm256_mul_ps(g, v)));
+	}
+	s_MixMonoToStereoF32_Scalar(dst + i * 2, src + i, frames - i, gainL, gainR);
+}
+
+WAVKERNELS_TARGET("avx2")
+static void s_MixStereoToMonoF32_AVX2(float* dst, const float* src, size_t frames, float gain)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 8 <= frames; i += 8)
+	{
+		// sums of the pairs come out as frames 0 1 4 5 | 2 3 6 7
+		__m256 sums = _mm256_hadd_ps(_mm256_loadu_ps(src + i * 2), _mm256_loadu_ps(src + i * 2 + 8));
+		sums = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums), _MM_SHUFFLE(3, 1, 2, 0)));
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(g, sums)));
+	}
+	s_MixStereoToMonoF32_Scalar(dst + i, src + i * 2, frames - i, gain);
+}
+
+WAVKERNELS_TARGET("avx2")
+static inline __m256 s_DitherStep_AVX2(__m256i& x)
+{
+	x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+	x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+	x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+	__m256 hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(x, 16));
+	__m256 lo = _mm256_cvtepi32_ps(_mm256_and_si256(x, _mm256_set1_epi32(0xFFFF)));
+	return _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(hi, lo), _mm256_set1_ps(1.0f / 65536.0f)), _mm256_set1_ps(1.0f));
+}
+
+WAVKERNELS_TARGET("avx2")
+static void s_QuantizeF32_AVX2(const float* in, int32_t* out, size_t count, float scale, uint32_t* dither)
+{
+	const __m256 hiLimit = _mm256_set1_ps(scale);
+	const __m256 loLimit = _mm256_set1_ps(-scale);
+	__m256i x[2];
+	for (int k = 0; k < 2; k++)
+		x[k] = dither != nullptr ? _mm256_loadu_si256((const __m256i*)(dither + k * 8)) : _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		for (int k = 0; k < 2; k++)
+		{
+			__m256 v = _mm256_mul_ps(_mm256_loadu_ps(in + i + k * 8), hiLimit);
+			if (dither != nullptr) v = _mm256_add_ps(v, s_DitherStep_AVX2(x[k]));
+			v = _mm256_max_ps(_mm256_min_ps(v, hiLimit), loLimit);
+			_mm256_storeu_si256((__m256i*)(out + i + k * 8), _mm256_cvtps_epi32(v));
+		}
+	}
+	if (dither != nullptr)
+	{
+		for (int k = 0; k < 2; k++)
+			_mm256_storeu_si256((__m256i*)(dither + k * 8), x[k]);
+	}
+	s_QuantizeF32_Scalar(in + i, out + i, count - i, scale, dither);
+}
+
+// AVX-512F, 16 floats per step
+
+WAVKERNELS_TARGET("avx512f")
+static void s_S16ToF32_AVX512(const int16_t* in, float* out, size_t count)
+{
+	const __m512 scale = _mm512_set1_ps(32767.0f);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512i v = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)(in + i)));
+		_mm512_storeu_ps(out + i, _mm512_div_ps(_mm512_cvtepi32_ps(v), scale));
+	}
+	s_S16ToF32_Scalar(in + i, out + i, count - i);
+}
+
+WAVKERNELS_TARGET("avx512f")
+static void s_F32ToS16_AVX512(const float* in, int16_t* out, size_t count, float amplitude)
+{
+	const __m512 scale = _mm512_set1_ps(32767.0f);
+	const __m512 amp = _mm512_set1_ps(amplitude);
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512 hiLimit = _mm512_set1_ps(32767.0f);
+	const __m512 loLimit = _mm512_set1_ps(-32768.0f);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512 a = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(_mm512_loadu_ps(in + i), scale), amp), half);
+		a = _mm512_max_ps(_mm512_min_ps(a, hiLimit), loLimit);
+		_mm256_storeu_si256((__m256i*)(out + i), _mm512_cvtsepi32_epi16(_mm512_cvttps_epi32(a)));
+	}
+	s_F32ToS16_Scalar(in + i, out + i, count - i, amplitude);
+}
+
+WAVKERNELS_TARGET("avx512f")
+static float s_MaxAbsF32_AVX512(const float* in, size_t count)
+{
+	__m512 m0 = _mm512_setzero_ps();
+	__m512 m1 = _mm512_setzero_ps();
+	size_t i = 0;
+	for (; i + 32 <= count; i += 32)
+	{
+		m0 = _mm512_max_ps(_mm512_abs_ps(_mm512_loadu_ps(in + i)), m0);
+		m1 = _mm512_max_ps(_mm512_abs_ps(_mm512_loadu_ps(in + i + 16)), m1);
+	}
+	float lanes[16];
+	_mm512_storeu_ps(lanes, _mm512_max_ps(m0, m1));
+	float maxV = s_MaxAbsF32_Scalar(lanes, 16);
+	return s_ContinueMaxAbs(maxV, in + i, count - i);
+}
+
+WAVKERNELS_TARGET("avx512f")
+static void s_AccumulateF32_AVX512(float* dst, const float* src, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+		_mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i), _mm512_loadu_ps(src + i)));
+	s_AccumulateF32_Scalar(dst + i, src + i, count - i);
+}
+
+WAVKERNELS_TARGET("avx512f")
+static void s_MixMonoF32_AVX512(float* dst, const float* src, size_t count, float gain)
+{
+	const __m512 g = _mm512_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+		_mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i), _mm512_mul_ps(g, _mm512_loadu_ps(src + i))));
+	s_MixMonoF32_Scalar(dst + i, src + i, count - i, gain);
+}
+
+WAVKERNELS_TARGET("avx512f")
+static void s_QuantizeF32_AVX512(const float* in, int32_t* out, size_t count, float scale, uint32_t* dither)
+{
+	const __m512 hiLimit = _mm512_set1_ps(scale);
+	const __m512 loLimit = _mm512_set1_ps(-scale);
+	const __m512i lowMask = _mm512_set1_epi32(0xFFFF);
+	const __m512 unit = _mm512_set1_ps(1.0f / 65536.0f);
+	const __m512 one = _mm512_set1_ps(1.0f);
+	__m512i x = dither != nullptr ? _mm512_loadu_si512(dither) : _mm512_setzero_si512();
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512 v = _mm512_mul_ps(_mm512_loadu_ps(in + i), hiLimit);
+		if (dither != nullptr)
+		{
+			x = _mm512_xor_si512(x, _mm512_slli_epi32(x, 13));
+			x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 17));
+			x = _mm512_xor_si512(x, _mm512_slli_epi32(x, 5));
+			__m512 hi = _mm512_cvtepi32_ps(_mm512_srli_epi32(x, 16));
+			__m512 lo = _mm512_cvtepi32_ps(_mm512_and_si512(x, lowMask));
+			v = _mm512_add_ps(v, _mm512_sub_ps(_mm512_mul_ps(_mm512_add_ps(hi, lo), unit), one));
+		}
+		v = _mm512_max_ps(_mm512_min_ps(v, hiLimit), loLimit);
+		_mm512_storeu_si512(out + i, _mm512_cvtps_epi32(v));
+	}
+	if (dither != nullptr) _mm512_storeu_si512(dither, x);
+	s_QuantizeF32_Scalar(in + i, out + i, count - i, scale, dither);
+}
+
+#ifdef _MSC_VER
+static bool s_OSSupportsAVX(bool avx512)
+{
+	int info[4];
+	__cpuid(info, 1);
+	// OSXSAVE and AVX
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+	unsigned long long xcr0 = _xgetbv(0);
+	if ((xcr0 & 0x6) != 0x6) return false;
+	return !avx512 || (xcr0 & 0xE0) == 0xE0;
+}
+
+static bool s_HasAVX2()
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7 || !s_OSSupportsAVX(false)) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+static bool s_HasAVX512F()
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7 || !s_OSSupportsAVX(true)) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 16)) != 0;
+}
+#else
+// also check that the OS saves the wider registers
+static bool s_HasAVX2() { return __builtin_cpu_supports("avx2") != 0; }
+static bool s_HasAVX512F() { return __builtin_cpu_supports("avx512f") != 0; }
+#endif
+
+#endif
+
+// SG_WAVKERNELS=scalar|sse2|avx2 caps the version picked, to compare them
+static WavKernelTable s_SelectWavKernels()
+{
+	WavKernelTable table = { "scalar", s_S16ToF32_Scalar, s_F32ToS16_Scalar, s_MaxAbsF32_Scalar, s_AccumulateF32_Scalar,
+		s_MixMonoF32_Scalar, s_MixStereoF32_Scalar, s_MixMonoToStereoF32_Scalar, s_MixStereoToMonoF32_Scalar, s_QuantizeF32_Scalar };
+#ifdef WAVKERNELS_X86
+	const char* cap = getenv("SG_WAVKERNELS");
+	if (cap == nullptr) cap = "";
+	if (strcmp(cap, "scalar") == 0) return table;
+
+	// SSE2 is part of x86-64, and assumed on 32-bit x86 as well
+	WavKernelTable sse2 = { "sse2", s_S16ToF32_SSE2, s_F32ToS16_SSE2, s_MaxAbsF32_SSE2, s_AccumulateF32_SSE2,
+		s_MixMonoF32_SSE2, s_MixStereoF32_SSE2, s_MixMonoToStereoF32_SSE2, s_MixStereoToMonoF32_SSE2, s_QuantizeF32_SSE2 };
+	table = sse2;
+	if (strcmp(cap, "sse2") == 0) return table;
+
+	if (strcmp(cap, "avx2") != 0 && s_HasAVX512F())
+	{
+		WavKernelTable avx512 = { "avx512", s_S16ToF32_AVX512, s_F32ToS16_AVX512, s_MaxAbsF32_AVX512, s_AccumulateF32_AVX512,
+			s_MixMonoF32_AVX512, s_MixStereoF32_AVX2, s_MixMonoToStereoF32_AVX2, s_MixStereoToMonoF32_AVX2, s_QuantizeF32_AVX512 };
+		table = avx512;
+	}
+	else if (s_HasAVX2())
+	{
+		WavKernelTable avx2 = { "avx2", s_S16ToF32_AVX2, s_F32ToS16_AVX2, s_MaxAbsF32_AVX2, s_AccumulateF32_AVX2,
+			s_MixMonoF32_AVX2, s_MixStereoF32_AVX2, s_MixMonoToStereoF32_AVX2, s_MixStereoToMonoF32_AVX2, s_QuantizeF32_AVX2 };
+		table = avx2;
+	}
+#endif
+	return table;
+}
+
+const WavKernelTable& WavKernels()
+{
+	static const WavKernelTable s_table = s_SelectWavKernels();
+	return s_table;
+}
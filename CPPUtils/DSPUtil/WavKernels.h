@@ -0,0 +1,116 @@
+#ifndef _scoredraft_WavKernels_h
+#define _scoredraft_WavKernels_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Sample conversion and mixing kernels, in scalar, SSE2, AVX2 and AVX-512
+versions. The widest version the CPU supports is picked once, by CPUID, at the
+first use (PyWavUtils does it at import). Every version gives exactly the
+results of the scalar one. Buffers need no particular alignment.
+*/
+struct WavKernelTable
+{
+	const char* isa;
+	// out = in / 32767
+	void(*s16ToF32)(const int16_t* in, float* out, size_t count);
+	// out = trunc(in*32767*amplitude + 0.5), saturated to the 16-bit range
+	void(*f32ToS16)(const float* in, int16_t* out, size_t count, float amplitude);
+	// max of |in|, 0 for no samples, NaNs ignored
+	float(*maxAbsF32)(const float* in, size_t count);
+	// dst += src
+	void(*accumulateF32)(float* dst, const float* src, size_t count);
+	// dst += gain*src
+	void(*mixMonoF32)(float* dst, const float* src, size_t count, float gain);
+	// interleaved stereo frames, (l, r) += m*(l, r), m a row-major 2x2 matrix
+	void(*mixStereoF32)(float* dst, const float* src, size_t frames, const float* m);
+	// mono source into interleaved stereo, (l, r) += (gainL*s, gainR*s)
+	void(*mixMonoToStereoF32)(float* dst, const float* src, size_t frames, float gainL, float gainR);
+	// interleaved stereo source into mono, s += gain*(l + r)
+	void(*mixStereoToMonoF32)(float* dst, const float* src, size_t frames, float gain);
+	/*
+	out = in*scale + d, clamped to [-scale, scale] and rounded to the nearest
+	integer, ties to even. d is a TPDF dither in (-1, 1) from 'dither', the
+	WavDitherLanes xorshift states of DitherInit(), sample i using state
+	i % WavDitherLanes; no dither if nullptr.
+	*/
+	void(*quantizeF32)(const float* in, int32_t* out, size_t count, float scale, uint32_t* dither);
+};
+
+enum { WavDitherLanes = 16 };
+
+const WavKernelTable& WavKernels();
+
+inline void ConvertS16ToF32(const int16_t* in, float* out, size_t count)
+{
+	WavKernels().s16ToF32(in, out, count);
+}
+
+inline void ConvertF32ToS16(const float* in, int16_t* out, size_t count, float amplitude)
+{
+	WavKernels().f32ToS16(in, out, count, amplitude);
+}
+
+inline float MaxAbsF32(const float* in, size_t count)
+{
+	return WavKernels().maxAbsF32(in, count);
+}
+
+inline void AccumulateF32(float* dst, const float* src, size_t count)
+{
+	WavKernels().accumulateF32(dst, src, count);
+}
+
+inline void DitherInit(uint32_t* dither, uint32_t seed)
+{
+	for (unsigned i = 0; i < WavDitherLanes; i++)
+	{
+		// splitmix32 style scrambling, xorshift states must not be 0
+		uint32_t x = seed + 0x9E3779B9u * (i + 1);
+		x = (x ^ (x >> 16)) * 0x85EBCA6Bu;
+		x = (x ^ (x >> 13)) * 0xC2B2AE35u;
+		x ^= x >> 16;
+		dither[i] = x != 0 ? x : 1;
+	}
+}
+
+inline void QuantizeF32(const float* in, int32_t* out, size_t count, float scale, uint32_t* dither)
+{
+	WavKernels().quantizeF32(in, out, count, scale, dither);
+}
+
+/*
+Adds 'frames' frames of src into dst, channel counts being 1 or 2, with the
+gain and panning of TrackBuffer::WriteBlend(): pan in [-1, 1] moves a part of
+one channel into the other (see CalcPan()), a stereo source is averaged into
+a mono destination, where pan is ignored.
+*/
+inline void MixFramesF32(float* dst, unsigned dstChn, const float* src, unsigned srcChn, size_t frames, float gain, float pan)
+{
+	const WavKernelTable& k = WavKernels();
+	if (dstChn == 1)
+	{
+		if (srcChn == 1) k.mixMonoF32(dst, src, frames, gain);
+		else k.mixStereoToMonoF32(dst, src, frames, gain*0.5f);
+		return;
+	}
+
+	float m[4] = { gain, 0.0f, 0.0f, gain };
+	if (pan < 0.0f)
+	{
+		m[1] = -pan*gain;
+		m[3] = (1.0f + pan)*gain;
+	}
+	else if (pan > 0.0f)
+	{
+		m[0] = (1.0f - pan)*gain;
+		m[2] = pan*gain;
+	}
+
+	if (srcChn == 1) k.mixMonoToStereoF32(dst, src, frames, m[0] + m[1], m[2] + m[3]);
+	else if (pan == 0.0f) k.mixMonoF32(dst, src, frames * 2, gain);
+	else k.mixStereoF32(dst, src, frames, m);
+}
+
+#endif
@@ -0,0 +1,75 @@
+#include "fftplan.h"
+#include "fft.h"
+#include <math.h>
+
+FFTPlan::FFTPlan(unsigned l) : m_l(l), m_n(1u << l)
+{
+	m_bitrev.resize(m_n);
+	for (unsigned i = 0; i < m_n; i++)
+	{
+		unsigned r = 0;
+		for (unsigned b = 0; b < l; b++)
+			if (i & (1u << b)) r |= 1u << (l - 1 - b);
+		m_bitrev[i] = r;
+	}
+
+	m_twiddle.resize(m_n / 2 > 0 ? m_n / 2 : 1);
+	for (unsigned k = 0; k < m_n / 2; k++)
+	{
+		double ang = 2.0*PI*(double)k / (double)m_n;
+		m_twiddle[k].Re = cos(ang);
+		m_twiddle[k].Im = -sin(ang);
+	}
+}
+
+void FFTPlan::_transform(DComp *a, double sign) const
+{
+	unsigned n = m_n;
+	for (unsigned i = 0; i < n; i++)
+	{
+		unsigned j = m_bitrev[i];
+		if (i < j)
+		{
+			DComp t = a[i];
+			a[i] = a[j];
+			a[j] = t;
+		}
+	}
+
+	for (unsigned half = 1, stride = n >> 1; half < n; half <<= 1, stride >>= 1)
+	{
+		unsigned le = half << 1;
+		for (unsigned j = 0; j < half; j++)
+		{
+			double wr = m_twiddle[j*stride].Re;
+			double wi = sign*m_twiddle[j*stride].Im;
+			for (unsigned i = j; i < n; i += le)
+			{
+				DComp* p = a + i;
+				DComp* q = p + half;
+				double tr = wr*q->Re - wi*q->Im;
+				double ti = wr*q->Im + wi*q->Re;
+				q->Re = p->Re - tr;
+				q->Im = p->Im - ti;
+				p->Re += tr;
+				p->Im += ti;
+			}
+		}
+	}
+}
+
+void FFTPlan::Forward(DComp *a) const
+{
+	_transform(a, 1.0);
+}
+
+void FFTPlan::Inverse(DComp *a) const
+{
+	_transform(a, -1.0);
+	double scale = 1.0 / (double)m_n;
+	for (unsigned i = 0; i < m_n; i++)
+	{
+		a[i].Re *= scale;
+		a[i].Im *= scale;
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef YF_FFTPLAN
+#define YF_FFTPLAN
+#include <vector>
+#include "complex.h"
+
+/*
+Radix-2 FFT of a fixed size 2^l with precomputed bit-reversal and twiddle tables.
+Same conventions as fft()/ifft(): Inverse() includes the 1/n scaling.
+A plan is read-only after construction and can be shared between threads.
+*/
+class FFTPlan
+{
+public:
+	FFTPlan(unsigned l);
+
+	unsigned Log2Size() const { return m_l; }
+	unsigned Size() const { return m_n; }
+
+	void Forward(DComp *a) const;
+	void Inverse(DComp *a) const;
+
+private:
+	void _transform(DComp *a, double sign) const;
+
+	unsigned m_l;
+	unsigned m_n;
+	std::vector<unsigned> m_bitrev;
+	std::vector<DComp> m_twiddle; // exp(-2*PI*i*k/n), k<n/2
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _scoredraft_FileStat_h
+#define _scoredraft_FileStat_h
+
+#include <string>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// mtime (ns where available) and size of a file, size is 0 for directories
+inline bool StatPath(const std::string& path, int64_t& mtime, int64_t& size, bool& isDir)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(path.c_str(), &st) != 0) return false;
+	mtime = (int64_t)st.st_mtime;
+	isDir = (st.st_mode & _S_IFDIR) != 0;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return false;
+#if defined(__linux__)
+	mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + (int64_t)st.st_mtim.tv_nsec;
+#else
+	mtime = (int64_t)st.st_mtime;
+#endif
+	isDir = S_ISDIR(st.st_mode);
+#endif
+	size = isDir ? 0 : (int64_t)st.st_size;
+	return true;
+}
+
+#endif
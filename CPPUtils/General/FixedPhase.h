@@ -0,0 +1,43 @@
+#ifndef _scoredraft_FixedPhase_h
+#define _scoredraft_FixedPhase_h
+
+#include <stdint.h>
+#include <cmath>
+
+/*
+32.32 fixed-point sample position. Steps are added exactly, so a position
+only carries the rounding of the step itself (below 2^-32 samples), and
+loop lengths, which are whole samples, are subtracted without any drift.
+Signed, so that position - half step can go below 0 at the start.
+*/
+typedef int64_t FixedPhase;
+
+static const FixedPhase FixedPhaseOne = (FixedPhase)1 << 32;
+
+inline FixedPhase ToFixedPhase(double v)
+{
+	return (FixedPhase)llround(v * 4294967296.0);
+}
+
+inline double FixedPhaseToDouble(FixedPhase p)
+{
+	return (double)p * (1.0 / 4294967296.0);
+}
+
+// floor of the position
+inline int FixedPhaseIndex(FixedPhase p)
+{
+	return (int)(p >> 32);
+}
+
+inline int FixedPhaseCeil(FixedPhase p)
+{
+	return (int)((p + FixedPhaseOne - 1) >> 32);
+}
+
+inline float FixedPhaseFrac(FixedPhase p)
+{
+	return (float)(p & 0xFFFFFFFF) * (1.0f / 4294967296.0f);
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef _scoredraft_MappedFile_h
+#define _scoredraft_MappedFile_h
+
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() : m_data(nullptr), m_size(0)
+	{
+#ifdef _WIN32
+		m_hFile = INVALID_HANDLE_VALUE;
+		m_hMap = NULL;
+#endif
+	}
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	bool Open(const char* filename)
+	{
+		Close();
+#ifdef _WIN32
+		m_hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_hFile == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+		m_hMap = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_hMap == NULL)
+		{
+			Close();
+			return false;
+		}
+		m_data = (const unsigned char*)MapViewOfFile(m_hMap, FILE_MAP_READ, 0, 0, 0);
+		if (m_data == nullptr)
+		{
+			Close();
+			return false;
+		}
+		m_size = (size_t)size.QuadPart;
+#else
+		int fd = open(filename, O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+		void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) return false;
+		m_data = (const unsigned char*)p;
+		m_size = (size_t)st.st_size;
+#endif
+		return true;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (m_data != nullptr) UnmapViewOfFile(m_data);
+		if (m_hMap != NULL) CloseHandle(m_hMap);
+		if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+		m_hMap = NULL;
+		m_hFile = INVALID_HANDLE_VALUE;
+#else
+		if (m_data != nullptr) munmap((void*)m_data, m_size);
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	bool IsOpen() const { return m_data != nullptr; }
+	const unsigned char* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+
+	// Hints for a byte range of the mapping. Prefetch starts reading the pages in,
+	// Evict drops the pages lying entirely inside the range, they are read back
+	// from the file on the next access. No-ops on Windows.
+	void Prefetch(const void* p, size_t size) const
+	{
+#ifndef _WIN32
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		size_t begin = (size_t)((const unsigned char*)p - m_data);
+		size_t end = begin + size;
+		begin -= begin % page;
+		if (end > m_size) end = m_size;
+		if (end > begin) madvise((void*)(m_data + begin), end - begin, MADV_WILLNEED);
+#endif
+	}
+
+	void Evict(const void* p, size_t size) const
+	{
+#ifndef _WIN32
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		size_t begin = (size_t)((const unsigned char*)p - m_data);
+		size_t end = begin + size;
+		begin += (page - begin % page) % page;
+		end -= end % page;
+		if (end > begin) madvise((void*)(m_data + begin), end - begin, MADV_DONTNEED);
+#endif
+	}
+
+private:
+	MappedFile(const MappedFile&);
+	void operator=(const MappedFile&);
+
+	const unsigned char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMap;
+#endif
+};
+
+#endif
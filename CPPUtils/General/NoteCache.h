@@ -0,0 +1,256 @@
+#ifndef _scoredraft_NoteCache_h
+#define _scoredraft_NoteCache_h
+
+#include <Python.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+
+inline uint64_t FNV1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// Identity of a rendered note: the engine, the content hash of its samples and
+// every parameter that changes the result, packed as raw bytes.
+class NoteKey
+{
+public:
+	NoteKey(const char* engine) : m_data(engine) { m_data.push_back('\0'); }
+
+	template<class T>
+	NoteKey& Add(const T& v)
+	{
+		m_data.append((const char*)&v, sizeof(T));
+		return *this;
+	}
+
+	const std::string& Data() const { return m_data; }
+
+private:
+	std::string m_data;
+};
+
+struct NoteKeyHash
+{
+	size_t operator()(const std::string& key) const { return (size_t)FNV1a(key.data(), key.size()); }
+};
+
+/*
+Rendered notes, kept as bytes objects with one integer of extra information
+(e.g. the number of samples). Least recently used notes are dropped when the
+byte budget is exceeded. With a disk directory, rendered notes are also written
+there, one file per key, and read back on memory misses.
+Not thread-safe, to be used with the GIL held.
+*/
+class NoteCache
+{
+public:
+	NoteCache() : m_budget((size_t)64 * 1024 * 1024), m_used(0), m_hits(0), m_misses(0) {}
+	~NoteCache() { Clear(); }
+
+	// New reference to the cached bytes, nullptr on miss
+	PyObject* Find(const NoteKey& key, unsigned& aux)
+	{
+		ItemMap::iterator iter = m_map.find(key.Data());
+		if (iter != m_map.end())
+		{
+			m_hits++;
+			m_items.splice(m_items.begin(), m_items, iter->second);
+			aux = iter->second->aux;
+			Py_INCREF(iter->second->data);
+			return iter->second->data;
+		}
+
+		PyObject* data = _readDisk(key.Data(), aux);
+		if (data != nullptr)
+		{
+			m_hits++;
+			_insert(key.Data(), data, aux);
+			return data;
+		}
+		m_misses++;
+		return nullptr;
+	}
+
+	// data must be a bytes object, a new reference is taken
+	void Insert(const NoteKey& key, PyObject* data, unsigned aux)
+	{
+		if (m_map.find(key.Data()) != m_map.end()) return;
+		_insert(key.Data(), data, aux);
+		_writeDisk(key.Data(), data, aux);
+	}
+
+	void SetBudget(size_t bytes)
+	{
+		m_budget = bytes;
+		_trim();
+	}
+
+	// empty string for no disk tier
+	void SetDiskDir(const std::string& dir) { m_diskDir = dir; }
+
+	size_t Budget() const { return m_budget; }
+	size_t Used() const { return m_used; }
+	size_t Count() const { return m_items.size(); }
+	unsigned long long Hits() const { return m_hits; }
+	unsigned long long Misses() const { return m_misses; }
+	const std::string& DiskDir() const { return m_diskDir; }
+
+	void Clear()
+	{
+		while (m_items.size() > 0)
+			_remove(m_items.begin());
+	}
+
+private:
+	NoteCache(const NoteCache&);
+	void operator=(const NoteCache&);
+
+	struct Item
+	{
+		std::string key;
+		PyObject* data;
+		unsigned aux;
+		size_t bytes;
+	};
+	typedef std::list<Item> ItemList;
+	typedef std::unordered_map<std::string, ItemList::iterator, NoteKeyHash> ItemMap;
+
+	void _insert(const std::string& key, PyObject* data, unsigned aux)
+	{
+		size_t bytes = (size_t)PyBytes_Size(data) + key.size();
+		if (bytes > m_budget) return;
+		Item item;
+		item.key = key;
+		item.data = data;
+		item.aux = aux;
+		item.bytes = bytes;
+		Py_INCREF(data);
+		m_items.push_front(item);
+		m_map[key] = m_items.begin();
+		m_used += bytes;
+		_trim();
+	}
+
+	void _remove(ItemList::iterator iter)
+	{
+		m_used -= iter->bytes;
+		Py_DECREF(iter->data);
+		m_map.erase(iter->key);
+		m_items.erase(iter);
+	}
+
+	void _trim()
+	{
+		while (m_used > m_budget && m_items.size() > 0)
+			_remove(--m_items.end());
+	}
+
+	std::string _diskPath(const std::string& key) const
+	{
+		char name[32];
+		sprintf(name, "/%016llx.note", (unsigned long long)FNV1a(key.data(), key.size()));
+		return m_diskDir + name;
+	}
+
+	// file: key length, key, aux, data length, data
+	// any entry that doesn't read back whole is a miss
+	PyObject* _readDisk(const std::string& key, unsigned& aux) const
+	{
+		if (m_diskDir.empty()) return nullptr;
+		FILE* fp = fopen(_diskPath(key).c_str(), "rb");
+		if (fp == nullptr) return nullptr;
+
+		long fileSize = -1;
+		if (fseek(fp, 0, SEEK_END) == 0) fileSize = ftell(fp);
+		if (fileSize < 0 || fseek(fp, 0, SEEK_SET) != 0)
+		{
+			fclose(fp);
+			return nullptr;
+		}
+
+		PyObject* data = nullptr;
+		uint32_t keyLen;
+		uint64_t dataLen;
+		std::string fileKey;
+		if (fread(&keyLen, sizeof(keyLen), 1, fp) == 1 && keyLen == key.size())
+		{
+			fileKey.resize(keyLen);
+			uint32_t fileAux;
+			uint64_t headerLen = sizeof(keyLen) + (uint64_t)keyLen + sizeof(fileAux) + sizeof(dataLen);
+			if (fread(&fileKey[0], 1, keyLen, fp) == keyLen && fileKey == key &&
+				fread(&fileAux, sizeof(fileAux), 1, fp) == 1 && fread(&dataLen, sizeof(dataLen), 1, fp) == 1 &&
+				headerLen + dataLen == (uint64_t)fileSize && dataLen <= (uint64_t)PY_SSIZE_T_MAX)
+			{
+				data = PyBytes_FromStringAndSize(nullptr, (Py_ssize_t)dataLen);
+				if (data == nullptr)
+				{
+					PyErr_Clear();
+				}
+				else if (fread(PyBytes_AsString(data), 1, (size_t)dataLen, fp) != (size_t)dataLen)
+				{
+					Py_DECREF(data);
+					data = nullptr;
+				}
+				else aux = fileAux;
+			}
+		}
+		fclose(fp);
+		return data;
+	}
+
+	// written to a temporary file renamed into place, an interrupted write leaves no entry
+	void _writeDisk(const std::string& key, PyObject* data, unsigned aux) const
+	{
+		if (m_diskDir.empty()) return;
+		std::string path = _diskPath(key);
+		std::string tmpPath = path + ".tmp";
+		FILE* fp = fopen(tmpPath.c_str(), "wb");
+		if (fp == nullptr) return;
+		uint32_t keyLen = (uint32_t)key.size();
+		uint32_t fileAux = aux;
+		uint64_t dataLen = (uint64_t)PyBytes_Size(data);
+		bool ok = fwrite(&keyLen, sizeof(keyLen), 1, fp) == 1;
+		ok = ok && fwrite(key.data(), 1, key.size(), fp) == key.size();
+		ok = ok && fwrite(&fileAux, sizeof(fileAux), 1, fp) == 1;
+		ok = ok && fwrite(&dataLen, sizeof(dataLen), 1, fp) == 1;
+		ok = ok && fwrite(PyBytes_AsString(data), 1, (size_t)dataLen, fp) == (size_t)dataLen;
+		ok = (fclose(fp) == 0) && ok;
+#ifdef _WIN32
+		if (ok) remove(path.c_str());
+#endif
+		if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0)
+			remove(tmpPath.c_str());
+	}
+
+	ItemList m_items; // most recently used first
+	ItemMap m_map;
+	size_t m_budget;
+	size_t m_used;
+	unsigned long long m_hits;
+	unsigned long long m_misses;
+	std::string m_diskDir;
+};
+
+inline PyObject* PackNoteCacheInfo(const NoteCache& cache)
+{
+	PyObject* ret = PyDict_New();
+	PyObject* v;
+	PyDict_SetItemString(ret, "budget", v = PyLong_FromSize_t(cache.Budget())); Py_DECREF(v);
+	PyDict_SetItemString(ret, "used", v = PyLong_FromSize_t(cache.Used())); Py_DECREF(v);
+	PyDict_SetItemString(ret, "count", v = PyLong_FromSize_t(cache.Count())); Py_DECREF(v);
+	PyDict_SetItemString(ret, "hits", v = PyLong_FromUnsignedLongLong(cache.Hits())); Py_DECREF(v);
+	PyDict_SetItemString(ret, "misses", v = PyLong_FromUnsignedLongLong(cache.Misses())); Py_DECREF(v);
+	return ret;
+}
+
+#endif
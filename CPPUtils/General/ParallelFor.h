@@ -0,0 +1,44 @@
+#ifndef _scoredraft_ParallelFor_h
+#define _scoredraft_ParallelFor_h
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+inline unsigned DefaultNumThreads()
+{
+	unsigned n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+// Calls func(i) for i in [0, count) from numThreads worker threads (0 for one per core).
+// Items are handed out one at a time, so uneven items are balanced automatically.
+template<class F>
+void ParallelFor(unsigned count, unsigned numThreads, const F& func)
+{
+	if (numThreads == 0) numThreads = DefaultNumThreads();
+	if (numThreads > count) numThreads = count;
+	if (numThreads <= 1)
+	{
+		for (unsigned i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	std::atomic<unsigned> next(0);
+	auto worker = [&]()
+	{
+		unsigned i;
+		while ((i = next++) < count)
+			func(i);
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < numThreads; i++)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef _scoredraft_WavFile_h
+#define _scoredraft_WavFile_h
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include "WavKernels.h"
+
+#define WAVE_FORMAT_PCM_TAG 1
+#define WAVE_FORMAT_IEEE_FLOAT_TAG 3
+#define WAVE_FORMAT_EXTENSIBLE_TAG 0xFFFE
+
+// Layout of an in-memory .wav image, data points into the image
+struct WavFileInfo
+{
+	unsigned formatTag;
+	unsigned numChannels;
+	unsigned sampleRate;
+	unsigned bitsPerSample;
+	unsigned blockAlign;
+	size_t numFrames;
+	const unsigned char* data;
+	size_t dataSize;
+};
+
+inline uint32_t _wavReadU32(const unsigned char* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint16_t _wavReadU16(const unsigned char* p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// Walks the RIFF chunks, unknown chunks (LIST, fact, cue...) are skipped.
+inline bool ParseWavFile(const unsigned char* buf, size_t size, WavFileInfo& info)
+{
+	memset(&info, 0, sizeof(info));
+	if (size < 12 || memcmp(buf, "RIFF", 4) != 0 || memcmp(buf + 8, "WAVE", 4) != 0) return false;
+
+	bool haveFmt = false;
+	bool haveData = false;
+	size_t pos = 12;
+	while (pos + 8 <= size)
+	{
+		const unsigned char* chunk = buf + pos;
+		size_t chunkSize = _wavReadU32(chunk + 4);
+		size_t avail = size - pos - 8;
+		if (memcmp(chunk, "fmt ", 4) == 0)
+		{
+			if (chunkSize < 16 || chunkSize > avail) return false;
+			info.formatTag = _wavReadU16(chunk + 8);
+			info.numChannels = _wavReadU16(chunk + 10);
+			info.sampleRate = _wavReadU32(chunk + 12);
+			info.blockAlign = _wavReadU16(chunk + 20);
+			info.bitsPerSample = _wavReadU16(chunk + 22);
+			if (info.formatTag == WAVE_FORMAT_EXTENSIBLE_TAG && chunkSize >= 26)
+				info.formatTag = _wavReadU16(chunk + 32);
+			haveFmt = true;
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			// tolerate truncated files, as the wave module does
+			if (chunkSize > avail) chunkSize = avail;
+			info.data = chunk + 8;
+			info.dataSize = chunkSize;
+			haveData = true;
+			break;
+		}
+		pos += 8 + chunkSize + (chunkSize & 1);
+	}
+	if (!haveFmt || !haveData || info.numChannels == 0 || info.blockAlign == 0) return false;
+	info.numFrames = info.dataSize / info.blockAlign;
+	return true;
+}
+
+// 8/16/24/32 bit PCM or 32/64 bit float, packed
+inline bool WavFileFormatSupported(const WavFileInfo& info)
+{
+	unsigned bits = info.bitsPerSample;
+	if (info.formatTag == WAVE_FORMAT_PCM_TAG)
+	{
+		if (bits != 8 && bits != 16 && bits != 24 && bits != 32) return false;
+	}
+	else if (info.formatTag == WAVE_FORMAT_IEEE_FLOAT_TAG)
+	{
+		if (bits != 32 && bits != 64) return false;
+	}
+	else return false;
+	return info.blockAlign == info.numChannels * (bits / 8);
+}
+
+/*
+Decodes numFrames frames from firstFrame on, interleaved, to float. Integer
+samples are scaled as S16ToF32 does, by the largest positive value (8 bit ones
+being unsigned), float ones are copied. Samples are read in place, every
+supported platform being little-endian.
+*/
+inline bool WavFileDecodeF32(const WavFileInfo& info, size_t firstFrame, size_t numFrames, float* out)
+{
+	if (!WavFileFormatSupported(info) || firstFrame + numFrames > info.numFrames) return false;
+	const unsigned char* p = info.data + firstFrame * info.blockAlign;
+	size_t count = numFrames * info.numChannels;
+	if (info.formatTag == WAVE_FORMAT_IEEE_FLOAT_TAG)
+	{
+		if (info.bitsPerSample == 32)
+			memcpy(out, p, count * sizeof(float));
+		else
+			for (size_t i = 0; i < count; i++)
+			{
+				double v;
+				memcpy(&v, p + i * 8, 8);
+				out[i] = (float)v;
+			}
+		return true;
+	}
+	switch (info.bitsPerSample)
+	{
+	case 8:
+		for (size_t i = 0; i < count; i++)
+			out[i] = (float)((int)p[i] - 128) / 127.0f;
+		break;
+	case 16:
+		ConvertS16ToF32((const int16_t*)p, out, count);
+		break;
+	case 24:
+		for (size_t i = 0; i < count; i++, p += 3)
+		{
+			// sign extended from the top byte
+			int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+			out[i] = (float)v / 8388607.0f;
+		}
+		break;
+	case 32:
+		for (size_t i = 0; i < count; i++)
+			out[i] = (float)((double)(int32_t)_wavReadU32(p + i * 4) / 2147483647.0);
+		break;
+	}
+	return true;
+}
+
+inline bool WavFileToF32(const WavFileInfo& info, float* out)
+{
+	return WavFileDecodeF32(info, 0, info.numFrames, out);
+}
+
+#endif
@@ -23,22 +23,17 @@ class Engine_Multi:
 		return sg.InstrumentMultiSample(self.samples, freq, fduration, sampleRate)
 
 def loadWav(file):
-	wavS16=bytes()
-	nChn = 1
-	nFrames = 0
-	framerate = 44100
-	with wave.open(file, mode='rb') as wavFile:
-		nFrames =wavFile.getnframes() 
-		nChn = wavFile.getnchannels()
-		wavS16=wavFile.readframes(nFrames)
-		framerate = wavFile.getframerate()
-
-	sample= {
-		'nframes' : nFrames,
-		'nchannels' : nChn,
-		'frames': sg.S16ToF32(wavS16),
-		'framerate': framerate
-		}
+	sample = sg.LoadWavF32(file)
+	if sample==None:
+		# formats the native reader doesn't handle
+		with wave.open(file, mode='rb') as wavFile:
+			nFrames =wavFile.getnframes()
+			sample= {
+				'nframes' : nFrames,
+				'nchannels' : wavFile.getnchannels(),
+				'frames': sg.S16ToF32(wavFile.readframes(nFrames)),
+				'framerate': wavFile.getframerate()
+				}
 
 	basefreq = 0
 	freq_fn = file[0:len(file)-4]+".freq"
@@ -72,7 +67,7 @@ def GetSamples_Multi(path):
 				fn = path+'/'+item
 				if os.path.isfile(fn) and item.endswith(".wav"):
 					samples+=[loadWav(fn)]
-		Samples_Multi[path] = samples
+		Samples_Multi[path] = sg.SamplerHandle(samples)
 	return Samples_Multi[path]
 
 class InstrumentSampler_Single(Instrument):
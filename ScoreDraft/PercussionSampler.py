@@ -14,22 +14,18 @@ class Engine:
 		return sg.PercussionSample(self.sample, fduration, sampleRate)
 
 def loadWav(file):
-	wavS16=bytes()
-	nChn = 1
-	nFrames = 0
-	framerate = 44100
-	with wave.open(file, mode='rb') as wavFile:
-		nFrames =wavFile.getnframes() 
-		nChn = wavFile.getnchannels()
-		wavS16=wavFile.readframes(nFrames)
-		framerate = wavFile.getframerate()
-
-	return {
-		'nframes' : nFrames,
-		'nchannels' : nChn,
-		'frames': sg.S16ToF32(wavS16),
-		'framerate': framerate
-		}
+	sample = sg.LoadWavF32(file)
+	if sample==None:
+		# formats the native reader doesn't handle
+		with wave.open(file, mode='rb') as wavFile:
+			nFrames =wavFile.getnframes()
+			sample= {
+				'nframes' : nFrames,
+				'nchannels' : wavFile.getnchannels(),
+				'frames': sg.S16ToF32(wavFile.readframes(nFrames)),
+				'framerate': wavFile.getframerate()
+				}
+	return sample
 
 Samples = {}
 
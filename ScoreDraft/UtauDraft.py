@@ -1,4 +1,3 @@
-import wave
 import SingingGadgets as sg
 from .Singer import Singer
 from .Catalog import Catalog
@@ -7,10 +6,7 @@ Catalog['Engines'] += ['UtauDraft - Singing']
 VoiceBanks={}
 
 def loadWav(file):
-	wavS16=bytes()
-	with wave.open(file, mode='rb') as wavFile:
-		wavS16=wavFile.readframes(wavFile.getnframes())
-	return sg.S16ToF32(wavS16)
+	return sg.LoadWavUTAU(file)
 
 def GetVoiceBank(path):
 	if not (path in VoiceBanks):
@@ -138,6 +134,7 @@ class Engine:
 		self.usePrefixMap = True
 		self.pieceMapper = DefaultPieceMapper
 		self.useCUDA = True
+		self.quality = 'full'
 
 	def tune(self, cmd):
 		cmd_split= cmd.split(' ')
@@ -150,6 +147,10 @@ class Engine:
 				elif cmd_split[1]=='off':
 					self.usePrefixMap = False
 					return True
+			elif cmd_len>1 and cmd_split[0]=='quality':
+				if cmd_split[1]=='full' or cmd_split[1]=='draft':
+					self.quality = cmd_split[1]
+					return True
 		return False
 
 	def _convertLyric(self, syllableList):
@@ -265,9 +266,9 @@ class Engine:
 		volume_map += [(0.0, totalDuration)]
 
 		if self.useCUDA:
-			return sg.GenerateSentenceCUDA(sentence)
+			return sg.GenerateSentenceCUDA(sentence, self.quality)
 		else:
-			return sg.GenerateSentence(sentence)
+			return sg.GenerateSentence(sentence, self.quality)
 
 class UtauDraft(Singer):
 	def __init__(self, voiceBank, useCUDA=True):
@@ -282,4 +283,9 @@ class UtauDraft(Singer):
 		self.engine.usePrefixMap=usePrefixMap
 	def setCZMode(self):
 		self.engine.pieceMapper= CZPieceMapper
+	def setQuality(self, quality):
+		'''
+		'full' (default) or 'draft', draft is a fast preview without noise synthesis
+		'''
+		self.engine.quality=quality
 
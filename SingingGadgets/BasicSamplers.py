@@ -1 +1,26 @@
 from .PyBasicSamplers import *
+from . import PyBasicSamplers
+
+class SamplerHandle:
+	'''
+	Native set of samples for InstrumentMultiSample(), built once from a list of
+	sample dicts, so that each note doesn't go through the dicts again.
+	'''
+	def __init__(self, samples):
+		self.id=PyBasicSamplers.CreateSamplerHandle(samples)
+
+	def __del__(self):
+		if hasattr(self, 'id'):
+			PyBasicSamplers.DelSamplerHandle(self.id)
+
+def InstrumentMultiSample(samples, freq, fduration, sampleRate, velocity = 1.0):
+	'''
+	samples: a list of sample dicts or a SamplerHandle
+	A sample dict may have a 'velocity' (0~1, default 1.0): the highest note velocity 
+	its layer is used for. Samples of a layer with the same 'round_robin' group 
+	(an int >= 0) are played in turn, as one zone at the lowest of their pitches.
+	Samples without a group are crossfaded by pitch. 
+	'''
+	if isinstance(samples, SamplerHandle):
+		samples = samples.id
+	return PyBasicSamplers.InstrumentMultiSample(samples, freq, fduration, sampleRate, velocity)
@@ -1,12 +1,15 @@
 #include <Python.h>
 #include <WavBuf.h>
 #include <Sample.h>
+#include <NoteCache.h>
 #include <vector>
+#include <unordered_map>
+#include <cmath>
 #include <stdio.h>
-#include <cstdlib>
 #include "FrequencyDetection.h"
 #include "InstrumentSingleSampler.h"
 #include "InstrumentMultiSampler.h"
+#include "InstrumentSampleSet.h"
 #include "PercussionSampler.h"
 
 static void CreateSample(PyObject *input, Sample& sample)
@@ -39,19 +42,44 @@ static void CreateSample(PyObject *input, Sample& sample)
 	}
 }
 
-static float s_DetectBaseFreq(const Sample& sample)
+// content hash of the frames, kept in the dict like "maxv"
+static uint64_t s_SampleHash(PyObject *input, const Sample& sample)
 {
-	float* localMono = nullptr;
-	float* pSamples = nullptr;
+	PyObject* o_hash = PyDict_GetItemString(input, "hash");
+	if (o_hash)
+		return (uint64_t)PyLong_AsUnsignedLongLong(o_hash);
+
+	uint64_t hash = FNV1a(sample.m_wav_samples, sizeof(float)*sample.m_wav_length*sample.m_chn);
+	hash = FNV1a(&sample.m_chn, sizeof(unsigned), hash);
+	hash = FNV1a(&sample.m_origin_sample_rate, sizeof(unsigned), hash);
+	PyObject* v = PyLong_FromUnsignedLongLong((unsigned long long)hash);
+	PyDict_SetItemString(input, "hash", v);
+	Py_DECREF(v);
+	return hash;
+}
 
-	if (sample.m_chn == 1)
-	{
-		pSamples = sample.m_wav_samples;
-	}
-	else if (sample.m_chn == 2)
+// base frequencies detected so far, by content hash of the sample
+static std::unordered_map<uint64_t, float> s_BaseFreqCache;
+
+static float s_DetectBaseFreq(PyObject *input, const Sample& sample)
+{
+	uint64_t hash = s_SampleHash(input, sample);
+	std::unordered_map<uint64_t, float>::iterator iter = s_BaseFreqCache.find(hash);
+	if (iter != s_BaseFreqCache.end())
+		return iter->second;
+
+	// the frames stay referenced by the caller's dict while the GIL is released
+	PyObject* o_frames = PyDict_GetItemString(input, "frames");
+	Py_INCREF(o_frames);
+
+	float baseFreq;
+	Py_BEGIN_ALLOW_THREADS
+	std::vector<float> localMono;
+	float* pSamples = sample.m_wav_samples;
+	if (sample.m_chn == 2)
 	{
-		localMono = new float[sample.m_wav_length];
-		pSamples = localMono;
+		localMono.resize(sample.m_wav_length);
+		pSamples = localMono.data();
 		for (unsigned i = 0; i < sample.m_wav_length; i++)
 		{
 			localMono[i] = 0.5f*(sample.m_wav_samples[i * 2] + sample.m_wav_samples[i * 2 + 1]);
@@ -60,9 +88,11 @@ static float s_DetectBaseFreq(const Sample& sample)
 	Buffer buf;
 	buf.m_size = sample.m_wav_length;
 	buf.m_data = pSamples;
-	float baseFreq = fetchFrequency(buf, sample.m_origin_sample_rate);
-	delete[] localMono;
+	baseFreq = fetchFrequency(buf, sample.m_origin_sample_rate);
+	Py_END_ALLOW_THREADS
 
+	Py_DECREF(o_frames);
+	s_BaseFreqCache[hash] = baseFreq;
 	return baseFreq;
 }
 
@@ -72,7 +102,7 @@ static void CreateInstrumentSample(PyObject *input, InstrumentSample& sample)
 	PyObject* o_baseFreq = PyDict_GetItemString(input, "basefreq");
 	if (!o_baseFreq)
 	{
-		sample.m_origin_freq = s_DetectBaseFreq(sample);
+		sample.m_origin_freq = s_DetectBaseFreq(input, sample);
 		PyDict_SetItemString(input, "basefreq", PyFloat_FromDouble((double)sample.m_origin_freq));
 	}
 	else
@@ -82,6 +112,60 @@ static void CreateInstrumentSample(PyObject *input, InstrumentSample& sample)
 }
 
 
+// never destroyed, items hold Python objects which must not be released after finalization
+static NoteCache* s_NoteCache = new NoteCache;
+
+static PyObject* NoteCacheSetBudget(PyObject *self, PyObject *args)
+{
+	unsigned long long bytes = PyLong_AsUnsignedLongLong(PyTuple_GetItem(args, 0));
+	s_NoteCache->SetBudget((size_t)bytes);
+	return PyLong_FromLong(0);
+}
+
+static PyObject* NoteCacheSetDiskDir(PyObject *self, PyObject *args)
+{
+	PyObject* o_dir = PyTuple_GetItem(args, 0);
+	std::string dir;
+	if (o_dir != Py_None)
+	{
+		PyObject* bytes = PyUnicode_EncodeFSDefault(o_dir);
+		if (bytes == nullptr) return NULL;
+		dir = std::string(PyBytes_AsString(bytes), (size_t)PyBytes_Size(bytes));
+		Py_DECREF(bytes);
+	}
+	s_NoteCache->SetDiskDir(dir);
+	return PyLong_FromLong(0);
+}
+
+static PyObject* NoteCacheClear(PyObject *self, PyObject *args)
+{
+	s_NoteCache->Clear();
+	return PyLong_FromLong(0);
+}
+
+static PyObject* NoteCacheGetInfo(PyObject *self, PyObject *args)
+{
+	return PackNoteCacheInfo(*s_NoteCache);
+}
+
+static PyObject* s_CachedWavBuf(const NoteKey& key, float sampleRate, unsigned chn)
+{
+	unsigned aux;
+	PyObject* data = s_NoteCache->Find(key, aux);
+	if (data == nullptr) return nullptr;
+	PyWavBuf res;
+	res.SetSampleRate(sampleRate);
+	res.SetNumChannels(chn);
+	PyDict_SetItemString(res.pyWavBuf, "data", data);
+	Py_DECREF(data);
+	return res.pyWavBuf;
+}
+
+static void s_CacheWavBuf(const NoteKey& key, PyWavBuf& res)
+{
+	s_NoteCache->Insert(key, PyDict_GetItemString(res.pyWavBuf, "data"), 0);
+}
+
 static PyObject* DetectBaseFreq(PyObject *self, PyObject *args)
 {
 	PyObject* o_sample = PyTuple_GetItem(args, 0);
@@ -89,7 +173,7 @@ static PyObject* DetectBaseFreq(PyObject *self, PyObject *args)
 	Sample sample;
 	CreateSample(o_sample, sample);
 
-	float baseFreq = s_DetectBaseFreq(sample);
+	float baseFreq = s_DetectBaseFreq(o_sample, sample);
 	PyDict_SetItemString(o_sample, "basefreq", PyFloat_FromDouble((double)baseFreq));
 
 	return PyLong_FromLong(0);
@@ -109,6 +193,11 @@ static PyObject* InstrumentSingleSample(PyObject *self, PyObject *args)
 	ssize_t len = (ssize_t)ceilf(fNumOfSamples);
 	float sampleFreq = freq / sampleRate;
 
+	NoteKey key("InstrumentSingleSample:4");
+	key.Add(s_SampleHash(o_sample, sample)).Add(sample.m_origin_freq).Add(sample.m_max_v).Add(sampleFreq).Add(len);
+	PyObject* cached = s_CachedWavBuf(key, sampleRate, sample.m_chn);
+	if (cached != nullptr) return cached;
+
 	PyWavBuf res;
 	res.SetSampleRate(sampleRate);
 	res.SetNumChannels(sample.m_chn);
@@ -119,55 +208,116 @@ static PyObject* InstrumentSingleSample(PyObject *self, PyObject *args)
 	len /= sample.m_chn;
 
 	InstrumentSingleSample(sample, ptr, (unsigned)len, sampleFreq);
+	s_CacheWavBuf(key, res);
 
 	return res.pyWavBuf;
 }
 
-static int compareSampleWav(const void* a, const void* b)
+typedef std::vector<InstrumentSampleSet_Deferred> InstrumentSampleSetMap;
+static InstrumentSampleSetMap s_InstrumentSampleSetMap;
+
+static bool s_CreateSampleSet(PyObject* sampleList, InstrumentSampleSet& set)
 {
-	InstrumentSample& wavA = *((InstrumentSample*)a);
-	InstrumentSample& wavB = *((InstrumentSample*)b);
+	// base frequency detection releases the GIL, the copy holds the dicts
+	// and 'frames' holds the buffer the sample points into
+	PyObject* samples = PySequence_List(sampleList);
+	if (samples == nullptr) return false;
+	bool ok = true;
+	unsigned num_samples = (unsigned)PyList_GET_SIZE(samples);
+	for (unsigned i = 0; i < num_samples && ok; i++)
+	{
+		PyObject* o_sample = PyList_GET_ITEM(samples, i);
+		PyObject* frames = PyDict_GetItemString(o_sample, "frames");
+		Py_XINCREF(frames);
+		InstrumentSample sample;
+		CreateInstrumentSample(o_sample, sample);
+		PyObject* o_velocity = PyDict_GetItemString(o_sample, "velocity");
+		float velocity = o_velocity ? (float)PyFloat_AsDouble(o_velocity) : 1.0f;
+		PyObject* o_group = PyDict_GetItemString(o_sample, "round_robin");
+		long long group = o_group ? PyLong_AsLongLong(o_group) : -1;
+		if (PyErr_Occurred())
+		{
+			ok = false;
+		}
+		else if (group < -1)
+		{
+			PyErr_SetString(PyExc_ValueError, "round_robin groups must not be negative");
+			ok = false;
+		}
+		else if (!set.Add(sample, frames, s_SampleHash(o_sample, sample), velocity, group))
+		{
+			PyErr_SetString(PyExc_ValueError, "All samples does not have the same number of channels");
+			ok = false;
+		}
+		Py_XDECREF(frames);
+	}
+	Py_DECREF(samples);
+	if (ok) set.Finalize();
+	return ok;
+}
 
-	float origin_SampleFreqA = wavA.m_origin_freq / (float)wavA.m_origin_sample_rate;
-	float origin_SampleFreqB = wavB.m_origin_freq / (float)wavB.m_origin_sample_rate;
+static PyObject* CreateSamplerHandle(PyObject *self, PyObject *args)
+{
+	InstrumentSampleSet_Deferred set;
+	if (!s_CreateSampleSet(PyTuple_GetItem(args, 0), *set))
+		return NULL;
 
-	return origin_SampleFreqA > origin_SampleFreqB ? 1 : -1;
+	unsigned id = (unsigned)s_InstrumentSampleSetMap.size();
+	s_InstrumentSampleSetMap.push_back(set);
+	return PyLong_FromUnsignedLong((unsigned long)(id));
 }
 
-static PyObject* InstrumentMultiSample(PyObject *self, PyObject *args)
+static PyObject* DelSamplerHandle(PyObject *self, PyObject *args)
 {
-	PyObject* sampleList = PyTuple_GetItem(args, 0);
-	unsigned num_samples = (unsigned)PyList_Size(sampleList);
-
-	unsigned chn = 0;
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	s_InstrumentSampleSetMap[id].Abondon();
+	return PyLong_FromLong(0);
+}
 
-	std::vector<InstrumentSample> samples;
-	for (unsigned i = 0; i < num_samples; i++)
+// the first argument is either a handle of CreateSamplerHandle() or a list of samples,
+// the optional 5th argument is the velocity (0~1) selecting the velocity layer
+static PyObject* InstrumentMultiSample(PyObject *self, PyObject *args)
+{
+	PyObject* o_samples = PyTuple_GetItem(args, 0);
+	InstrumentSampleSet_Deferred set;
+	if (PyLong_Check(o_samples))
 	{
-		PyObject* o_sample = PyList_GetItem(sampleList, i);
-		InstrumentSample sample;
-		CreateInstrumentSample(o_sample, sample);
-
-		if (i == 0)
-			chn = sample.m_chn;
-		else
-			if (chn != sample.m_chn)
-			{
-				printf("All samples does not have the same number of channels\n");
-				return nullptr;
-			}
-
-		samples.push_back(sample);
+		set = s_InstrumentSampleSetMap[(unsigned)PyLong_AsUnsignedLong(o_samples)];
+	}
+	else if (!s_CreateSampleSet(o_samples, *set))
+	{
+		return NULL;
 	}
-	std::qsort(samples.data(), samples.size(), sizeof(InstrumentSample), compareSampleWav);
+	unsigned chn = set->NumChannels();
 
 	float freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
 	float fduration = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 2));
 	float sampleRate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 3));
+	float velocity = 1.0f;
+	if (PyTuple_Size(args) > 4)
+		velocity = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 4));
 
 	float fNumOfSamples = fduration*sampleRate*0.001f;
 	ssize_t len = (ssize_t)ceilf(fNumOfSamples);
 	float sampleFreq = freq / sampleRate;
+	if (PyErr_Occurred()) return NULL;
+	// also rejects NaNs, zones are selected by searching their frequencies
+	if (!(sampleFreq > 0.0f) || !std::isfinite(sampleFreq))
+	{
+		PyErr_SetString(PyExc_ValueError, "frequency and sample rate must be positive and finite");
+		return NULL;
+	}
+
+	SampleSelection selection;
+	unsigned ids[2];
+	set->Select(sampleFreq, velocity, selection, ids);
+
+	NoteKey key("InstrumentMultiSample:6");
+	key.Add(set->ContentHash()).Add(sampleFreq).Add(len);
+	for (unsigned i = 0; i < selection.count; i++)
+		key.Add(ids[i]);
+	PyObject* cached = s_CachedWavBuf(key, sampleRate, chn);
+	if (cached != nullptr) return cached;
 
 	PyWavBuf res;
 	res.SetSampleRate(sampleRate);
@@ -178,7 +328,8 @@ static PyObject* InstrumentMultiSample(PyObject *self, PyObject *args)
 	res.GetDataPtrAndLen(ptr, len);
 	len /= chn;
 	
-	InstrumentMultiSample(samples, ptr, (unsigned)len, sampleFreq);
+	InstrumentMultiSample(selection, ptr, (unsigned)len, sampleFreq);
+	s_CacheWavBuf(key, res);
 
 	return res.pyWavBuf;
 }
@@ -194,6 +345,11 @@ static PyObject* PercussionSample(PyObject *self, PyObject *args)
 	float fNumOfSamples = fduration*sampleRate*0.001f;
 	ssize_t len = (ssize_t)ceilf(fNumOfSamples);
 
+	NoteKey key("PercussionSample:4");
+	key.Add(s_SampleHash(o_sample, sample)).Add(sample.m_max_v).Add(sampleRate).Add(len);
+	PyObject* cached = s_CachedWavBuf(key, sampleRate, sample.m_chn);
+	if (cached != nullptr) return cached;
+
 	PyWavBuf res;
 	res.SetSampleRate(sampleRate);
 	res.SetNumChannels(sample.m_chn);
@@ -204,6 +360,7 @@ static PyObject* PercussionSample(PyObject *self, PyObject *args)
 	len /= sample.m_chn;
 
 	PercussionSample(sample, ptr, (unsigned)len, sampleRate / (float)sample.m_origin_sample_rate);
+	s_CacheWavBuf(key, res);
 
 	return res.pyWavBuf;
 }
@@ -222,6 +379,18 @@ static PyMethodDef s_Methods[] = {
 		METH_VARARGS,
 		""
 	},
+	{
+		"CreateSamplerHandle",
+		CreateSamplerHandle,
+		METH_VARARGS,
+		""
+	},
+	{
+		"DelSamplerHandle",
+		DelSamplerHandle,
+		METH_VARARGS,
+		""
+	},
 	{
 		"InstrumentMultiSample",
 		InstrumentMultiSample,
@@ -234,6 +403,30 @@ static PyMethodDef s_Methods[] = {
 		METH_VARARGS,
 		""
 	},
+	{
+		"NoteCacheSetBudget",
+		NoteCacheSetBudget,
+		METH_VARARGS,
+		""
+	},
+	{
+		"NoteCacheSetDiskDir",
+		NoteCacheSetDiskDir,
+		METH_VARARGS,
+		""
+	},
+	{
+		"NoteCacheClear",
+		NoteCacheClear,
+		METH_VARARGS,
+		""
+	},
+	{
+		"NoteCacheGetInfo",
+		NoteCacheGetInfo,
+		METH_VARARGS,
+		""
+	},
 	{ NULL, NULL, 0, NULL }
 };
 
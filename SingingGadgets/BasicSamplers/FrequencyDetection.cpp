@@ -1,170 +1,132 @@
 #include "FrequencyDetection.h"
 #include "fft.h"
-
-#ifndef max
-#define max(a,b)            (((a) > (b)) ? (a) : (b))
-#endif
+#include "fftplan.h"
+#include "ParallelFor.h"
 
 #ifndef min
 #define min(a,b)            (((a) < (b)) ? (a) : (b))
 #endif
 
-class Window
-{
-public:
-	virtual ~Window(){}
-	float m_halfWidth;
-	std::vector<float> m_data;
-
-	void Allocate(float halfWidth)
-	{
-		unsigned u_halfWidth = (unsigned)ceilf(halfWidth);
-		unsigned u_width = u_halfWidth << 1;
-
-		m_halfWidth = halfWidth;
-		m_data.resize(u_width);
-
-		SetZero();
-	}
-
-	void SetZero()
-	{
-		memset(m_data.data(), 0, sizeof(float)*m_data.size());
-	}
-
-	void CreateFromBuffer(const Buffer& src, float center, float halfWidth)
-	{
-		unsigned u_halfWidth = (unsigned)ceilf(halfWidth);
-		unsigned u_width = u_halfWidth << 1;
-
-		m_halfWidth = halfWidth;
-		m_data.resize(u_width);
-
-		SetZero();
+#define HALF_WIN 2048
+#define FFT_LOG 12
 
-		int i_Center = (int)center;
-
-		for (int i = -(int)u_halfWidth; i < (int)u_halfWidth; i++)
-		{
-			float window = (cosf((float)i * (float)PI / halfWidth) + 1.0f)*0.5f;
-
-			int srcIndex = i_Center + i;
-			float v_src = src.GetSample(srcIndex);
-
-			SetSample(i, window* v_src);
-		}
-	}
-
-	void MergeToBuffer(Buffer& buf, float pos)
-	{
-		int ipos = (int)floorf(pos);
-		unsigned u_halfWidth = GetHalfWidthOfData();
-
-		for (int i = max(-(int)u_halfWidth, -ipos); i < (int)u_halfWidth; i++)
-		{
-			int dstIndex = ipos + i;
-			if (dstIndex >= (int)buf.m_size) break;
-			buf.m_data[dstIndex] += GetSample(i);
-		}
-	}
-
-	virtual unsigned GetHalfWidthOfData() const
+struct HannTable
+{
+	float data[HALF_WIN * 2];
+	HannTable()
 	{
-		unsigned u_width = (unsigned)m_data.size();
-		unsigned u_halfWidth = u_width >> 1;
-
-		return u_halfWidth;
+		float halfWidth = (float)HALF_WIN;
+		// the first sample of each window is dropped
+		data[0] = 0.0f;
+		for (int i = -HALF_WIN + 1; i < HALF_WIN; i++)
+			data[i + HALF_WIN] = (cosf((float)i * (float)PI / halfWidth) + 1.0f)*0.5f;
 	}
+};
 
-	virtual float GetSample(int i) const
-	{
-		unsigned u_width = (unsigned)m_data.size();
-		unsigned u_halfWidth = u_width >> 1;
-
-		unsigned pos;
-		if (i >= 0)
-		{
-			if ((unsigned)i > u_halfWidth - 1) return 0.0f;
-			pos = (unsigned)i;
-		}
-		else
-		{
-			if (((int)u_width + i) < (int)u_halfWidth + 1) return 0.0f;
-			pos = u_width - (unsigned)(-i);
-		}
+static const float* Hann()
+{
+	static HannTable s_table;
+	return s_table.data;
+}
 
-		return m_data[pos];
-	}
+static const FFTPlan& Plan()
+{
+	static FFTPlan s_plan(FFT_LOG);
+	return s_plan;
+}
 
-	virtual void SetSample(int i, float v)
+static void fillWindow(const Buffer& buf, int center, const float* hann, DComp* fftData, bool imag)
+{
+	for (int i = 0; i < HALF_WIN * 2; i++)
 	{
-		unsigned u_width = (unsigned)m_data.size();
-		unsigned u_halfWidth = u_width >> 1;
-
-		unsigned pos;
-		if (i >= 0)
-		{
-			if ((unsigned)i > u_halfWidth - 1) return;
-			pos = (unsigned)i;
-		}
-		else
-		{
-			if (((int)u_width + i) < (int)u_halfWidth + 1) return;
-			pos = u_width - (unsigned)(-i);
-		}
-
-		m_data[pos] = v;
+		double v = (double)(hann[i] * buf.GetSample(center - HALF_WIN + i));
+		if (imag) fftData[i].Im = v;
+		else fftData[i].Re = v;
 	}
+}
 
-};
-
-float fetchFrequency(const Buffer& buf, unsigned sampleRate)
+/*
+The power spectra of the windows, centered every HALF_WIN samples, are summed 
+then transformed back to an autocorrelation. 
+Windows are transformed 2 at a time, packed as x + iy into one complex FFT. 
+Batches of window pairs run on the worker threads, each pair into its own 
+slot, then the slots are summed in order, so the result doesn't depend on the 
+number of threads.
+*/
+float fetchFrequency(const Buffer& buf, unsigned sampleRate, unsigned numThreads)
 {
-	unsigned l = 12;
-	unsigned halfWinLen = 1 << (l - 1);
+	const float* hann = Hann();
+	const FFTPlan& plan = Plan();
+	unsigned len = plan.Size();
 
-	float* fft_acc = new float[halfWinLen];
-	memset(fft_acc, 0, sizeof(float)*halfWinLen);
+	unsigned numWindows = (buf.m_size + HALF_WIN - 1) / HALF_WIN;
+	unsigned numPairs = (numWindows + 1) / 2;
+	if (numThreads == 0) numThreads = DefaultNumThreads();
+	unsigned batchSize = numThreads * 4;
 
-	DComp* fftData = new DComp[halfWinLen * 2];
-	fftData[0].Re = 0.0;
-	fftData[0].Im = 0.0;
+	std::vector<double> acc(HALF_WIN + 1, 0.0);
+	std::vector<double> power((size_t)batchSize * 2 * (HALF_WIN + 1));
+	std::vector<std::vector<DComp>> fftData(batchSize, std::vector<DComp>(len));
 
-	for (unsigned center = 0; center < buf.m_size; center += halfWinLen)
+	for (unsigned batchStart = 0; batchStart < numPairs; batchStart += batchSize)
 	{
-		Window win;
-		win.CreateFromBuffer(buf, (float)center, (float)halfWinLen);
+		unsigned count = numPairs - batchStart;
+		if (count > batchSize) count = batchSize;
 
-		for (unsigned i = 1; i<halfWinLen * 2; i++)
+		ParallelFor(count, numThreads, [&](unsigned j)
 		{
-			fftData[i].Re = (double)win.GetSample(i - halfWinLen);
-			fftData[i].Im = 0.0;
-		}
-		fft(fftData, l);
+			unsigned w = (batchStart + j) * 2;
+			bool pair = w + 1 < numWindows;
+			DComp* data = fftData[j].data();
+			memset(data, 0, sizeof(DComp)*len);
+			fillWindow(buf, (int)(w*HALF_WIN), hann, data, false);
+			if (pair) fillWindow(buf, (int)((w + 1)*HALF_WIN), hann, data, true);
+
+			plan.Forward(data);
+
+			// separate the 2 power spectra
+			double* px = &power[(size_t)j * 2 * (HALF_WIN + 1)];
+			double* py = px + HALF_WIN + 1;
+			for (unsigned k = 0; k <= HALF_WIN; k++)
+			{
+				unsigned nk = (len - k) & (len - 1);
+				DComp a = data[k];
+				DComp b = data[nk];
+				double xr = a.Re + b.Re;
+				double xi = a.Im - b.Im;
+				double yr = a.Im + b.Im;
+				double yi = a.Re - b.Re;
+				px[k] = (xr*xr + xi*xi)*0.25;
+				py[k] = pair ? (yr*yr + yi*yi)*0.25 : 0.0;
+			}
+		});
 
-		for (unsigned i = 0; i < halfWinLen; i++)
+		for (unsigned j = 0; j < count; j++)
 		{
-			DComp c = fftData[i];
-			fft_acc[i] += c.Re*c.Re + c.Im*c.Im;
+			const double* p = &power[(size_t)j * 2 * (HALF_WIN + 1)];
+			for (unsigned k = 0; k < 2 * (HALF_WIN + 1); k++)
+				acc[k % (HALF_WIN + 1)] += p[k];
 		}
 	}
 
-	for (unsigned i = 0; i < halfWinLen; i++)
+	// the summed power spectrum is real and even, its inverse transform is the autocorrelation
+	std::vector<DComp> r(len);
+	for (unsigned k = 0; k < len; k++)
 	{
-		fftData[i].Re = (double)fft_acc[i];
-		fftData[i].Im = 0.0;
+		r[k].Re = acc[k <= HALF_WIN ? k : len - k];
+		r[k].Im = 0.0;
 	}
-	ifft(fftData, l);
+	plan.Inverse(r.data());
 
 	unsigned maxi = (unsigned)(-1);
 
-	double lastV = fftData[0].Re;
+	double lastV = r[0].Re;
 	double maxV = 0.0f;
 	bool ascending = false;
 
-	for (unsigned i = sampleRate / 2000; i < min(sampleRate / 30, halfWinLen); i++)
+	for (unsigned i = sampleRate / 2000; i < min(sampleRate / 30, (unsigned)HALF_WIN); i++)
 	{
-		double v = fftData[i].Re;
+		double v = r[i].Re;
 		if (!ascending)
 		{
 			if (v > lastV) ascending = true;
@@ -173,9 +135,9 @@ float fetchFrequency(const Buffer& buf, unsigned sampleRate)
 		{
 			if (v < lastV)
 			{
-				if (fftData[i - 1].Re>maxV)
+				if (r[i - 1].Re>maxV)
 				{
-					maxV = fftData[i - 1].Re;
+					maxV = r[i - 1].Re;
 					maxi = i - 1;
 				}
 				ascending = false;
@@ -186,7 +148,5 @@ float fetchFrequency(const Buffer& buf, unsigned sampleRate)
 
 	float freq = (float)sampleRate / (float)maxi;
 
-	delete[] fft_acc;
-
 	return freq;
 }
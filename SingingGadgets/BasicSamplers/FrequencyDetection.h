@@ -55,6 +55,7 @@ public:
 
 };
 
-float fetchFrequency(const Buffer& buf, unsigned sampleRate);
+// numThreads: 0 for one per core
+float fetchFrequency(const Buffer& buf, unsigned sampleRate, unsigned numThreads = 0);
 
 #endif
@@ -1,9 +1,16 @@
 #ifndef _InstrumentMultiSampler_h
 #define _InstrumentMultiSampler_h
 
-#include <vector>
-
 struct InstrumentSample;
-void InstrumentMultiSample(const std::vector<InstrumentSample>& samples, float* outBuf, unsigned outBufLen, float sampleFreq);
+
+// one sample, or two neighbouring samples crossfaded
+struct SampleSelection
+{
+	const InstrumentSample* samples[2];
+	float weights[2];
+	unsigned count;
+};
+
+void InstrumentMultiSample(const SampleSelection& selection, float* outBuf, unsigned outBufLen, float sampleFreq);
 
 #endif
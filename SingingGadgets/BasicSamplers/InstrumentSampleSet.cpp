@@ -0,0 +1,162 @@
+#include "InstrumentSampleSet.h"
+#include "NoteCache.h"
+#include <cmath>
+#include <algorithm>
+
+static inline float s_relativeFreq(const InstrumentSample& sample)
+{
+	return sample.m_origin_freq / (float)sample.m_origin_sample_rate;
+}
+
+InstrumentSampleSet::InstrumentSampleSet() : m_chn(0), m_contentHash(0)
+{
+
+}
+
+InstrumentSampleSet::~InstrumentSampleSet()
+{
+	for (size_t i = 0; i < m_frames.size(); i++)
+		Py_DECREF(m_frames[i]);
+}
+
+bool InstrumentSampleSet::Add(const InstrumentSample& sample, PyObject* frames, uint64_t hash, float velocity, long long group)
+{
+	if (m_samples.size() == 0)
+		m_chn = sample.m_chn;
+	else if (sample.m_chn != m_chn)
+		return false;
+
+	Py_INCREF(frames);
+	m_samples.push_back(sample);
+	m_hashes.push_back(hash);
+	m_velocities.push_back(velocity);
+	m_groups.push_back(group);
+	m_frames.push_back(frames);
+	return true;
+}
+
+void InstrumentSampleSet::Finalize()
+{
+	// a sample sorts at the frequency of its zone, the lowest one of its round-robin group
+	std::vector<float> zoneFreqs(m_samples.size());
+	for (size_t i = 0; i < m_samples.size(); i++)
+	{
+		zoneFreqs[i] = s_relativeFreq(m_samples[i]);
+		if (m_groups[i] < 0) continue;
+		for (size_t j = 0; j < m_samples.size(); j++)
+		{
+			if (m_groups[j] == m_groups[i] && m_velocities[j] == m_velocities[i])
+				zoneFreqs[i] = std::min(zoneFreqs[i], s_relativeFreq(m_samples[j]));
+		}
+	}
+
+	std::vector<unsigned> order(m_samples.size());
+	for (unsigned i = 0; i < (unsigned)order.size(); i++) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [this, &zoneFreqs](unsigned a, unsigned b)
+	{
+		if (m_velocities[a] != m_velocities[b]) return m_velocities[a] < m_velocities[b];
+		if (zoneFreqs[a] != zoneFreqs[b]) return zoneFreqs[a] < zoneFreqs[b];
+		if (m_groups[a] != m_groups[b]) return m_groups[a] < m_groups[b];
+		return s_relativeFreq(m_samples[a]) < s_relativeFreq(m_samples[b]);
+	});
+
+	std::vector<InstrumentSample> samples(order.size());
+	std::vector<uint64_t> hashes(order.size());
+	std::vector<float> velocities(order.size());
+	std::vector<long long> groups(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		samples[i] = m_samples[order[i]];
+		hashes[i] = m_hashes[order[i]];
+		velocities[i] = m_velocities[order[i]];
+		groups[i] = m_groups[order[i]];
+	}
+	m_samples.swap(samples);
+	m_hashes.swap(hashes);
+	m_velocities.swap(velocities);
+	m_groups.swap(groups);
+
+	m_layers.clear();
+	for (unsigned i = 0; i < (unsigned)m_samples.size(); i++)
+	{
+		if (m_layers.size() == 0 || m_layers.back().velocity != m_velocities[i])
+		{
+			Layer layer;
+			layer.velocity = m_velocities[i];
+			m_layers.push_back(layer);
+		}
+		Layer& layer = m_layers.back();
+		if (layer.zones.size() > 0 && m_groups[i] >= 0 && m_groups[i - 1] == m_groups[i])
+		{
+			layer.zones.back().count++;
+			continue;
+		}
+		Zone zone = { i, 1, 0 };
+		layer.zones.push_back(zone);
+		layer.freqs.push_back(s_relativeFreq(m_samples[i]));
+	}
+	for (size_t i = 0; i < m_layers.size(); i++)
+	{
+		Layer& layer = m_layers[i];
+		layer.logRatios.resize(layer.freqs.size() - 1);
+		for (size_t j = 0; j + 1 < layer.freqs.size(); j++)
+			layer.logRatios[j] = logf(layer.freqs[j + 1] / layer.freqs[j]);
+	}
+
+	uint64_t hash = FNV1a(m_hashes.data(), m_hashes.size() * sizeof(uint64_t));
+	for (size_t i = 0; i < m_samples.size(); i++)
+	{
+		hash = FNV1a(&m_samples[i].m_origin_freq, sizeof(float), hash);
+		hash = FNV1a(&m_samples[i].m_max_v, sizeof(float), hash);
+		hash = FNV1a(&m_velocities[i], sizeof(float), hash);
+		hash = FNV1a(&m_groups[i], sizeof(long long), hash);
+	}
+	m_contentHash = hash;
+}
+
+unsigned InstrumentSampleSet::_pick(Zone& zone)
+{
+	unsigned id = zone.first + zone.next;
+	zone.next = (zone.next + 1) % zone.count;
+	return id;
+}
+
+void InstrumentSampleSet::Select(float sampleFreq, float velocity, SampleSelection& selection, unsigned ids[2])
+{
+	selection.count = 0;
+	if (m_layers.size() < 1) return;
+
+	size_t l = 0;
+	while (l + 1 < m_layers.size() && m_layers[l].velocity < velocity) l++;
+	Layer& layer = m_layers[l];
+
+	// as the linear scan of the samples used to: the first zone at or below the
+	// lowest frequency, the last one at or above the highest, the first of equal ones
+	size_t numZones = layer.freqs.size();
+	size_t upper = std::upper_bound(layer.freqs.begin(), layer.freqs.end(), sampleFreq) - layer.freqs.begin();
+	size_t single = numZones;
+	if (sampleFreq <= layer.freqs[0]) single = 0;
+	else if (sampleFreq >= layer.freqs[numZones - 1]) single = numZones - 1;
+	else if (layer.freqs[upper - 1] == sampleFreq)
+		single = std::lower_bound(layer.freqs.begin(), layer.freqs.end(), sampleFreq) - layer.freqs.begin();
+
+	if (single < numZones)
+	{
+		ids[0] = _pick(layer.zones[single]);
+		selection.samples[0] = &m_samples[ids[0]];
+		selection.weights[0] = 1.0f;
+		selection.count = 1;
+	}
+	else
+	{
+		size_t lower = upper - 1;
+		float k2 = logf(sampleFreq / layer.freqs[lower]) / layer.logRatios[lower];
+		ids[0] = _pick(layer.zones[lower]);
+		ids[1] = _pick(layer.zones[upper]);
+		selection.samples[0] = &m_samples[ids[0]];
+		selection.samples[1] = &m_samples[ids[1]];
+		selection.weights[0] = 1.0f - k2;
+		selection.weights[1] = k2;
+		selection.count = 2;
+	}
+}
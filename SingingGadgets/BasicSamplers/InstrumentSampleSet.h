@@ -0,0 +1,78 @@
+#ifndef _InstrumentSampleSet_h
+#define _InstrumentSampleSet_h
+
+#include <Python.h>
+#include <stdint.h>
+#include <vector>
+#include "Sample.h"
+#include "Deferred.h"
+#include "InstrumentMultiSampler.h"
+
+/*
+Samples of a multi-sampled instrument, built once from the Python sample 
+dicts: "maxv" and "basefreq" resolved, sorted by base frequency relative to
+the sample rate. Frames are used in place, the set keeps their bytes objects 
+alive.
+
+Samples are grouped into velocity layers by their optional "velocity" (the 
+highest note velocity, 0~1, the sample is used for, 1 by default). Within a 
+layer each sample is a zone of its own, unless samples share a "round_robin"
+group: those form one zone, at the lowest of their frequencies, and are played
+in turn. A note selects its layer, then the zones around its frequency by 
+binary search over the sorted zone table, crossfading two zones as before.
+*/
+class InstrumentSampleSet
+{
+public:
+	InstrumentSampleSet();
+	~InstrumentSampleSet();
+
+	// false if the sample doesn't have the same number of channels as the previous ones,
+	// group is the round-robin group of the sample, -1 for none
+	bool Add(const InstrumentSample& sample, PyObject* frames, uint64_t hash, float velocity, long long group);
+
+	// sorts the samples, builds the zone tables and computes the content hash, 
+	// to be called after the last Add()
+	void Finalize();
+
+	// advances the round-robin of the selected zones, 'ids' receives the indices of the selected samples
+	void Select(float sampleFreq, float velocity, SampleSelection& selection, unsigned ids[2]);
+
+	const std::vector<InstrumentSample>& Samples() const { return m_samples; }
+	unsigned NumChannels() const { return m_chn; }
+	uint64_t ContentHash() const { return m_contentHash; }
+
+private:
+	InstrumentSampleSet(const InstrumentSampleSet&);
+	void operator=(const InstrumentSampleSet&);
+
+	struct Zone
+	{
+		unsigned first;
+		unsigned count;
+		unsigned next; // round-robin position
+	};
+
+	struct Layer
+	{
+		float velocity;
+		std::vector<Zone> zones;
+		std::vector<float> freqs; // relative base frequency of each zone, ascending
+		std::vector<float> logRatios; // logf(freqs[i + 1] / freqs[i])
+	};
+
+	unsigned _pick(Zone& zone);
+
+	std::vector<InstrumentSample> m_samples;
+	std::vector<uint64_t> m_hashes;
+	std::vector<float> m_velocities;
+	std::vector<long long> m_groups;
+	std::vector<PyObject*> m_frames;
+	std::vector<Layer> m_layers;
+	unsigned m_chn;
+	uint64_t m_contentHash;
+};
+
+typedef Deferred<InstrumentSampleSet> InstrumentSampleSet_Deferred;
+
+#endif
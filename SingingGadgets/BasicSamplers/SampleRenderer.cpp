@@ -0,0 +1,111 @@
+#include <math.h>
+#include "Sample.h"
+#include "SampleRenderer.h"
+
+template<unsigned CHN>
+static void s_cubicAdd(const float* src, int length, FixedPhase step, float gain, float* outBuf, unsigned numFrames)
+{
+	int ipos[4][SampleBlockSize];
+	float frac[SampleBlockSize];
+	float wave[SampleBlockSize];
+
+	FixedPhase phase = 0;
+	for (unsigned start = 0; start < numFrames; start += SampleBlockSize)
+	{
+		unsigned count = numFrames - start;
+		if (count > SampleBlockSize) count = SampleBlockSize;
+
+		for (unsigned j = 0; j < count; j++, phase += step)
+		{
+			int ipos1 = FixedPhaseIndex(phase);
+			if (ipos1 > length - 1) ipos1 = length - 1;
+			ipos[0][j] = ipos1 > 0 ? ipos1 - 1 : 0;
+			ipos[1][j] = ipos1;
+			ipos[2][j] = ipos1 + 1 < length ? ipos1 + 1 : length - 1;
+			ipos[3][j] = ipos1 + 2 < length ? ipos1 + 2 : length - 1;
+			frac[j] = FixedPhaseFrac(phase);
+		}
+
+		float* out = outBuf + start * CHN;
+		for (unsigned c = 0; c < CHN; c++)
+		{
+			float p[4][SampleBlockSize];
+			for (unsigned k = 0; k < 4; k++)
+				for (unsigned j = 0; j < count; j++)
+					p[k][j] = src[ipos[k][j] * CHN + c];
+
+			for (unsigned j = 0; j < count; j++)
+			{
+				float p0 = p[0][j];
+				float p1 = p[1][j];
+				float p2 = p[2][j];
+				float p3 = p[3][j];
+				float a = -0.5f*p0 + 1.5f*p1 - 1.5f*p2 + 0.5f*p3;
+				float b = p0 - 2.5f*p1 + 2.0f*p2 - 0.5f*p3;
+				float d = -0.5f*p0 + 0.5f*p2;
+				float f = frac[j];
+				wave[j] = ((a*f + b)*f + d)*f + p1;
+			}
+
+			for (unsigned j = 0; j < count; j++)
+				out[j * CHN + c] += gain*wave[j];
+		}
+	}
+}
+
+template<unsigned CHN>
+static void s_boxAdd(const float* src, int length, float num, float den, float gain, float* outBuf, unsigned numFrames)
+{
+	for (unsigned j = 0; j < numFrames; j++)
+	{
+		int ipos1 = (int)ceilf(((float)j - 0.5f)*num / den);
+		int ipos2 = (int)floorf(((float)j + 0.5f)*num / den);
+		if (ipos1 < 0) ipos1 = 0;
+		if (ipos2 >= length) ipos2 = length - 1;
+		float scale = gain / (float)(ipos2 - ipos1 + 1);
+
+		float sum[CHN] = { 0.0f };
+		const float* p = src + ipos1 * CHN;
+		for (int ipos = ipos1; ipos <= ipos2; ipos++, p += CHN)
+			for (unsigned c = 0; c < CHN; c++)
+				sum[c] += p[c];
+
+		for (unsigned c = 0; c < CHN; c++)
+			outBuf[j * CHN + c] += sum[c] * scale;
+	}
+}
+
+void ResampleAdd(const Sample& sample, FixedPhase step, float num, float den, bool interpolation, float gain, float* outBuf, unsigned numFrames)
+{
+	int length = (int)sample.m_wav_length;
+	if (length < 1) return;
+	const float* src = sample.m_wav_samples;
+	if (interpolation)
+	{
+		if (sample.m_chn == 2) s_cubicAdd<2>(src, length, step, gain, outBuf, numFrames);
+		else s_cubicAdd<1>(src, length, step, gain, outBuf, numFrames);
+	}
+	else
+	{
+		if (sample.m_chn == 2) s_boxAdd<2>(src, length, num, den, gain, outBuf, numFrames);
+		else s_boxAdd<1>(src, length, num, den, gain, outBuf, numFrames);
+	}
+}
+
+// exp() is evaluated once per block, then advanced by the constant ratio
+void ApplyFadeOut(float* outBuf, unsigned outBufLen, unsigned chn)
+{
+	double ratio = exp(10.0 / (double)outBufLen);
+	for (unsigned start = 0; start < outBufLen; start += SampleBlockSize)
+	{
+		unsigned end = start + SampleBlockSize;
+		if (end > outBufLen) end = outBufLen;
+		double e = exp(((double)start / (double)outBufLen - 1.0)*10.0);
+		for (unsigned j = start; j < end; j++, e *= ratio)
+		{
+			float amplitude = 1.0f - (float)e;
+			for (unsigned c = 0; c < chn; c++)
+				outBuf[j*chn + c] *= amplitude;
+		}
+	}
+}
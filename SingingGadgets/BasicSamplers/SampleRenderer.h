@@ -0,0 +1,26 @@
+#ifndef _SampleRenderer_h
+#define _SampleRenderer_h
+
+#include "FixedPhase.h"
+
+struct Sample;
+
+/*
+Block renderer shared by the samplers. Output frames are produced in blocks 
+of SampleBlockSize, positions are gathered first, then the interpolation runs 
+over whole blocks, one loop per channel, so that it vectorizes.
+*/
+enum { SampleBlockSize = 16 };
+
+// Adds 'numFrames' frames of the sample, scaled by 'gain', to the interleaved 
+// outBuf. With 'interpolation' the sample is read 'step' source frames apart by
+// cubic interpolation. Otherwise output frame j averages the source frames in 
+// [(j-0.5)*num/den, (j+0.5)*num/den], evaluated in float as the samplers always 
+// did: at integer ratios the rounding of that expression decides whether an 
+// edge frame is counted, so a fixed-point phase would change the output.
+void ResampleAdd(const Sample& sample, FixedPhase step, float num, float den, bool interpolation, float gain, float* outBuf, unsigned numFrames);
+
+// outBuf[j] *= 1 - exp((j / outBufLen - 1) * 10), the fade-out of the samplers
+void ApplyFadeOut(float* outBuf, unsigned outBufLen, unsigned chn);
+
+#endif
@@ -1 +1,11 @@
 from .PyKarplusStrong import *
+from . import PyKarplusStrong
+
+def KarplusStrongGenerateNotes(notes, sampleRate, cut_freq, loop_gain, sustain_gain):
+	'''
+	Renders many plucks of one string model in one call, e.g. a strummed chord.
+	notes -- list of (onset, freq, duration) or (onset, freq, duration, seed), onset and duration in ms, not negative
+	Notes with the same seed and period share their excitation burst.
+	Returns a mono wav buffer starting at onset 0, with every pluck mixed in.
+	'''
+	return PyKarplusStrong.KarplusStrongGenerateNotes(notes, sampleRate, cut_freq, loop_gain, sustain_gain)
@@ -1,18 +1,37 @@
 #include <Python.h>
 #include <WavBuf.h>
 #include "fft.h"
+#include <stdint.h>
 #include <vector>
-#include "Deferred.h"
+#include <algorithm>
+#include "NoteCache.h"
 
-inline float rand01()
+// distinct bursts per period used when no seed is given, notes still vary but bursts get reused
+#define NUM_BURST_VARIANTS 16
+
+// xorshift32, so that a seed always gives the same burst
+struct BurstRandom
 {
-	float f = (float)rand() / (float)RAND_MAX;
-	if (f < 0.0000001f) f = 0.0000001f;
-	if (f > 0.9999999f) f = 0.9999999f;
-	return f;
-}
+	uint32_t state;
+
+	BurstRandom(uint32_t seed) : state(seed * 2654435761u + 0x9E3779B9u)
+	{
+		if (state == 0) state = 1;
+	}
 
-static Deferred<std::vector<float>> GeneratePinkNoise(float period)
+	float rand01()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		float f = (float)(state >> 8) * (1.0f / 16777216.0f);
+		if (f < 0.0000001f) f = 0.0000001f;
+		if (f > 0.9999999f) f = 0.9999999f;
+		return f;
+	}
+};
+
+static void GeneratePinkNoise(float period, uint32_t seed, std::vector<float>& out)
 {
 	unsigned uLen = (unsigned)ceilf(period);
 	unsigned l = 0;
@@ -26,10 +45,11 @@ static Deferred<std::vector<float>> GeneratePinkNoise(float period)
 	std::vector<DComp> fftData(fftLen);
 	memset(&fftData[0], 0, sizeof(DComp)*fftLen);
 
+	BurstRandom random(seed);
 	for (unsigned i = 1; i < (unsigned)(period) / 2; i++)
 	{
 		float amplitude = (float)fftLen / sqrtf((float)i);
-		float phase = rand01()*(float)(2.0*PI);
+		float phase = random.rand01()*(float)(2.0*PI);
 		fftData[i].Re = (double)(amplitude*cosf(phase));
 		fftData[i].Im = (double)(amplitude*sinf(phase));
 
@@ -40,9 +60,7 @@ static Deferred<std::vector<float>> GeneratePinkNoise(float period)
 	ifft(&fftData[0], l);
 
 	unsigned pnLen = (unsigned)ceilf(period*2.0f);
-
-	Deferred<std::vector<float>> ret;
-	ret->resize(pnLen);
+	out.resize(pnLen);
 
 	float rate = (float)fftLen / period;
 	for (unsigned i = 0; i < pnLen; i++)
@@ -59,70 +77,260 @@ static Deferred<std::vector<float>> GeneratePinkNoise(float period)
 			while (_ipos >= fftLen) _ipos -= fftLen;
 			sum += (float)fftData[_ipos].Re;
 		}
-		(*ret)[i] = sum / (float)count;
+		out[i] = sum / (float)count;
 	}
-	return ret;
 }
 
+// never destroyed, items hold Python objects which must not be released after finalization
+static NoteCache* s_BurstCache = new NoteCache;
+
+/*
+Pink noise burst, at least ceil(2*period) samples, as a bytes object (new reference).
+Bursts are cached by seed and by period rounded up to a quarter of a sample,
+the spectrum of the noise does not change audibly within that step.
+*/
+static PyObject* s_GetBurst(float period, uint32_t seed)
+{
+	uint32_t quarters = (uint32_t)ceilf(period*4.0f);
+	NoteKey key("KarplusStrongBurst");
+	key.Add(quarters).Add(seed);
+
+	unsigned len;
+	PyObject* burst = s_BurstCache->Find(key, len);
+	if (burst != nullptr) return burst;
+
+	std::vector<float> noise;
+	GeneratePinkNoise((float)quarters*0.25f, seed, noise);
+	burst = PyBytes_FromStringAndSize((const char*)noise.data(), (ssize_t)(sizeof(float)*noise.size()));
+	s_BurstCache->Insert(key, burst, (unsigned)noise.size());
+	return burst;
+}
+
+static uint32_t s_GetSeed(PyObject *args, ssize_t i)
+{
+	if (PyTuple_Size(args) > i)
+	{
+		PyObject* o_seed = PyTuple_GetItem(args, i);
+		if (o_seed != Py_None)
+			return (uint32_t)PyLong_AsUnsignedLongMask(o_seed);
+	}
+	return (uint32_t)(rand() % NUM_BURST_VARIANTS);
+}
+
+struct PluckParams
+{
+	float sampleRate;
+	float cut_freq;
+	float loop_gain;
+	float sustain_gain;
+};
+
+struct Pluck
+{
+	float period;
+	float fNumOfSamples;
+	float a; // coefficient of the one-pole feedback filter
+	unsigned len;
+	unsigned onset;
+	PyObject* burst;
+};
+
+static void s_InitPluck(Pluck& pluck, const PluckParams& params, float freq, float fduration)
+{
+	float sustain_periods = logf(0.01f) / logf(params.sustain_gain);
+	pluck.fNumOfSamples = fduration*params.sampleRate*0.001f;
+	pluck.period = params.sampleRate / freq;
+	pluck.len = (unsigned)ceilf(pluck.fNumOfSamples + sustain_periods*pluck.period);
+	float cut_freq = params.cut_freq / 261.626f* freq;
+	pluck.a = (float)(1.0 - exp(-2.0*PI* cut_freq / params.sampleRate));
+	pluck.onset = 0;
+	pluck.burst = nullptr;
+}
+
+/*
+Writes pluck.len samples. The excitation is written first, then the delay line
+is run by blocks of ceil(period) - 1 samples: the interpolated references of a
+block all lie in earlier blocks, so the feedback terms of a whole block are
+computed at once, only the one-pole filter runs sample by sample.
+*/
+static void s_RenderPluck(const Pluck& pluck, const PluckParams& params, float* out)
+{
+	float period = pluck.period;
+	unsigned len = pluck.len;
+	const float* noise = (const float*)PyBytes_AsString(pluck.burst);
+
+	unsigned excLen = (unsigned)ceilf(period*2.0f);
+	if (excLen > len) excLen = len;
+	for (unsigned pos = 0; pos < excLen; pos++)
+		out[pos] = noise[pos] * 0.5f*(cosf(((float)pos - period) / period*PI) + 1.0f);
+	for (unsigned pos = excLen; pos < len; pos++)
+		out[pos] = 0.0f;
+
+	// ref(pos) = out[pos - delay]*(1 - frac) + out[pos - delay + 1]*frac
+	unsigned delay = (unsigned)ceilf(period);
+	float frac = (float)delay - period;
+	unsigned blockLen = delay > 1 ? delay - 1 : 1;
+	float loopCoef = params.loop_gain*pluck.a;
+	float sustainCoef = params.sustain_gain*pluck.a;
+	float decay = 1.0f - pluck.a;
+	unsigned sustainStart = (unsigned)ceilf(pluck.fNumOfSamples);
+
+	for (unsigned start = delay; start < len; start += blockLen)
+	{
+		unsigned count = len - start < blockLen ? len - start : blockLen;
+		const float* ref = out + start - delay;
+		float* y = out + start;
+		for (unsigned j = 0; j < count; j++)
+		{
+			float coef = start + j < sustainStart ? loopCoef : sustainCoef;
+			y[j] += coef*(ref[j] * (1.0f - frac) + ref[j + 1] * frac);
+		}
+		for (unsigned j = 0; j < count; j++)
+			y[j] += decay*y[(int)j - 1];
+	}
+}
+
+static bool s_GetParams(PyObject *args, ssize_t first, PluckParams& params)
+{
+	params.sampleRate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, first));
+	params.cut_freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, first + 1));
+	params.loop_gain = (float)PyFloat_AsDouble(PyTuple_GetItem(args, first + 2));
+	params.sustain_gain = (float)PyFloat_AsDouble(PyTuple_GetItem(args, first + 3));
+	return !PyErr_Occurred();
+}
+
+// (freq, duration, sampleRate, cut_freq, loop_gain, sustain_gain[, seed])
 PyObject* KarplusStrongGenerate(PyObject *self, PyObject *args)
 {
 	float freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 0));
 	float fduration = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
-	float sampleRate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 2));
-	float cut_freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 3));
-	float loop_gain = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 4));
-	float sustain_gain = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 5));
-
-	float sustain_periods = logf(0.01f) / logf(sustain_gain);
-	float fNumOfSamples = fduration*sampleRate*0.001f;
+	PluckParams params;
+	if (!s_GetParams(args, 2, params)) return NULL;
+	uint32_t seed = s_GetSeed(args, 6);
+	if (PyErr_Occurred()) return NULL;
 
-	float period = sampleRate / freq;
-	Deferred<std::vector<float>> pinkNoise = GeneratePinkNoise(period);
-
-	float sustainLen = sustain_periods*period;
-	ssize_t totalLen = (ssize_t)ceilf(fNumOfSamples + sustainLen);
+	Pluck pluck;
+	s_InitPluck(pluck, params, freq, fduration);
+	pluck.burst = s_GetBurst(pluck.period, seed);
 
 	PyWavBuf res;
-	res.SetSampleRate(sampleRate);
+	res.SetSampleRate(params.sampleRate);
 	res.SetNumChannels(1);
-	res.Allocate(totalLen);
+	res.Allocate((ssize_t)pluck.len);
 
 	float* ptr;
+	ssize_t totalLen;
 	res.GetDataPtrAndLen(ptr, totalLen);
 
-	cut_freq = cut_freq / 261.626f* freq;
-	float a = (float)(1.0 - exp(-2.0*PI* cut_freq / sampleRate));
+	s_RenderPluck(pluck, params, ptr);
+	Py_DECREF(pluck.burst);
 
-	unsigned pos = 0;
-	while (pos < totalLen)
-	{
-		float value = 0.0f;
-		if ((float)pos < period*2.0f)
-			value += (*pinkNoise)[pos] * 0.5f*(cosf(((float)pos - period) / period*PI) + 1.0f);
-
-		if ((float)pos >= period)
-		{
-			float gain = (float)pos < fNumOfSamples ? loop_gain : sustain_gain;
+	return res.pyWavBuf;
+}
 
-			float refPos = (float)pos - period;
+static double getSeqFloat(PyObject* seq, ssize_t i)
+{
+	PyObject* item = PySequence_GetItem(seq, i);
+	double v = PyFloat_AsDouble(item);
+	Py_XDECREF(item);
+	return v;
+}
 
-			int refPos1 = (int)refPos;
-			int refPos2 = refPos1 + 1;
-			float frac = refPos - (float)refPos1;
+// ([(onset, freq, duration[, seed])...], sampleRate, cut_freq, loop_gain, sustain_gain)
+// onset and duration in ms, all plucks mixed into one mono buffer starting at onset 0
+PyObject* KarplusStrongGenerateNotes(PyObject *self, PyObject *args)
+{
+	PyObject* o_notes = PyTuple_GetItem(args, 0);
+	PluckParams params;
+	if (!s_GetParams(args, 1, params)) return NULL;
 
-			// linear interpolation
-			float ref = ptr[refPos1] * (1.0f - frac) + ptr[refPos2] * frac;
+	ssize_t numNotes = PySequence_Size(o_notes);
+	if (numNotes < 0) return NULL;
 
-			value += gain*a*ref + (1.0f - a)*ptr[pos - 1];
+	std::vector<Pluck> plucks((size_t)numNotes);
+	size_t total = 0;
+	unsigned maxLen = 0;
+	for (ssize_t i = 0; i < numNotes; i++)
+	{
+		PyObject* o_note = PySequence_GetItem(o_notes, i);
+		double onset = getSeqFloat(o_note, 0);
+		double freq = getSeqFloat(o_note, 1);
+		double duration = getSeqFloat(o_note, 2);
+		uint32_t seed;
+		if (PySequence_Size(o_note) > 3)
+		{
+			PyObject* o_seed = PySequence_GetItem(o_note, 3);
+			seed = (uint32_t)PyLong_AsUnsignedLongMask(o_seed);
+			Py_XDECREF(o_seed);
+		}
+		else seed = (uint32_t)(rand() % NUM_BURST_VARIANTS);
+		Py_XDECREF(o_note);
+		if (PyErr_Occurred()) break;
+		// also rejects NaNs, offsets and lengths are unsigned sample counts
+		if (!(onset >= 0.0) || !(duration >= 0.0) || !(freq > 0.0))
+		{
+			PyErr_SetString(PyExc_ValueError, "note onsets and durations must not be negative, frequencies must be positive");
+			break;
+		}
+		if ((onset + duration) * params.sampleRate * 0.001 >= 4294967295.0)
+		{
+			PyErr_SetString(PyExc_ValueError, "note ends beyond the sample range");
+			break;
 		}
 
+		Pluck& pluck = plucks[i];
+		s_InitPluck(pluck, params, (float)freq, (float)duration);
+		// placed as RenderNotesPreset places notes
+		pluck.onset = (unsigned)(onset * params.sampleRate * 0.001 + 0.5);
+		pluck.burst = s_GetBurst(pluck.period, seed);
+		total = std::max(total, (size_t)pluck.onset + pluck.len);
+		maxLen = std::max(maxLen, pluck.len);
+	}
+	if (PyErr_Occurred())
+	{
+		for (size_t i = 0; i < plucks.size(); i++)
+			Py_XDECREF(plucks[i].burst);
+		return NULL;
+	}
+
+	PyWavBuf res;
+	res.SetSampleRate(params.sampleRate);
+	res.SetNumChannels(1);
+	res.Allocate((ssize_t)total);
+
+	float* ptr;
+	ssize_t len;
+	res.GetDataPtrAndLen(ptr, len);
 
-		ptr[pos] = value;
-		pos++;
+	Py_BEGIN_ALLOW_THREADS
+	memset(ptr, 0, sizeof(float)*total);
+	std::vector<float> scratch(maxLen);
+	for (size_t i = 0; i < plucks.size(); i++)
+	{
+		const Pluck& pluck = plucks[i];
+		s_RenderPluck(pluck, params, scratch.data());
+		float* dst = ptr + pluck.onset;
+		for (unsigned j = 0; j < pluck.len; j++)
+			dst[j] += scratch[j];
 	}
+	Py_END_ALLOW_THREADS
+
+	for (size_t i = 0; i < plucks.size(); i++)
+		Py_DECREF(plucks[i].burst);
 
 	return res.pyWavBuf;
+}
+
+static PyObject* KarplusStrongCacheSetBudget(PyObject *self, PyObject *args)
+{
+	unsigned long long bytes = PyLong_AsUnsignedLongLong(PyTuple_GetItem(args, 0));
+	s_BurstCache->SetBudget((size_t)bytes);
+	return PyLong_FromLong(0);
+}
 
+static PyObject* KarplusStrongCacheGetInfo(PyObject *self, PyObject *args)
+{
+	return PackNoteCacheInfo(*s_BurstCache);
 }
 
 static PyMethodDef s_Methods[] = {
@@ -132,6 +340,24 @@ static PyMethodDef s_Methods[] = {
 		METH_VARARGS,
 		""
 	},
+	{
+		"KarplusStrongGenerateNotes",
+		KarplusStrongGenerateNotes,
+		METH_VARARGS,
+		""
+	},
+	{
+		"KarplusStrongCacheSetBudget",
+		KarplusStrongCacheSetBudget,
+		METH_VARARGS,
+		""
+	},
+	{
+		"KarplusStrongCacheGetInfo",
+		KarplusStrongCacheGetInfo,
+		METH_VARARGS,
+		""
+	},
 	{ NULL, NULL, 0, NULL }
 };
 
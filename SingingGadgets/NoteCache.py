@@ -0,0 +1,35 @@
+import os
+from . import PySF2Synth
+from . import PyBasicSamplers
+
+# Rendered notes of the SF2 presets and of the basic samplers are cached by the 
+# content of their samples and the note parameters. Each of the 2 engines has its
+# own memory budget.
+_modules = {'SF2': PySF2Synth, 'BasicSamplers': PyBasicSamplers}
+
+def SetNoteCacheBudget(numBytes):
+	'''
+	Memory budget in bytes of each engine, 0 to disable caching
+	'''
+	for m in _modules.values():
+		m.NoteCacheSetBudget(numBytes)
+
+def SetNoteCacheDir(path):
+	'''
+	Directory of the disk tier, rendered notes are written there and read back 
+	in later runs. None to disable.
+	'''
+	if path!=None:
+		os.makedirs(path, exist_ok=True)
+	for m in _modules.values():
+		m.NoteCacheSetDiskDir(path)
+
+def ClearNoteCache():
+	for m in _modules.values():
+		m.NoteCacheClear()
+
+def NoteCacheInfo():
+	'''
+	Returns {engine: {budget, used, count, hits, misses}}
+	'''
+	return dict((name, m.NoteCacheGetInfo()) for name, m in _modules.items())
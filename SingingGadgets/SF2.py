@@ -1,6 +1,7 @@
 #!/usr/bin/python3
 import struct
 from .PyWavUtils import S16ToF32
+from . import PySF2Synth
 
 def decode_string(with_zero):
 	i=0
@@ -149,4 +150,61 @@ def LoadSF2(fn):
 
 
 
+class SF2Bank:
+	'''
+	SoundFont 2 bank loaded by the native module. The file is memory-mapped and
+	the 16-bit sample pool is used in place, so the pages are shared by all
+	processes using the same file. Presets are built natively, in the same order
+	and layout as LoadPresets().
+	'''
+	def __init__(self, fn):
+		self.id=PySF2Synth.SF2BankLoad(fn)
+		self.presetList=PySF2Synth.SF2BankGetPresetList(self.id)
+		self.f32Samples=None
+
+	def __del__(self):
+		if hasattr(self, 'id'):
+			PySF2Synth.SF2BankDel(self.id)
+
+	def numPresets(self):
+		return len(self.presetList)
+
+	def getPreset(self, i):
+		return PySF2Synth.SF2BankGetPreset(self.id, i)
+
+	def getSamples(self):
+		'''
+		int16 memoryview of the mapped sample pool, which stays mapped as long as
+		the view is alive
+		'''
+		return PySF2Synth.SF2BankGetSamples(self.id).cast('h')
+
+	def getF32Samples(self):
+		'''
+		The sample pool converted to float32 bytes, same as LoadSF2(fn)[1].
+		Converted at the first call.
+		'''
+		if self.f32Samples==None:
+			self.f32Samples=PySF2Synth.SF2BankGetF32Samples(self.id)
+		return self.f32Samples
+
+	def setResidencyBudget(self, budget = None):
+		'''
+		Bytes of sample data kept in memory for presets no longer in use.
+		Sample ranges are brought in when a preset using them is compiled, and
+		the least recently released ones are evicted beyond the budget.
+		None for no limit (the default).
+		'''
+		if budget==None:
+			budget = (1<<64)-1
+		PySF2Synth.SF2BankSetResidencyBudget(self.id, budget)
+
+	def residencyInfo(self):
+		'''
+		dict of 'budget', 'resident' (bytes), 'ranges' (resident sample ranges) 
+		and 'pinned' (ranges used by living presets)
+		'''
+		return PySF2Synth.SF2BankResidencyInfo(self.id)
+
+
 #sf2= LoadSF2('florestan-subset.sf2')	
@@ -1,6 +1,9 @@
 import math
 from .PyWavUtils import MixF32
 from .PySF2Synth import SynthRegion
+from .PySF2Synth import SynthRegionSF2Bank
+from . import PySF2Synth
+from .SF2 import SF2Bank
 
 # Output Modes
 # Two channels with single left/right samples one after another
@@ -11,7 +14,66 @@ STEREO_UNWEAVED = 1
 MONO = 2
 
 
+class SF2Preset:
+	'''
+	A preset compiled into native region arrays with a 128x128 key/velocity lookup table.
+	source -- a SF2Bank, then preset is the preset index in the bank, or
+	          a float32 sample pool, then preset is a preset dict from LoadPresets()
+	'''
+	def __init__(self, source, preset):
+		if isinstance(source, SF2Bank):
+			self.id=PySF2Synth.SF2PresetCompileBank(source.id, preset)
+			info=source.presetList[preset]
+		else:
+			self.id=PySF2Synth.SF2PresetCompile(source, preset)
+			info=preset
+		self.presetName=info['presetName']
+		self.bank=info['bank']
+		self.preset=info['preset']
+
+	def __del__(self):
+		if hasattr(self, 'id'):
+			PySF2Synth.SF2PresetDel(self.id)
+
+	def synthNote(self, key, vel, numSamples, outputmode = STEREO_INTERLEAVED, samplerate = 44100.0, global_gain_db = 0.0):
+		return PySF2Synth.SynthNotePreset(self.id, key, vel, int(numSamples), outputmode, samplerate, global_gain_db)
+
+	def renderNotes(self, notes, outputmode = STEREO_INTERLEAVED, samplerate = 44100.0, global_gain_db = 0.0, threads = 0):
+		'''
+		notes -- list of (onset, key, vel, duration), onset and duration in ms, not negative
+		threads -- number of rendering threads, 0 for one per core
+		Returns (numSamples, buffer or None), the buffer starting at onset 0.
+		'''
+		return PySF2Synth.RenderNotesPreset(self.id, notes, outputmode, samplerate, global_gain_db, threads)
+
+
+def RenderNotes(preset, notes, output_track, global_gain_db = 0.0, volume = 1.0, pan = 0.0, threads = 0):
+	'''
+	Renders a list of (onset, key, vel, duration) notes of a SF2Preset in one call and blends them
+	into output_track, onsets being relative to the cursor of the track, which is not moved.
+	Onset and duration are in ms.
+	'''
+	samplerate = output_track.getSampleRate()
+	(numSamples, data) = preset.renderNotes(notes, STEREO_INTERLEAVED, samplerate, global_gain_db, threads)
+	if numSamples > 0:
+		output_track.writeBlend({
+			'sample_rate': samplerate,
+			'num_channels': 2,
+			'data': data,
+			'align_pos': 0,
+			'volume': volume,
+			'pan': pan
+		})
+
+
 def SynthNote(inputSamples, preset, key, vel, numSamples, outputmode = STEREO_INTERLEAVED, samplerate = 44100.0, global_gain_db = 0.0):
+	'''
+	inputSamples -- float32 sample pool (bytes), or a SF2Bank whose 16/24-bit samples are read in place
+	preset -- preset dict, or a SF2Preset, which ignores inputSamples
+	'''
+	if isinstance(preset, SF2Preset):
+		return preset.synthNote(key, vel, numSamples, outputmode, samplerate, global_gain_db)
+
 	ikey=int(key+0.5)
 	midiVelocity = int(vel*127)
 	bufs = []
@@ -25,7 +87,10 @@ def SynthNote(inputSamples, preset, key, vel, numSamples, outputmode = STEREO_IN
 		if ikey < region['lokey'] or ikey > region['hikey'] or midiVelocity < region['lovel'] or midiVelocity > region['hivel']:
 			continue
 
-		res=SynthRegion(inputSamples, region, key, vel, int(numSamples), outputmode, samplerate, global_gain_db)
+		if isinstance(inputSamples, SF2Bank):
+			res=SynthRegionSF2Bank(inputSamples.id, region, key, vel, int(numSamples), outputmode, samplerate, global_gain_db)
+		else:
+			res=SynthRegion(inputSamples, region, key, vel, int(numSamples), outputmode, samplerate, global_gain_db)
 		bufs+=[res]
 		region_numSamples = len(res)/4/chn
 		if region_numSamples>max_numSamples:
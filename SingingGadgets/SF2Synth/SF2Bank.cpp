@@ -0,0 +1,635 @@
+#include "SF2Bank.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+static inline uint32_t _readU32(const unsigned char* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t _readU16(const unsigned char* p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static std::string _decodeString(const unsigned char* p, size_t maxLen)
+{
+	size_t i = 0;
+	while (i < maxLen && p[i] != 0 && p[i] < 128) i++;
+	return std::string((const char*)p, i);
+}
+
+struct HydraPhdr
+{
+	std::string presetName;
+	uint16_t preset, bank, presetBagNdx;
+};
+
+struct HydraBag
+{
+	uint16_t genNdx, modNdx;
+};
+
+struct HydraGen
+{
+	uint16_t genOper;
+	unsigned char amount[2];
+
+	int Short() const { return (int)(int16_t)_readU16(amount); }
+	unsigned Word() const { return _readU16(amount); }
+	int Lo() const { return amount[0]; }
+	int Hi() const { return amount[1]; }
+};
+
+struct HydraInst
+{
+	uint16_t instBagNdx;
+};
+
+struct HydraShdr
+{
+	uint32_t start, end, startLoop, endLoop, sampleRate;
+	uint8_t originalPitch;
+	int8_t pitchCorrection;
+	uint16_t sampleLink, sampleType;
+};
+
+enum
+{
+	GenInstrument = 41,
+	GenKeyRange = 43,
+	GenVelRange = 44,
+	GenSampleID = 53
+};
+
+static void EnvelopeClear(tsf_envelope& env, bool forRelative)
+{
+	float t = forRelative ? 0.0f : -12000.0f;
+	env.delay = t;
+	env.attack = t;
+	env.hold = t;
+	env.decay = t;
+	env.sustain = 0.0f;
+	env.release = t;
+	env.keynumToHold = 0.0f;
+	env.keynumToDecay = 0.0f;
+}
+
+static void RegionClear(tsf_region& region, bool forRelative)
+{
+	region.loop_mode = TSF_LOOPMODE_NONE;
+	region.sample_rate = 0;
+	region.lokey = 0;
+	region.hikey = 127;
+	region.lovel = 0;
+	region.hivel = 127;
+	region.group = 0;
+	region.offset = 0;
+	region.end = 0;
+	region.loop_start = 0;
+	region.loop_end = 0;
+	region.transpose = 0;
+	region.tune = 0;
+	region.pitch_keycenter = forRelative ? 60 : -1;
+	region.pitch_keytrack = forRelative ? 0 : 100;
+	region.attenuation = 0.0f;
+	region.pan = 0.0f;
+	EnvelopeClear(region.ampenv, forRelative);
+	EnvelopeClear(region.modenv, forRelative);
+	region.initialFilterQ = 0;
+	region.initialFilterFc = forRelative ? 0 : 13500;
+	region.modEnvToPitch = 0;
+	region.modEnvToFilterFc = 0;
+	region.modLfoToFilterFc = 0;
+	region.modLfoToVolume = 0;
+	region.delayModLFO = forRelative ? 0.0f : -12000.0f;
+	region.freqModLFO = 0;
+	region.modLfoToPitch = 0;
+	region.delayVibLFO = forRelative ? 0.0f : -12000.0f;
+	region.freqVibLFO = 0;
+	region.vibLfoToPitch = 0;
+}
+
+static float TimeCents2Sec(double timecents)
+{
+	return (float)pow(2.0, timecents / 1200.0);
+}
+
+static void RegionEnvtosecs(tsf_envelope& env, bool sustainIsGain)
+{
+	// EG times need to be converted from timecents to seconds.
+	// Pin very short EG segments.  Timecents don't get to zero, and our EG is
+	// happier with zero values.
+	env.delay = env.delay < -11950.0f ? 0.0f : TimeCents2Sec(env.delay);
+	env.attack = env.attack < -11950.0f ? 0.0f : TimeCents2Sec(env.attack);
+	env.release = env.release < -11950.0f ? 0.0f : TimeCents2Sec(env.release);
+
+	// If we have dynamic hold or decay times depending on key number we need
+	// to keep the values in timecents so we can calculate it during startNote
+	if (env.keynumToHold == 0.0f) env.hold = env.hold < -11950.0f ? 0.0f : TimeCents2Sec(env.hold);
+	if (env.keynumToDecay == 0.0f) env.decay = env.decay < -11950.0f ? 0.0f : TimeCents2Sec(env.decay);
+
+	if (env.sustain < 0.0f) env.sustain = 0.0f;
+	else if (sustainIsGain)
+	{
+		double db = -(double)env.sustain / 10.0;
+		env.sustain = db > -100.0 ? (float)pow(10.0, db*0.05) : 0.0f;
+	}
+	else env.sustain = (float)(1.0 - (double)env.sustain / 1000.0);
+}
+
+static void RegionOperator(tsf_region& region, const HydraGen& gen)
+{
+	switch (gen.genOper)
+	{
+	case 0: region.offset += gen.Short(); break;
+	case 1: region.end += gen.Short(); break;
+	case 2: region.loop_start += gen.Short(); break;
+	case 3: region.loop_end += gen.Short(); break;
+	case 4: region.offset += gen.Short() * 32768; break;
+	case 5: region.modLfoToPitch = gen.Short(); break;
+	case 6: region.vibLfoToPitch = gen.Short(); break;
+	case 7: region.modEnvToPitch = gen.Short(); break;
+	case 8: region.initialFilterFc = gen.Short(); break;
+	case 9: region.initialFilterQ = gen.Short(); break;
+	case 10: region.modLfoToFilterFc = gen.Short(); break;
+	case 11: region.modEnvToFilterFc = gen.Short(); break;
+	case 12: region.end += gen.Short() * 32768; break;
+	case 13: region.modLfoToVolume = gen.Short(); break;
+	case 17: region.pan = (float)(gen.Short() / 1000.0); break;
+	case 21: region.delayModLFO = (float)gen.Short(); break;
+	case 22: region.freqModLFO = gen.Short(); break;
+	case 23: region.delayVibLFO = (float)gen.Short(); break;
+	case 24: region.freqVibLFO = gen.Short(); break;
+	case 25: region.modenv.delay = (float)gen.Short(); break;
+	case 26: region.modenv.attack = (float)gen.Short(); break;
+	case 27: region.modenv.hold = (float)gen.Short(); break;
+	case 28: region.modenv.decay = (float)gen.Short(); break;
+	case 29: region.modenv.sustain = (float)gen.Short(); break;
+	case 30: region.modenv.release = (float)gen.Short(); break;
+	case 31: region.modenv.keynumToHold = (float)gen.Short(); break;
+	case 32: region.modenv.keynumToDecay = (float)gen.Short(); break;
+	case 33: region.ampenv.delay = (float)gen.Short(); break;
+	case 34: region.ampenv.attack = (float)gen.Short(); break;
+	case 35: region.ampenv.hold = (float)gen.Short(); break;
+	case 36: region.ampenv.decay = (float)gen.Short(); break;
+	case 37: region.ampenv.sustain = (float)gen.Short(); break;
+	case 38: region.ampenv.release = (float)gen.Short(); break;
+	case 39: region.ampenv.keynumToHold = (float)gen.Short(); break;
+	case 40: region.ampenv.keynumToDecay = (float)gen.Short(); break;
+	case GenKeyRange: region.lokey = gen.Lo(); region.hikey = gen.Hi(); break;
+	case GenVelRange: region.lovel = gen.Lo(); region.hivel = gen.Hi(); break;
+	case 45: region.loop_start += gen.Short() * 32768; break;
+	case 48: region.attenuation += (float)(gen.Short() * 0.1); break;
+	case 50: region.loop_end += gen.Short() * 32768; break;
+	case 51: region.transpose += gen.Short(); break;
+	case 52: region.tune += gen.Short(); break;
+	case 54:
+		switch (gen.Word() & 3)
+		{
+		case 3: region.loop_mode = TSF_LOOPMODE_SUSTAIN; break;
+		case 1: region.loop_mode = TSF_LOOPMODE_CONTINUOUS; break;
+		default: region.loop_mode = TSF_LOOPMODE_NONE;
+		}
+		break;
+	case 56: region.pitch_keytrack = gen.Short(); break;
+	case 57: region.group = gen.Word(); break;
+	case 58: region.pitch_keycenter = gen.Short(); break;
+	default: break;
+	}
+}
+
+static void EnvelopeSum(tsf_envelope& env, const tsf_envelope& other)
+{
+	env.delay += other.delay;
+	env.attack += other.attack;
+	env.hold += other.hold;
+	env.decay += other.decay;
+	env.sustain += other.sustain;
+	env.release += other.release;
+}
+
+static void RegionSum(tsf_region& region, const tsf_region& other)
+{
+	region.offset += other.offset;
+	region.end += other.end;
+	region.loop_start += other.loop_start;
+	region.loop_end += other.loop_end;
+	region.transpose += other.transpose;
+	region.tune += other.tune;
+	region.pitch_keytrack += other.pitch_keytrack;
+	region.attenuation += other.attenuation;
+	region.pan += other.pan;
+	EnvelopeSum(region.ampenv, other.ampenv);
+	EnvelopeSum(region.modenv, other.modenv);
+	region.initialFilterQ += other.initialFilterQ;
+	region.initialFilterFc += other.initialFilterFc;
+	region.modEnvToPitch += other.modEnvToPitch;
+	region.modEnvToFilterFc += other.modEnvToFilterFc;
+	region.delayModLFO += other.delayModLFO;
+	region.freqModLFO += other.freqModLFO;
+	region.modLfoToPitch += other.modLfoToPitch;
+	region.modLfoToFilterFc += other.modLfoToFilterFc;
+	region.modLfoToVolume += other.modLfoToVolume;
+	region.delayVibLFO += other.delayVibLFO;
+	region.freqVibLFO += other.freqVibLFO;
+	region.vibLfoToPitch += other.vibLfoToPitch;
+}
+
+SF2Bank::SF2Bank() : m_samples(nullptr), m_samples24(nullptr), m_numSamples(0), 
+	m_residencyBudget((size_t)-1), m_residentBytes(0), m_useClock(0)
+{
+
+}
+
+SF2Bank::~SF2Bank()
+{
+
+}
+
+bool SF2Bank::Load(const char* filename)
+{
+	m_presets.clear();
+	m_residency.clear();
+	m_residentBytes = 0;
+	m_samples = nullptr;
+	m_samples24 = nullptr;
+	m_numSamples = 0;
+
+	if (!m_file.Open(filename)) return false;
+	const unsigned char* data = m_file.Data();
+	size_t size = m_file.Size();
+	if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "sfbk", 4) != 0)
+	{
+		m_file.Close();
+		return false;
+	}
+
+	const unsigned char* pdta = nullptr;
+	size_t pdtaSize = 0;
+	const unsigned char* sm24 = nullptr;
+	size_t sm24Size = 0;
+
+	size_t pos = 12;
+	while (pos + 12 <= size)
+	{
+		const unsigned char* list = data + pos;
+		size_t listSize = _readU32(list + 4);
+		if (listSize > size - pos - 8) listSize = size - pos - 8;
+		if (memcmp(list, "LIST", 4) == 0 && listSize >= 4)
+		{
+			const unsigned char* sub = list + 12;
+			size_t subSize = listSize - 4;
+			if (memcmp(list + 8, "pdta", 4) == 0)
+			{
+				pdta = sub;
+				pdtaSize = subSize;
+			}
+			else if (memcmp(list + 8, "sdta", 4) == 0)
+			{
+				size_t subPos = 0;
+				while (subPos + 8 <= subSize)
+				{
+					const unsigned char* chunk = sub + subPos;
+					size_t chunkSize = _readU32(chunk + 4);
+					if (chunkSize > subSize - subPos - 8) chunkSize = subSize - subPos - 8;
+					if (memcmp(chunk, "smpl", 4) == 0)
+					{
+						m_samples = (const int16_t*)(chunk + 8);
+						m_numSamples = chunkSize / 2;
+					}
+					else if (memcmp(chunk, "sm24", 4) == 0)
+					{
+						sm24 = chunk + 8;
+						sm24Size = chunkSize;
+					}
+					subPos += 8 + chunkSize + (chunkSize & 1);
+				}
+			}
+		}
+		pos += 8 + listSize + (listSize & 1);
+	}
+
+	// sm24 is ignored unless it covers the whole smpl chunk
+	if (sm24 != nullptr && m_numSamples > 0 && sm24Size >= m_numSamples)
+		m_samples24 = sm24;
+
+	if (pdta != nullptr)
+		_loadPresets(pdta, pdtaSize);
+
+	return true;
+}
+
+bool SF2Bank::_loadPresets(const unsigned char* pdta, size_t size)
+{
+	static const char* s_names[9] = { "phdr", "pbag", "pmod", "pgen", "inst", "ibag", "imod", "igen", "shdr" };
+	static const size_t s_recSizes[9] = { 38, 4, 10, 4, 22, 4, 10, 4, 46 };
+	const unsigned char* chunks[9] = { nullptr };
+	size_t counts[9] = { 0 };
+
+	size_t pos = 0;
+	while (pos + 8 <= size)
+	{
+		const unsigned char* chunk = pdta + pos;
+		size_t chunkSize = _readU32(chunk + 4);
+		if (chunkSize > size - pos - 8) chunkSize = size - pos - 8;
+		for (int i = 0; i < 9; i++)
+		{
+			if (memcmp(chunk, s_names[i], 4) == 0)
+			{
+				chunks[i] = chunk + 8;
+				counts[i] = chunkSize / s_recSizes[i];
+			}
+		}
+		pos += 8 + chunkSize + (chunkSize & 1);
+	}
+	for (int i = 0; i < 9; i++)
+		if (chunks[i] == nullptr) return false;
+
+	std::vector<HydraPhdr> phdrs(counts[0]);
+	for (size_t i = 0; i < counts[0]; i++)
+	{
+		const unsigned char* p = chunks[0] + i * 38;
+		phdrs[i].presetName = _decodeString(p, 20);
+		phdrs[i].preset = _readU16(p + 20);
+		phdrs[i].bank = _readU16(p + 22);
+		phdrs[i].presetBagNdx = _readU16(p + 24);
+	}
+
+	std::vector<HydraBag> pbags(counts[1]);
+	for (size_t i = 0; i < counts[1]; i++)
+	{
+		const unsigned char* p = chunks[1] + i * 4;
+		pbags[i].genNdx = _readU16(p);
+		pbags[i].modNdx = _readU16(p + 2);
+	}
+
+	std::vector<HydraGen> pgens(counts[3]);
+	for (size_t i = 0; i < counts[3]; i++)
+	{
+		const unsigned char* p = chunks[3] + i * 4;
+		pgens[i].genOper = _readU16(p);
+		memcpy(pgens[i].amount, p + 2, 2);
+	}
+
+	std::vector<HydraInst> insts(counts[4]);
+	for (size_t i = 0; i < counts[4]; i++)
+		insts[i].instBagNdx = _readU16(chunks[4] + i * 22 + 20);
+
+	std::vector<HydraBag> ibags(counts[5]);
+	for (size_t i = 0; i < counts[5]; i++)
+	{
+		const unsigned char* p = chunks[5] + i * 4;
+		ibags[i].genNdx = _readU16(p);
+		ibags[i].modNdx = _readU16(p + 2);
+	}
+
+	std::vector<HydraGen> igens(counts[7]);
+	for (size_t i = 0; i < counts[7]; i++)
+	{
+		const unsigned char* p = chunks[7] + i * 4;
+		igens[i].genOper = _readU16(p);
+		memcpy(igens[i].amount, p + 2, 2);
+	}
+
+	std::vector<HydraShdr> shdrs(counts[8]);
+	for (size_t i = 0; i < counts[8]; i++)
+	{
+		const unsigned char* p = chunks[8] + i * 46;
+		HydraShdr& shdr = shdrs[i];
+		shdr.start = _readU32(p + 20);
+		shdr.end = _readU32(p + 24);
+		shdr.startLoop = _readU32(p + 28);
+		shdr.endLoop = _readU32(p + 32);
+		shdr.sampleRate = _readU32(p + 36);
+		shdr.originalPitch = p[40];
+		shdr.pitchCorrection = (int8_t)p[41];
+		shdr.sampleLink = _readU16(p + 42);
+		shdr.sampleType = _readU16(p + 44);
+	}
+
+	if (phdrs.size() < 1) return true;
+	unsigned presetNum = (unsigned)phdrs.size() - 1; // Exclude EOP
+	unsigned fontSampleCount = (unsigned)m_numSamples;
+
+	// sorted by bank, then preset number, then order in the file
+	std::vector<unsigned> order(presetNum);
+	for (unsigned i = 0; i < presetNum; i++) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&phdrs](unsigned a, unsigned b)
+	{
+		if (phdrs[a].bank != phdrs[b].bank) return phdrs[a].bank < phdrs[b].bank;
+		return phdrs[a].preset < phdrs[b].preset;
+	});
+
+	m_presets.resize(presetNum);
+	for (unsigned sortedIndex = 0; sortedIndex < presetNum; sortedIndex++)
+	{
+		unsigned i = order[sortedIndex];
+		const HydraPhdr& phdr = phdrs[i];
+		SF2Preset& preset = m_presets[sortedIndex];
+		preset.presetName = phdr.presetName;
+		preset.bank = phdr.bank;
+		preset.preset = phdr.preset;
+
+		tsf_region globalRegion;
+		RegionClear(globalRegion, true);
+
+		// Zones
+		for (unsigned j = phdr.presetBagNdx; j < phdrs[i + 1].presetBagNdx && j + 1 < pbags.size(); j++)
+		{
+			tsf_region presetRegion = globalRegion;
+			bool hadGenInstrument = false;
+
+			// Generators
+			for (unsigned k = pbags[j].genNdx; k < pbags[j + 1].genNdx && k < pgens.size(); k++)
+			{
+				const HydraGen& pgen = pgens[k];
+
+				// Instrument.
+				if (pgen.genOper == GenInstrument)
+				{
+					unsigned whichInst = pgen.Word();
+					if (whichInst + 1 >= insts.size()) continue;
+
+					tsf_region instRegion;
+					RegionClear(instRegion, false);
+
+					for (unsigned l = insts[whichInst].instBagNdx; l < insts[whichInst + 1].instBagNdx && l + 1 < ibags.size(); l++)
+					{
+						tsf_region zoneRegion = instRegion;
+						bool hadSampleID = false;
+						for (unsigned m = ibags[l].genNdx; m < ibags[l + 1].genNdx && m < igens.size(); m++)
+						{
+							const HydraGen& igen = igens[m];
+							if (igen.genOper != GenSampleID)
+							{
+								RegionOperator(zoneRegion, igen);
+								continue;
+							}
+
+							// preset region key and vel ranges are a filter for the zone regions
+							if (zoneRegion.hikey < presetRegion.lokey || zoneRegion.lokey > presetRegion.hikey) continue;
+							if (zoneRegion.hivel < presetRegion.lovel || zoneRegion.lovel > presetRegion.hivel) continue;
+							if (presetRegion.lokey > zoneRegion.lokey) zoneRegion.lokey = presetRegion.lokey;
+							if (presetRegion.hikey < zoneRegion.hikey) zoneRegion.hikey = presetRegion.hikey;
+							if (presetRegion.lovel > zoneRegion.lovel) zoneRegion.lovel = presetRegion.lovel;
+							if (presetRegion.hivel < zoneRegion.hivel) zoneRegion.hivel = presetRegion.hivel;
+
+							unsigned sampleId = igen.Word();
+							if (sampleId >= shdrs.size()) continue;
+
+							// sum regions
+							RegionSum(zoneRegion, presetRegion);
+
+							// EG times need to be converted from timecents to seconds.
+							RegionEnvtosecs(zoneRegion.ampenv, true);
+							RegionEnvtosecs(zoneRegion.modenv, false);
+
+							// LFO times need to be converted from timecents to seconds.
+							zoneRegion.delayModLFO = zoneRegion.delayModLFO < -11950.0f ? 0.0f : TimeCents2Sec(zoneRegion.delayModLFO);
+							zoneRegion.delayVibLFO = zoneRegion.delayVibLFO < -11950.0f ? 0.0f : TimeCents2Sec(zoneRegion.delayVibLFO);
+
+							// Pin values to their ranges.
+							if (zoneRegion.pan < -0.5f) zoneRegion.pan = -0.5f;
+							else if (zoneRegion.pan > 0.5f) zoneRegion.pan = 0.5f;
+							if (zoneRegion.initialFilterQ < 1500 || zoneRegion.initialFilterQ > 13500) zoneRegion.initialFilterQ = 0;
+
+							const HydraShdr& shdr = shdrs[sampleId];
+							zoneRegion.offset += shdr.start;
+							zoneRegion.end += shdr.end;
+							zoneRegion.loop_start += shdr.startLoop;
+							zoneRegion.loop_end += shdr.endLoop;
+							if (shdr.endLoop > 0) zoneRegion.loop_end -= 1;
+							if (zoneRegion.pitch_keycenter == -1) zoneRegion.pitch_keycenter = shdr.originalPitch;
+							zoneRegion.tune += shdr.pitchCorrection;
+							zoneRegion.sample_rate = shdr.sampleRate;
+							if (zoneRegion.end != 0 && zoneRegion.end < fontSampleCount) zoneRegion.end++;
+							else zoneRegion.end = fontSampleCount;
+
+							preset.regions.push_back(zoneRegion);
+							hadSampleID = true;
+						}
+
+						// Handle instrument's global zone.
+						if (l == insts[whichInst].instBagNdx && !hadSampleID)
+							instRegion = zoneRegion;
+					}
+					hadGenInstrument = true;
+				}
+				else
+				{
+					RegionOperator(presetRegion, pgen);
+				}
+			}
+
+			// Handle preset's global zone.
+			if (j == phdr.presetBagNdx && !hadGenInstrument)
+				globalRegion = presetRegion;
+		}
+	}
+	return true;
+}
+
+size_t SF2Bank::_rangeBytes(const std::pair<unsigned, unsigned>& range) const
+{
+	size_t count = range.second - range.first;
+	return count * (m_samples24 != nullptr ? 3 : 2);
+}
+
+void SF2Bank::PinSamples(const std::vector<tsf_region>& regions)
+{
+	std::unique_lock<std::mutex> lock(m_residencyMutex);
+	m_useClock++;
+	for (size_t i = 0; i < regions.size(); i++)
+	{
+		const tsf_region& region = regions[i];
+		if (region.end <= region.offset || region.end > m_numSamples) continue;
+		std::pair<unsigned, unsigned> range(region.offset, region.end);
+		ResidencyMap::iterator iter = m_residency.find(range);
+		if (iter == m_residency.end())
+		{
+			Residency residency = { 0, 0, false };
+			iter = m_residency.insert(ResidencyMap::value_type(range, residency)).first;
+		}
+		Residency& residency = iter->second;
+		residency.pins++;
+		residency.lastUse = m_useClock;
+		if (!residency.resident)
+		{
+			size_t count = range.second - range.first;
+			m_file.Prefetch(m_samples + range.first, count * sizeof(int16_t));
+			if (m_samples24 != nullptr)
+				m_file.Prefetch(m_samples24 + range.first, count);
+			residency.resident = true;
+			m_residentBytes += _rangeBytes(range);
+		}
+	}
+}
+
+void SF2Bank::UnpinSamples(const std::vector<tsf_region>& regions)
+{
+	std::unique_lock<std::mutex> lock(m_residencyMutex);
+	m_useClock++;
+	for (size_t i = 0; i < regions.size(); i++)
+	{
+		const tsf_region& region = regions[i];
+		ResidencyMap::iterator iter = m_residency.find(std::pair<unsigned, unsigned>(region.offset, region.end));
+		if (iter == m_residency.end() || iter->second.pins == 0) continue;
+		iter->second.pins--;
+		iter->second.lastUse = m_useClock;
+	}
+	_trim();
+}
+
+void SF2Bank::SetResidencyBudget(size_t bytes)
+{
+	std::unique_lock<std::mutex> lock(m_residencyMutex);
+	m_residencyBudget = bytes;
+	_trim();
+}
+
+size_t SF2Bank::NumResidentRanges() const
+{
+	std::unique_lock<std::mutex> lock(m_residencyMutex);
+	size_t count = 0;
+	for (ResidencyMap::const_iterator iter = m_residency.begin(); iter != m_residency.end(); iter++)
+		if (iter->second.resident) count++;
+	return count;
+}
+
+size_t SF2Bank::NumPinnedRanges() const
+{
+	std::unique_lock<std::mutex> lock(m_residencyMutex);
+	size_t count = 0;
+	for (ResidencyMap::const_iterator iter = m_residency.begin(); iter != m_residency.end(); iter++)
+		if (iter->second.pins > 0) count++;
+	return count;
+}
+
+// Evicts unpinned ranges, least recently released first. Only pages lying
+// entirely inside a range are dropped, and a dropped page still used by an
+// overlapping range is simply read back from the file when touched again.
+void SF2Bank::_trim()
+{
+	while (m_residentBytes > m_residencyBudget)
+	{
+		ResidencyMap::iterator oldest = m_residency.end();
+		for (ResidencyMap::iterator iter = m_residency.begin(); iter != m_residency.end(); iter++)
+		{
+			const Residency& residency = iter->second;
+			if (!residency.resident || residency.pins > 0) continue;
+			if (oldest == m_residency.end() || residency.lastUse < oldest->second.lastUse)
+				oldest = iter;
+		}
+		if (oldest == m_residency.end()) break;
+
+		const std::pair<unsigned, unsigned>& range = oldest->first;
+		size_t count = range.second - range.first;
+		m_file.Evict(m_samples + range.first, count * sizeof(int16_t));
+		if (m_samples24 != nullptr)
+			m_file.Evict(m_samples24 + range.first, count);
+		m_residentBytes -= _rangeBytes(range);
+		m_residency.erase(oldest);
+	}
+}
@@ -0,0 +1,90 @@
+#ifndef _SF2Bank_h
+#define _SF2Bank_h
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <utility>
+#include "MappedFile.h"
+#include "Deferred.h"
+#include "SF2Synth.h"
+#include "SampleMips.h"
+
+struct SF2Preset
+{
+	std::string presetName;
+	unsigned bank;
+	unsigned preset;
+	std::vector<tsf_region> regions;
+};
+
+/*
+SoundFont 2 bank. The file is memory-mapped, the 16-bit sample pool (and the
+optional sm24 low bytes) are used in place and shared by every process mapping
+the same file. Presets are built the same way as SF2Presets.LoadPresets(),
+sorted by bank and preset number.
+
+Sample ranges are made resident on demand: compiling a preset pins the ranges
+of its regions and prefetches their pages. Ranges no longer used by any
+compiled preset stay resident until the residency budget is exceeded, then the
+least recently released ones are evicted from memory.
+*/
+class SF2Bank
+{
+public:
+	SF2Bank();
+	~SF2Bank();
+
+	bool Load(const char* filename);
+
+	const int16_t* Samples() const { return m_samples; }
+	// low bytes of 24-bit samples, nullptr when the bank has no sm24 chunk
+	const uint8_t* Samples24() const { return m_samples24; }
+	size_t NumSamples() const { return m_numSamples; }
+	SampleMipCache* Mips() { return &m_mips; }
+
+	const std::vector<SF2Preset>& Presets() const { return m_presets; }
+
+	void PinSamples(const std::vector<tsf_region>& regions);
+	void UnpinSamples(const std::vector<tsf_region>& regions);
+
+	// bytes of sample data kept resident when unused, (size_t)-1 for no limit
+	void SetResidencyBudget(size_t bytes);
+	size_t ResidencyBudget() const { return m_residencyBudget; }
+	size_t ResidentBytes() const { return m_residentBytes; }
+	size_t NumResidentRanges() const;
+	size_t NumPinnedRanges() const;
+
+private:
+	bool _loadPresets(const unsigned char* pdta, size_t size);
+
+	struct Residency
+	{
+		unsigned pins;
+		unsigned long long lastUse;
+		bool resident;
+	};
+	typedef std::map<std::pair<unsigned, unsigned>, Residency> ResidencyMap;
+
+	size_t _rangeBytes(const std::pair<unsigned, unsigned>& range) const;
+	void _trim();
+
+	MappedFile m_file;
+	const int16_t* m_samples;
+	const uint8_t* m_samples24;
+	size_t m_numSamples;
+	std::vector<SF2Preset> m_presets;
+	SampleMipCache m_mips;
+
+	mutable std::mutex m_residencyMutex;
+	ResidencyMap m_residency;
+	size_t m_residencyBudget;
+	size_t m_residentBytes;
+	unsigned long long m_useClock;
+};
+
+typedef Deferred<SF2Bank> SF2Bank_Deferred;
+
+#endif
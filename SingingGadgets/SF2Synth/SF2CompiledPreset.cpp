@@ -0,0 +1,117 @@
+#include "SF2CompiledPreset.h"
+#include "NoteCache.h"
+#include <map>
+
+SF2CompiledPreset::SF2CompiledPreset() : m_f32Samples(nullptr), m_input((const float*)nullptr), m_contentHash(0), m_hashed(false)
+{
+	m_bank.Abondon();
+}
+
+SF2CompiledPreset::~SF2CompiledPreset()
+{
+	_releaseBank();
+	Py_XDECREF(m_f32Samples);
+}
+
+void SF2CompiledPreset::_releaseBank()
+{
+	if (m_bank != nullptr)
+	{
+		m_bank->UnpinSamples(m_regions);
+		m_bank.Abondon();
+	}
+}
+
+void SF2CompiledPreset::SetBank(const SF2Bank_Deferred& bank, const SF2Preset& preset)
+{
+	_releaseBank();
+	m_bank = bank;
+	m_input = SynthInput(m_bank->Samples(), m_bank->Samples24(), m_bank->Mips());
+	m_regions = preset.regions;
+	m_bank->PinSamples(m_regions);
+	m_hashed = false;
+	_buildTable();
+}
+
+void SF2CompiledPreset::SetF32(PyObject* f32Samples, const std::vector<tsf_region>& regions)
+{
+	_releaseBank();
+	Py_INCREF(f32Samples);
+	Py_XDECREF(m_f32Samples);
+	m_f32Samples = f32Samples;
+	m_input = SynthInput((const float*)PyBytes_AsString(f32Samples), &m_f32Mips);
+	m_regions = regions;
+	m_hashed = false;
+	_buildTable();
+}
+
+void SF2CompiledPreset::_buildTable()
+{
+	std::map<std::vector<uint16_t>, uint16_t> setIds;
+	m_setStarts.clear();
+	m_setItems.clear();
+
+	std::vector<uint16_t> set;
+	for (int key = 0; key < 128; key++)
+	{
+		for (int vel = 0; vel < 128; vel++)
+		{
+			set.clear();
+			for (size_t i = 0; i < m_regions.size(); i++)
+			{
+				const tsf_region& region = m_regions[i];
+				if (key < region.lokey || key > region.hikey || vel < region.lovel || vel > region.hivel) continue;
+				set.push_back((uint16_t)i);
+			}
+
+			std::map<std::vector<uint16_t>, uint16_t>::iterator iter = setIds.find(set);
+			uint16_t setId;
+			if (iter == setIds.end())
+			{
+				setId = (uint16_t)m_setStarts.size();
+				setIds[set] = setId;
+				m_setStarts.push_back((uint32_t)m_setItems.size());
+				m_setItems.insert(m_setItems.end(), set.begin(), set.end());
+			}
+			else setId = iter->second;
+			m_cells[key * 128 + vel] = setId;
+		}
+	}
+	m_setStarts.push_back((uint32_t)m_setItems.size());
+}
+
+unsigned SF2CompiledPreset::Lookup(int key, int vel, const tsf_region** regions) const
+{
+	if (key < 0 || key > 127 || vel < 0 || vel > 127) return 0;
+	uint16_t setId = m_cells[key * 128 + vel];
+	uint32_t start = m_setStarts[setId];
+	uint32_t count = m_setStarts[setId + 1] - start;
+	for (uint32_t i = 0; i < count; i++)
+		regions[i] = &m_regions[m_setItems[start + i]];
+	return count;
+}
+
+uint64_t SF2CompiledPreset::ContentHash()
+{
+	if (m_hashed) return m_contentHash;
+	uint64_t hash = FNV1a(m_regions.data(), m_regions.size() * sizeof(tsf_region));
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		const tsf_region& region = m_regions[i];
+		if (region.end <= region.offset) continue;
+		size_t count = region.end - region.offset;
+		if (m_input.f32 != nullptr)
+		{
+			hash = FNV1a(m_input.f32 + region.offset, count * sizeof(float), hash);
+		}
+		else
+		{
+			hash = FNV1a(m_input.s16 + region.offset, count * sizeof(int16_t), hash);
+			if (m_input.s24 != nullptr)
+				hash = FNV1a(m_input.s24 + region.offset, count, hash);
+		}
+	}
+	m_contentHash = hash;
+	m_hashed = true;
+	return hash;
+}
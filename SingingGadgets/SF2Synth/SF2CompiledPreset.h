@@ -0,0 +1,54 @@
+#ifndef _SF2CompiledPreset_h
+#define _SF2CompiledPreset_h
+
+#include <stdint.h>
+#include <vector>
+#include "SF2Bank.h"
+
+/*
+Regions of a preset with a 128x128 key/velocity lookup table. 
+Cells with the same set of regions share one entry of the set list, 
+so the table stays at 32KB however many regions there are.
+The sample pool is kept alive by the preset, either the SF2Bank or a 
+Python bytes object of float samples. The sample ranges of a bank preset 
+stay pinned in the bank's residency table while the preset is alive.
+*/
+class SF2CompiledPreset
+{
+public:
+	SF2CompiledPreset();
+	~SF2CompiledPreset();
+
+	void SetBank(const SF2Bank_Deferred& bank, const SF2Preset& preset);
+	void SetF32(PyObject* f32Samples, const std::vector<tsf_region>& regions);
+
+	SynthInput Input() const { return m_input; }
+	const std::vector<tsf_region>& Regions() const { return m_regions; }
+
+	// regions matching the key and velocity, in the order of the preset
+	unsigned Lookup(int key, int vel, const tsf_region** regions) const;
+
+	// FNV-1a of the regions and the samples they play, computed on first use
+	uint64_t ContentHash();
+
+private:
+	void _buildTable();
+	void _releaseBank();
+
+	SF2Bank_Deferred m_bank;
+	PyObject* m_f32Samples;
+	SampleMipCache m_f32Mips;
+	SynthInput m_input;
+
+	std::vector<tsf_region> m_regions;
+	uint16_t m_cells[128 * 128];
+	std::vector<uint32_t> m_setStarts;
+	std::vector<uint16_t> m_setItems;
+
+	uint64_t m_contentHash;
+	bool m_hashed;
+};
+
+typedef Deferred<SF2CompiledPreset> SF2CompiledPreset_Deferred;
+
+#endif
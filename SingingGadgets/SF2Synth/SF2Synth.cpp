@@ -1,4 +1,5 @@
 #include "SF2Synth.h"
+#include "ParallelFor.h"
 
 struct LowPass
 {
@@ -201,8 +202,47 @@ static void tsf_voice_lfo_process(struct tsf_voice_lfo* e, int blockSamples)
 #endif
 
 
-PyObject* SynthRegion(const float* input, const tsf_region& region, float key, float vel,
-	unsigned numSamples, OutputMode outputmode, float samplerate, float global_gain_db)
+class SF2Voice
+{
+public:
+	SF2Voice(const tsf_region& region, float key, float vel, unsigned numSamples, OutputMode outputmode, float samplerate, float global_gain_db);
+
+	// Advances envelopes, LFOs and the estimated sample position by one block and 
+	// returns the control point of the block. Returns false on the last block of the note.
+	bool NextBlock(SynthCtrlPnt& ctrlPnt);
+
+	// number of output samples, found by running the envelopes of a copy of the voice
+	unsigned CountSamples() const;
+
+	// renders countSamples samples, mixed into outputBuffer
+	void Render(const SynthInput& input, float* outputBuffer, unsigned countSamples);
+
+private:
+	const tsf_region* m_region;
+	unsigned m_numSamples;
+	float m_samplerate;
+
+	NoteState m_ns;
+	SynthCtrl m_control;
+
+	tsf_voice_envelope ampenv, modenv;
+	LowPass lowpass;
+	tsf_voice_lfo modlfo, viblfo;
+
+	TSF_BOOL updateModEnv, updateModLFO, updateVibLFO, isLooping;
+	TSF_BOOL dynamicLowpass, dynamicPitchRatio, dynamicGain;
+
+	double tmpSampleEndDbl, tmpLoopEndDbl, tmpSourceSamplePosition;
+	float tmpSampleRate, tmpInitialFilterFc, tmpModLfoToFilterFc, tmpModEnvToFilterFc;
+	double pitchInputTimecents, pitchOutputFactor, pitchRatio;
+	float tmpModLfoToPitch, tmpVibLfoToPitch, tmpModEnvToPitch;
+	float noteGainDB, noteGain, tmpModLfoToVolume;
+
+	unsigned countSamples;
+};
+
+SF2Voice::SF2Voice(const tsf_region& region, float key, float vel, unsigned numSamples, OutputMode outputmode, float samplerate, float global_gain_db)
+	: m_region(&region), m_numSamples(numSamples), m_samplerate(samplerate)
 {
 	/*FILE *fp = fopen("dump.txt", "a");
 	region.print(fp);
@@ -210,57 +250,49 @@ PyObject* SynthRegion(const float* input, const tsf_region& region, float key, f
 
 	int midiVelocity = (int)(vel * 127);
 
-	float noteGainDB = global_gain_db - region.attenuation - tsf_gainToDecibels(1.0f / vel);
+	noteGainDB = global_gain_db - region.attenuation - tsf_gainToDecibels(1.0f / vel);
 	double note = (double)key + (double)region.transpose + (double)region.tune / 100.0;
 	double adjustedPitch = (double)region.pitch_keycenter + (note - (double)region.pitch_keycenter)* ((double)region.pitch_keytrack / 100.0);
-	double pitchInputTimecents = adjustedPitch * 100.0;
-	double pitchOutputFactor = (double)region.sample_rate / (tsf_timecents2Secsd((double)region.pitch_keycenter * 100.0) * (double)samplerate);
+	pitchInputTimecents = adjustedPitch * 100.0;
+	pitchOutputFactor = (double)region.sample_rate / (tsf_timecents2Secsd((double)region.pitch_keycenter * 100.0) * (double)samplerate);
 	// The SFZ spec is silent about the pan curve, but a 3dB pan law seems common. This sqrt() curve matches what Dimension LE does; Alchemy Free seems closer to sin(adjustedPan * pi/2).
 	float panFactorLeft = TSF_SQRTF(0.5f - region.pan);
 	float panFactorRight = TSF_SQRTF(0.5f + region.pan);
 	// Offset/end.
-	NoteState ns;
-	ns.sourceSamplePosition = region.offset;
+	m_ns.sourceSamplePosition = (FixedPhase)region.offset << 32;
 	bool doLoop = (region.loop_mode != TSF_LOOPMODE_NONE && region.loop_start < region.loop_end);
 	// Loop.
 	unsigned loopStart = (doLoop ? region.loop_start : 0);
 	unsigned loopEnd = (doLoop ? region.loop_end : 0);
 	// Setup envelopes.
-	tsf_voice_envelope ampenv, modenv;
 	tsf_voice_envelope_setup(&ampenv, &region.ampenv, key, midiVelocity, TSF_TRUE, samplerate);
 	tsf_voice_envelope_setup(&modenv, &region.modenv, key, midiVelocity, TSF_FALSE, samplerate);
 	// Setup lowpass filter.
 	float filterQDB = region.initialFilterQ / 10.0f;
-	LowPass lowpass;
 	lowpass.QInv = 1.0f / TSF_POW(10.0f, (filterQDB / 20.0f));
-	ns.lowPass.z1 = 0.0;
-	ns.lowPass.z2 = 0.0;
+	lowpass.a0 = lowpass.a1 = lowpass.b1 = lowpass.b2 = 0.0;
+	m_ns.lowPass.z1 = 0.0;
+	m_ns.lowPass.z2 = 0.0;
 	lowpass.active = (region.initialFilterFc <= 13500);
 	if (lowpass.active)
 		tsf_voice_lowpass_setup(&lowpass, tsf_cents2Hertz((float)region.initialFilterFc) / samplerate);
 	// Setup LFO filters.
-	tsf_voice_lfo modlfo, viblfo;
 	tsf_voice_lfo_setup(&modlfo, region.delayModLFO, region.freqModLFO, samplerate);
 	tsf_voice_lfo_setup(&viblfo, region.delayVibLFO, region.freqVibLFO, samplerate);
 
-	TSF_BOOL updateModEnv = (region.modEnvToPitch != 0 || region.modEnvToFilterFc != 0);
-	TSF_BOOL updateModLFO = (modlfo.delta != 0.0f && (region.modLfoToPitch != 0 || region.modLfoToFilterFc != 0 || region.modLfoToVolume != 0));
-	TSF_BOOL updateVibLFO = (viblfo.delta != 0.0f && (region.vibLfoToPitch != 0));
-	TSF_BOOL isLooping = (loopStart < loopEnd);
-
-	double tmpSampleEndDbl = (double)region.end;
-	double tmpLoopEndDbl = (double)loopEnd + 1.0f;
-	double tmpSourceSamplePosition = ns.sourceSamplePosition;
-
-	TSF_BOOL dynamicLowpass = (region.modLfoToFilterFc != 0 || region.modEnvToFilterFc != 0);
-	float tmpSampleRate, tmpInitialFilterFc, tmpModLfoToFilterFc, tmpModEnvToFilterFc;
+	updateModEnv = (region.modEnvToPitch != 0 || region.modEnvToFilterFc != 0);
+	updateModLFO = (modlfo.delta != 0.0f && (region.modLfoToPitch != 0 || region.modLfoToFilterFc != 0 || region.modLfoToVolume != 0));
+	updateVibLFO = (viblfo.delta != 0.0f && (region.vibLfoToPitch != 0));
+	isLooping = (loopStart < loopEnd);
 
-	TSF_BOOL dynamicPitchRatio = (region.modLfoToPitch != 0 || region.modEnvToPitch != 0 || region.vibLfoToPitch != 0);
-	double pitchRatio;
-	float tmpModLfoToPitch, tmpVibLfoToPitch, tmpModEnvToPitch;
+	tmpSampleEndDbl = (double)region.end;
+	tmpLoopEndDbl = (double)loopEnd + 1.0f;
+	tmpSourceSamplePosition = (double)region.offset;
 
-	TSF_BOOL dynamicGain = (region.modLfoToVolume != 0);
-	float noteGain = 0, tmpModLfoToVolume;
+	dynamicLowpass = (region.modLfoToFilterFc != 0 || region.modEnvToFilterFc != 0);
+	dynamicPitchRatio = (region.modLfoToPitch != 0 || region.modEnvToPitch != 0 || region.vibLfoToPitch != 0);
+	dynamicGain = (region.modLfoToVolume != 0);
+	noteGain = 0;
 
 	if (dynamicLowpass) tmpSampleRate = samplerate, tmpInitialFilterFc = (float)region.initialFilterFc, tmpModLfoToFilterFc = (float)region.modLfoToFilterFc, tmpModEnvToFilterFc = (float)region.modEnvToFilterFc;
 	else tmpSampleRate = 0, tmpInitialFilterFc = 0, tmpModLfoToFilterFc = 0, tmpModEnvToFilterFc = 0;
@@ -270,83 +302,234 @@ PyObject* SynthRegion(const float* input, const tsf_region& region, float key, f
 	if (dynamicGain) tmpModLfoToVolume = (float)region.modLfoToVolume * 0.1f;
 	else noteGain = tsf_decibelsToGain(noteGainDB), tmpModLfoToVolume = 0;
 
-	SynthCtrl control;
-	control.outputmode = outputmode;
-	control.loopStart = loopStart;
-	control.loopEnd = loopEnd;
-	control.end = region.end;
-	control.panFactorLeft = panFactorLeft;
-	control.panFactorRight = panFactorRight;
-	control.effect_sample_block = TSF_RENDER_EFFECTSAMPLEBLOCK;
+	m_control.outputmode = outputmode;
+	m_control.start = region.offset;
+	m_control.loopStart = loopStart;
+	m_control.loopEnd = loopEnd;
+	m_control.end = region.end;
+	m_control.panFactorLeft = panFactorLeft;
+	m_control.panFactorRight = panFactorRight;
+	m_control.effect_sample_block = TSF_RENDER_EFFECTSAMPLEBLOCK;
+
+	countSamples = 0;
+}
 
-	unsigned countSamples = 0;
+bool SF2Voice::NextBlock(SynthCtrlPnt& ctrlPnt)
+{
+	float gainMono;
+	int blockSamples = TSF_RENDER_EFFECTSAMPLEBLOCK;
+	countSamples += blockSamples;
 
-	while (true)
+	if (countSamples >= m_numSamples && ampenv.segment<TSF_SEGMENT_RELEASE)
 	{
-		float gainMono;
-		int blockSamples = TSF_RENDER_EFFECTSAMPLEBLOCK;
-		countSamples += blockSamples;
+		tsf_voice_envelope_nextsegment(&ampenv, TSF_SEGMENT_SUSTAIN, m_samplerate);
+		tsf_voice_envelope_nextsegment(&modenv, TSF_SEGMENT_SUSTAIN, m_samplerate);
+		if (m_region->loop_mode == TSF_LOOPMODE_SUSTAIN)
+			// Continue playing, but stop looping.
+			isLooping = false;
+	}
 
-		if (countSamples >= numSamples && ampenv.segment<TSF_SEGMENT_RELEASE)
-		{
-			tsf_voice_envelope_nextsegment(&ampenv, TSF_SEGMENT_SUSTAIN, samplerate);
-			tsf_voice_envelope_nextsegment(&modenv, TSF_SEGMENT_SUSTAIN, samplerate);
-			if (region.loop_mode == TSF_LOOPMODE_SUSTAIN)
-				// Continue playing, but stop looping.
-				isLooping = false;
-		}
+	if (dynamicLowpass)
+	{
+		float fres = tmpInitialFilterFc + modlfo.level * tmpModLfoToFilterFc + modenv.level * tmpModEnvToFilterFc;
+		lowpass.active = (fres <= 13500.0f);
+		if (lowpass.active) tsf_voice_lowpass_setup(&lowpass, tsf_cents2Hertz(fres) / tmpSampleRate);
+	}
 
-		if (dynamicLowpass)
-		{
-			float fres = tmpInitialFilterFc + modlfo.level * tmpModLfoToFilterFc + modenv.level * tmpModEnvToFilterFc;
-			lowpass.active = (fres <= 13500.0f);
-			if (lowpass.active) tsf_voice_lowpass_setup(&lowpass, tsf_cents2Hertz(fres) / tmpSampleRate);
-		}
+	if (dynamicPitchRatio)
+		pitchRatio = tsf_timecents2Secsd(pitchInputTimecents + (modlfo.level * tmpModLfoToPitch + viblfo.level * tmpVibLfoToPitch + modenv.level * tmpModEnvToPitch)) *  pitchOutputFactor;
+
+	if (dynamicGain)
+		noteGain = tsf_decibelsToGain(noteGainDB + (modlfo.level * tmpModLfoToVolume));
 
-		if (dynamicPitchRatio)
-			pitchRatio = tsf_timecents2Secsd(pitchInputTimecents + (modlfo.level * tmpModLfoToPitch + viblfo.level * tmpVibLfoToPitch + modenv.level * tmpModEnvToPitch)) *  pitchOutputFactor;
+	gainMono = noteGain * ampenv.level;
 
-		if (dynamicGain)
-			noteGain = tsf_decibelsToGain(noteGainDB + (modlfo.level * tmpModLfoToVolume));
+	// Update EG.
+	tsf_voice_envelope_process(&ampenv, blockSamples, m_samplerate);
+	if (updateModEnv) tsf_voice_envelope_process(&modenv, blockSamples, m_samplerate);
 
-		gainMono = noteGain * ampenv.level;
+	// Update LFOs.
+	if (updateModLFO) tsf_voice_lfo_process(&modlfo, blockSamples);
+	if (updateVibLFO) tsf_voice_lfo_process(&viblfo, blockSamples);
 
-		// Update EG.
-		tsf_voice_envelope_process(&ampenv, blockSamples, samplerate);
-		if (updateModEnv) tsf_voice_envelope_process(&modenv, blockSamples, samplerate);
+	ctrlPnt.looping = isLooping;
+	ctrlPnt.gainMono = gainMono;
+	ctrlPnt.pitchRatio = pitchRatio;
+	ctrlPnt.lowPass.active = lowpass.active;
+	ctrlPnt.lowPass.a0 = lowpass.a0;
+	ctrlPnt.lowPass.a1 = lowpass.a1;
+	ctrlPnt.lowPass.b1 = lowpass.b1;
+	ctrlPnt.lowPass.b2 = lowpass.b2;
 
-		// Update LFOs.
-		if (updateModLFO) tsf_voice_lfo_process(&modlfo, blockSamples);
-		if (updateVibLFO) tsf_voice_lfo_process(&viblfo, blockSamples);
+	tmpSourceSamplePosition += pitchRatio*(float)blockSamples;
+	while (tmpSourceSamplePosition >= tmpLoopEndDbl && isLooping)
+		tmpSourceSamplePosition -= (m_control.loopEnd - m_control.loopStart + 1.0f);
+
+	return !(tmpSourceSamplePosition >= tmpSampleEndDbl || ampenv.segment == TSF_SEGMENT_DONE);
+}
+
+unsigned SF2Voice::CountSamples() const
+{
+	SF2Voice dryRun(*this);
+	SynthCtrlPnt ctrlPnt;
+	while (dryRun.NextBlock(ctrlPnt));
+	return dryRun.countSamples;
+}
+
+void SF2Voice::Render(const SynthInput& input, float* outputBuffer, unsigned numSamples)
+{
+	float* outL = outputBuffer;
+	float* outR = (m_control.outputmode == STEREO_UNWEAVED ? outL + numSamples : nullptr);
+
+	bool more = true;
+	while (numSamples && more)
+	{
+		unsigned blockSamples = (numSamples > m_control.effect_sample_block ? m_control.effect_sample_block : numSamples);
+		numSamples -= blockSamples;
 
 		SynthCtrlPnt ctrlPnt;
-		ctrlPnt.looping = isLooping;
-		ctrlPnt.gainMono = gainMono;
-		ctrlPnt.pitchRatio = pitchRatio;
-		ctrlPnt.lowPass.active = lowpass.active;
-		ctrlPnt.lowPass.a0 = lowpass.a0;
-		ctrlPnt.lowPass.a1 = lowpass.a1;
-		ctrlPnt.lowPass.b1 = lowpass.b1;
-		ctrlPnt.lowPass.b2 = lowpass.b2;
-		control.controlPnts.push_back(ctrlPnt);
-
-		tmpSourceSamplePosition += pitchRatio*(float)blockSamples;
-		while (tmpSourceSamplePosition >= tmpLoopEndDbl && isLooping)
-			tmpSourceSamplePosition -= (loopEnd - loopStart + 1.0f);
-
-		if (tmpSourceSamplePosition >= tmpSampleEndDbl || ampenv.segment == TSF_SEGMENT_DONE)
+		more = NextBlock(ctrlPnt);
+		if (!SynthBlock(input, m_control, ctrlPnt, blockSamples, m_ns, outL, outR))
 			break;
 	}
+}
+
+SF2Note::SF2Note(const tsf_region* const* regions, unsigned numRegions, float key, float vel,
+	unsigned numSamples, OutputMode outputmode, float samplerate, float global_gain_db)
+{
+	m_numSamples = 0;
+	for (unsigned i = 0; i < numRegions; i++)
+	{
+		SF2Voice* voice = new SF2Voice(*regions[i], key, vel, numSamples, outputmode, samplerate, global_gain_db);
+		unsigned count = voice->CountSamples();
+		if (count > m_numSamples) m_numSamples = count;
+		m_voices.push_back(voice);
+		m_counts.push_back(count);
+	}
+}
+
+SF2Note::~SF2Note()
+{
+	for (size_t i = 0; i < m_voices.size(); i++)
+		delete m_voices[i];
+}
+
+void SF2Note::Render(const SynthInput& input, float* outputBuffer)
+{
+	// regions are mixed in place, in the same order as MixF32() would
+	for (size_t i = 0; i < m_voices.size(); i++)
+		m_voices[i]->Render(input, outputBuffer, m_counts[i]);
+}
+
+PyObject* SynthRegion(const SynthInput& input, const tsf_region& region, float key, float vel,
+	unsigned numSamples, OutputMode outputmode, float samplerate, float global_gain_db)
+{
+	const tsf_region* regions[1] = { &region };
+	SF2Note note(regions, 1, key, vel, numSamples, outputmode, samplerate, global_gain_db);
 
 	unsigned chn = outputmode == MONO ? 1 : 2;
 
-	PyObject* output = PyBytes_FromStringAndSize(nullptr, sizeof(float)*countSamples*chn);
+	PyObject* output = PyBytes_FromStringAndSize(nullptr, sizeof(float)*note.NumSamples()*chn);
 	char* p;
 	ssize_t size;
 	PyBytes_AsStringAndSize(output, &p, &size);
 	float* ptr = (float*)p;	
 	memset(ptr, 0, size);
-	Synth(input, ptr, countSamples, ns, control);
+	note.Render(input, ptr);
 
 	return output;
 }
+
+PyObject* SynthRegions(const SynthInput& input, const tsf_region* const* regions, unsigned numRegions, float key, float vel,
+	unsigned numSamples, OutputMode outputmode, float samplerate, float global_gain_db)
+{
+	if (numRegions < 1)
+	{
+		PyObject* ret = PyTuple_New(2);
+		PyTuple_SetItem(ret, 0, PyLong_FromLong(0));
+		Py_INCREF(Py_None);
+		PyTuple_SetItem(ret, 1, Py_None);
+		return ret;
+	}
+
+	SF2Note note(regions, numRegions, key, vel, numSamples, outputmode, samplerate, global_gain_db);
+
+	unsigned chn = outputmode == MONO ? 1 : 2;
+
+	PyObject* output = PyBytes_FromStringAndSize(nullptr, sizeof(float)*note.NumSamples()*chn);
+	char* p;
+	ssize_t size;
+	PyBytes_AsStringAndSize(output, &p, &size);
+	float* ptr = (float*)p;
+	memset(ptr, 0, size);
+	note.Render(input, ptr);
+
+	PyObject* ret = PyTuple_New(2);
+	PyTuple_SetItem(ret, 0, PyLong_FromUnsignedLong(note.NumSamples()));
+	PyTuple_SetItem(ret, 1, output);
+	return ret;
+}
+
+unsigned RenderNotes(const SynthInput& input, const SF2NoteEvent* events, unsigned numEvents,
+	OutputMode outputmode, float samplerate, float global_gain_db, unsigned numThreads, std::vector<float>& out)
+{
+	// notes are placed at their onsets interleaved, an unweaved result is split at the end
+	OutputMode renderMode = outputmode == STEREO_UNWEAVED ? STEREO_INTERLEAVED : outputmode;
+	unsigned chn = outputmode == MONO ? 1 : 2;
+	if (numThreads == 0) numThreads = DefaultNumThreads();
+
+	// notes are rendered a batch at a time into scratch buffers, which are kept across batches,
+	// then mixed one by one so the result does not depend on the number of threads
+	unsigned batchSize = numThreads * 4;
+	std::vector<std::vector<float>> scratch(batchSize);
+	std::vector<unsigned> counts(batchSize);
+
+	out.clear();
+	unsigned length = 0;
+	for (unsigned start = 0; start < numEvents; start += batchSize)
+	{
+		unsigned count = numEvents - start;
+		if (count > batchSize) count = batchSize;
+
+		ParallelFor(count, numThreads, [&](unsigned i)
+		{
+			const SF2NoteEvent& e = events[start + i];
+			counts[i] = 0;
+			if (e.numRegions < 1) return;
+			SF2Note note(e.regions, e.numRegions, e.key, e.vel, e.numSamples, renderMode, samplerate, global_gain_db);
+			std::vector<float>& buf = scratch[i];
+			counts[i] = note.NumSamples();
+			buf.assign((size_t)counts[i] * chn, 0.0f);
+			note.Render(input, buf.data());
+		});
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			if (counts[i] == 0) continue;
+			unsigned onset = events[start + i].onset;
+			unsigned end = onset + counts[i];
+			if (end > length)
+			{
+				length = end;
+				out.resize((size_t)length * chn, 0.0f);
+			}
+			float* dst = out.data() + (size_t)onset * chn;
+			const float* src = scratch[i].data();
+			size_t n = (size_t)counts[i] * chn;
+			for (size_t j = 0; j < n; j++)
+				dst[j] += src[j];
+		}
+	}
+
+	if (outputmode == STEREO_UNWEAVED)
+	{
+		std::vector<float> unweaved(out.size());
+		for (unsigned i = 0; i < length; i++)
+		{
+			unweaved[i] = out[i * 2];
+			unweaved[length + i] = out[i * 2 + 1];
+		}
+		out.swap(unweaved);
+	}
+	return length;
+}
@@ -32,6 +32,8 @@ struct tsf_region
 {
 	int loop_mode;
 	unsigned int sample_rate;
+	int lokey, hikey, lovel, hivel;
+	unsigned int group;
 	unsigned int offset, end, loop_start, loop_end;
 	int transpose, tune, pitch_keycenter, pitch_keytrack;
 	float attenuation, pan;
@@ -47,6 +49,9 @@ struct tsf_region
 	{
 		fprintf(fp, "loop_mode: %d\n", loop_mode);
 		fprintf(fp, "sample_rate: %u\n", sample_rate);
+		fprintf(fp, "key range: %d-%d\n", lokey, hikey);
+		fprintf(fp, "vel range: %d-%d\n", lovel, hivel);
+		fprintf(fp, "group: %u\n", group);
 		fprintf(fp, "offset: %u\n", offset);
 		fprintf(fp, "end: %u\n", end);
 		fprintf(fp, "loop_start: %u\n", loop_start);
@@ -77,7 +82,50 @@ struct tsf_region
 #include "Synth.h"
 #include <Python.h>
 
-PyObject* SynthRegion(const float* input, const tsf_region& region, float key, float vel,
+class SF2Voice;
+
+// Voices of all regions of a note. The length is known once constructed, 
+// envelopes and LFOs are advanced block by block while rendering.
+class SF2Note
+{
+public:
+	SF2Note(const tsf_region* const* regions, unsigned numRegions, float key, float vel,
+		unsigned numSamples, OutputMode outputmode, float samplerate, float global_gain_db);
+	~SF2Note();
+
+	unsigned NumSamples() const { return m_numSamples; }
+
+	// mixes the note into outputBuffer, which holds NumSamples() samples per channel
+	void Render(const SynthInput& input, float* outputBuffer);
+
+private:
+	SF2Note(const SF2Note&);
+	void operator=(const SF2Note&);
+
+	std::vector<SF2Voice*> m_voices;
+	std::vector<unsigned> m_counts;
+	unsigned m_numSamples;
+};
+
+struct SF2NoteEvent
+{
+	unsigned onset; // in samples
+	float key, vel;
+	unsigned numSamples;
+	const tsf_region* const* regions;
+	unsigned numRegions;
+};
+
+// Renders the events on numThreads threads (0 for one per core) and mixes them into 'out'
+// in the order given. Returns the length of 'out' in samples per channel.
+unsigned RenderNotes(const SynthInput& input, const SF2NoteEvent* events, unsigned numEvents,
+	OutputMode outputmode, float samplerate, float global_gain_db, unsigned numThreads, std::vector<float>& out);
+
+PyObject* SynthRegion(const SynthInput& input, const tsf_region& region, float key, float vel,
+	unsigned numSamples, OutputMode outputmode, float samplerate, float global_gain_db);
+
+// all regions of a note mixed into one buffer, returns (numSamples, buffer or None)
+PyObject* SynthRegions(const SynthInput& input, const tsf_region* const* regions, unsigned numRegions, float key, float vel,
 	unsigned numSamples, OutputMode outputmode, float samplerate, float global_gain_db);
 
 #endif
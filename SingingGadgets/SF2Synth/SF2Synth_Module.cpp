@@ -1,6 +1,10 @@
 #include <Python.h>
+#include <algorithm>
 #include "Synth.h"
 #include "SF2Synth.h"
+#include "SF2Bank.h"
+#include "SF2CompiledPreset.h"
+#include "NoteCache.h"
 
 static PyObject* Synth(PyObject *self, PyObject *args)
 {
@@ -24,7 +28,7 @@ static PyObject* Synth(PyObject *self, PyObject *args)
 
 	NoteState ns;
 	PyObject* obj_ns = PyTuple_GetItem(args, 3);
-	ns.sourceSamplePosition = PyFloat_AsDouble(PyDict_GetItemString(obj_ns, "sourceSamplePosition"));
+	ns.sourceSamplePosition = ToFixedPhase(PyFloat_AsDouble(PyDict_GetItemString(obj_ns, "sourceSamplePosition")));
 	PyObject* obj_lowpass = PyDict_GetItemString(obj_ns, "lowPass");
 	ns.lowPass.z1 = PyFloat_AsDouble(PyDict_GetItemString(obj_lowpass, "z1"));
 	ns.lowPass.z2 = PyFloat_AsDouble(PyDict_GetItemString(obj_lowpass, "z2"));
@@ -32,6 +36,7 @@ static PyObject* Synth(PyObject *self, PyObject *args)
 	SynthCtrl control;
 	PyObject* obj_ctrl = PyTuple_GetItem(args, 4);
 	control.outputmode = (OutputMode)PyLong_AsUnsignedLong(PyDict_GetItemString(obj_ctrl, "outputmode"));
+	control.start = 0;
 	control.loopStart = (unsigned)PyLong_AsUnsignedLong(PyDict_GetItemString(obj_ctrl, "loopStart"));
 	control.loopEnd = (unsigned)PyLong_AsUnsignedLong(PyDict_GetItemString(obj_ctrl, "loopEnd"));
 	control.end = (unsigned)PyLong_AsUnsignedLong(PyDict_GetItemString(obj_ctrl, "end"));
@@ -61,7 +66,7 @@ static PyObject* Synth(PyObject *self, PyObject *args)
 
 	Synth(input, outputBuffer, numSamples, ns, control);
 
-	PyDict_SetItemString(obj_ns, "sourceSamplePosition", PyFloat_FromDouble(ns.sourceSamplePosition));
+	PyDict_SetItemString(obj_ns, "sourceSamplePosition", PyFloat_FromDouble(FixedPhaseToDouble(ns.sourceSamplePosition)));
 	PyDict_SetItemString(obj_lowpass, "z1", PyFloat_FromDouble(ns.lowPass.z1));
 	PyDict_SetItemString(obj_lowpass, "z2", PyFloat_FromDouble(ns.lowPass.z2));
 
@@ -84,6 +89,11 @@ static void unpackRegion(PyObject* o_region, tsf_region& region)
 {
 	region.loop_mode = (int)PyLong_AsLong(PyDict_GetItemString(o_region, "loop_mode"));
 	region.sample_rate = (unsigned)PyLong_AsUnsignedLong(PyDict_GetItemString(o_region, "sample_rate"));
+	region.lokey = (int)PyLong_AsLong(PyDict_GetItemString(o_region, "lokey"));
+	region.hikey = (int)PyLong_AsLong(PyDict_GetItemString(o_region, "hikey"));
+	region.lovel = (int)PyLong_AsLong(PyDict_GetItemString(o_region, "lovel"));
+	region.hivel = (int)PyLong_AsLong(PyDict_GetItemString(o_region, "hivel"));
+	region.group = (unsigned)PyLong_AsUnsignedLong(PyDict_GetItemString(o_region, "group"));
 	region.offset = (unsigned)PyLong_AsUnsignedLong(PyDict_GetItemString(o_region, "offset"));
 	region.end = (unsigned)PyLong_AsUnsignedLong(PyDict_GetItemString(o_region, "end"));
 	region.loop_start = (unsigned)PyLong_AsUnsignedLong(PyDict_GetItemString(o_region, "loop_start"));
@@ -136,6 +146,461 @@ static PyObject* SynthRegion(PyObject *self, PyObject *args)
 	return SynthRegion(input, region, key, vel, numSamples, outputmode, samplerate, global_gain_db);
 }
 
+typedef std::vector<SF2Bank_Deferred> SF2BankMap;
+static SF2BankMap s_SF2BankMap;
+
+static PyObject* SF2BankLoad(PyObject *self, PyObject *args)
+{
+	PyObject* filename = PyUnicode_EncodeFSDefault(PyTuple_GetItem(args, 0));
+	if (filename == nullptr) return NULL;
+
+	SF2Bank_Deferred bank;
+	if (!bank->Load(PyBytes_AsString(filename)))
+	{
+		PyErr_Format(PyExc_IOError, "cannot load sf2 file: %s", PyBytes_AsString(filename));
+		Py_DECREF(filename);
+		return NULL;
+	}
+	Py_DECREF(filename);
+
+	unsigned id = (unsigned)s_SF2BankMap.size();
+	s_SF2BankMap.push_back(bank);
+	return PyLong_FromUnsignedLong((unsigned long)(id));
+}
+
+static PyObject* SF2BankDel(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	s_SF2BankMap[id].Abondon();
+	return PyLong_FromLong(0);
+}
+
+static void setDictLong(PyObject* dict, const char* key, long v)
+{
+	PyObject* o = PyLong_FromLong(v);
+	PyDict_SetItemString(dict, key, o);
+	Py_DECREF(o);
+}
+
+static void setDictFloat(PyObject* dict, const char* key, double v)
+{
+	PyObject* o = PyFloat_FromDouble(v);
+	PyDict_SetItemString(dict, key, o);
+	Py_DECREF(o);
+}
+
+static PyObject* packEnvelope(const tsf_envelope& env)
+{
+	PyObject* o_env = PyDict_New();
+	setDictFloat(o_env, "delay", env.delay);
+	setDictFloat(o_env, "attack", env.attack);
+	setDictFloat(o_env, "hold", env.hold);
+	setDictFloat(o_env, "decay", env.decay);
+	setDictFloat(o_env, "sustain", env.sustain);
+	setDictFloat(o_env, "release", env.release);
+	setDictFloat(o_env, "keynumToHold", env.keynumToHold);
+	setDictFloat(o_env, "keynumToDecay", env.keynumToDecay);
+	return o_env;
+}
+
+// same layout as the regions of SF2Presets.LoadPresets()
+static PyObject* packRegion(const tsf_region& region)
+{
+	PyObject* o_region = PyDict_New();
+	setDictLong(o_region, "loop_mode", region.loop_mode);
+	setDictLong(o_region, "sample_rate", (long)region.sample_rate);
+	setDictLong(o_region, "lokey", region.lokey);
+	setDictLong(o_region, "hikey", region.hikey);
+	setDictLong(o_region, "lovel", region.lovel);
+	setDictLong(o_region, "hivel", region.hivel);
+	setDictLong(o_region, "group", (long)region.group);
+	setDictLong(o_region, "offset", (long)region.offset);
+	setDictLong(o_region, "end", (long)region.end);
+	setDictLong(o_region, "loop_start", (long)region.loop_start);
+	setDictLong(o_region, "loop_end", (long)region.loop_end);
+	setDictLong(o_region, "transpose", region.transpose);
+	setDictLong(o_region, "tune", region.tune);
+	setDictLong(o_region, "pitch_keycenter", region.pitch_keycenter);
+	setDictLong(o_region, "pitch_keytrack", region.pitch_keytrack);
+	setDictFloat(o_region, "attenuation", region.attenuation);
+	setDictFloat(o_region, "pan", region.pan);
+	PyObject* o_ampenv = packEnvelope(region.ampenv);
+	PyDict_SetItemString(o_region, "ampenv", o_ampenv);
+	Py_DECREF(o_ampenv);
+	PyObject* o_modenv = packEnvelope(region.modenv);
+	PyDict_SetItemString(o_region, "modenv", o_modenv);
+	Py_DECREF(o_modenv);
+	setDictLong(o_region, "initialFilterQ", region.initialFilterQ);
+	setDictLong(o_region, "initialFilterFc", region.initialFilterFc);
+	setDictLong(o_region, "modEnvToPitch", region.modEnvToPitch);
+	setDictLong(o_region, "modEnvToFilterFc", region.modEnvToFilterFc);
+	setDictLong(o_region, "modLfoToFilterFc", region.modLfoToFilterFc);
+	setDictLong(o_region, "modLfoToVolume", region.modLfoToVolume);
+	setDictFloat(o_region, "delayModLFO", region.delayModLFO);
+	setDictLong(o_region, "freqModLFO", region.freqModLFO);
+	setDictLong(o_region, "modLfoToPitch", region.modLfoToPitch);
+	setDictFloat(o_region, "delayVibLFO", region.delayVibLFO);
+	setDictLong(o_region, "freqVibLFO", region.freqVibLFO);
+	setDictLong(o_region, "vibLfoToPitch", region.vibLfoToPitch);
+	return o_region;
+}
+
+static PyObject* packPresetHeader(const SF2Preset& preset)
+{
+	PyObject* o_preset = PyDict_New();
+	PyObject* name = PyUnicode_FromStringAndSize(preset.presetName.c_str(), preset.presetName.size());
+	PyDict_SetItemString(o_preset, "presetName", name);
+	Py_DECREF(name);
+	setDictLong(o_preset, "bank", (long)preset.bank);
+	setDictLong(o_preset, "preset", (long)preset.preset);
+	setDictLong(o_preset, "regionNum", (long)preset.regions.size());
+	return o_preset;
+}
+
+static PyObject* SF2BankGetPresetList(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	const std::vector<SF2Preset>& presets = s_SF2BankMap[id]->Presets();
+	PyObject* ret = PyList_New(presets.size());
+	for (size_t i = 0; i < presets.size(); i++)
+		PyList_SetItem(ret, i, packPresetHeader(presets[i]));
+	return ret;
+}
+
+static PyObject* SF2BankGetPreset(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	unsigned index = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 1));
+	const std::vector<SF2Preset>& presets = s_SF2BankMap[id]->Presets();
+	if (index >= presets.size())
+	{
+		PyErr_SetString(PyExc_IndexError, "preset index out of range");
+		return NULL;
+	}
+	const SF2Preset& preset = presets[index];
+	PyObject* o_preset = packPresetHeader(preset);
+	PyObject* o_regions = PyList_New(preset.regions.size());
+	for (size_t i = 0; i < preset.regions.size(); i++)
+		PyList_SetItem(o_regions, i, packRegion(preset.regions[i]));
+	PyDict_SetItemString(o_preset, "regions", o_regions);
+	Py_DECREF(o_regions);
+	return o_preset;
+}
+
+/*
+Exports the mapped 16-bit sample pool through the buffer protocol. Each object
+holds a reference to the bank, so views of the pool keep the mapping alive
+after the Python SF2Bank is deleted.
+*/
+struct SF2SampleBufferObject
+{
+	PyObject_HEAD
+	SF2Bank_Deferred* bank;
+};
+
+static int SF2SampleBuffer_GetBuffer(PyObject* self, Py_buffer* view, int flags)
+{
+	SF2Bank* bank = *((SF2SampleBufferObject*)self)->bank;
+	static char s_empty[2];
+	char* p = bank->NumSamples() > 0 ? (char*)bank->Samples() : s_empty;
+	return PyBuffer_FillInfo(view, self, p, (Py_ssize_t)(bank->NumSamples() * sizeof(int16_t)), 1, flags);
+}
+
+static void SF2SampleBuffer_Dealloc(PyObject* self)
+{
+	delete ((SF2SampleBufferObject*)self)->bank;
+	Py_TYPE(self)->tp_free(self);
+}
+
+static PyBufferProcs s_SF2SampleBufferProcs;
+static PyTypeObject s_SF2SampleBufferType = { PyVarObject_HEAD_INIT(NULL, 0) };
+
+static bool s_InitSF2SampleBufferType()
+{
+	s_SF2SampleBufferProcs.bf_getbuffer = SF2SampleBuffer_GetBuffer;
+	s_SF2SampleBufferType.tp_name = "PySF2Synth.SF2SampleBuffer";
+	s_SF2SampleBufferType.tp_basicsize = sizeof(SF2SampleBufferObject);
+	s_SF2SampleBufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+	s_SF2SampleBufferType.tp_dealloc = SF2SampleBuffer_Dealloc;
+	s_SF2SampleBufferType.tp_as_buffer = &s_SF2SampleBufferProcs;
+	return PyType_Ready(&s_SF2SampleBufferType) == 0;
+}
+
+// read-only byte view of the mapped 16-bit sample pool
+static PyObject* SF2BankGetSamples(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	SF2SampleBufferObject* owner = PyObject_New(SF2SampleBufferObject, &s_SF2SampleBufferType);
+	if (owner == nullptr) return NULL;
+	owner->bank = new SF2Bank_Deferred(s_SF2BankMap[id]);
+	PyObject* view = PyMemoryView_FromObject((PyObject*)owner);
+	Py_DECREF(owner);
+	return view;
+}
+
+static PyObject* SF2BankGetF32Samples(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	SF2Bank* bank = s_SF2BankMap[id];
+	size_t count = bank->NumSamples();
+	const int16_t* samples = bank->Samples();
+
+	PyObject* ret = PyBytes_FromStringAndSize(nullptr, count * sizeof(float));
+	float* f32 = (float*)PyBytes_AsString(ret);
+	Py_BEGIN_ALLOW_THREADS
+	for (size_t i = 0; i < count; i++)
+		f32[i] = (float)samples[i] / 32767.0f;
+	Py_END_ALLOW_THREADS
+	return ret;
+}
+
+static PyObject* SF2BankSetResidencyBudget(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	unsigned long long bytes = PyLong_AsUnsignedLongLong(PyTuple_GetItem(args, 1));
+	s_SF2BankMap[id]->SetResidencyBudget(bytes > (unsigned long long)(size_t)-1 ? (size_t)-1 : (size_t)bytes);
+	return PyLong_FromLong(0);
+}
+
+static PyObject* SF2BankResidencyInfo(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	SF2Bank* bank = s_SF2BankMap[id];
+	PyObject* ret = PyDict_New();
+	PyObject* v;
+	PyDict_SetItemString(ret, "budget", v = PyLong_FromSize_t(bank->ResidencyBudget())); Py_DECREF(v);
+	PyDict_SetItemString(ret, "resident", v = PyLong_FromSize_t(bank->ResidentBytes())); Py_DECREF(v);
+	PyDict_SetItemString(ret, "ranges", v = PyLong_FromSize_t(bank->NumResidentRanges())); Py_DECREF(v);
+	PyDict_SetItemString(ret, "pinned", v = PyLong_FromSize_t(bank->NumPinnedRanges())); Py_DECREF(v);
+	return ret;
+}
+
+// SynthRegion() reading the 16-bit (24-bit with sm24) samples of a SF2Bank in place
+static PyObject* SynthRegionSF2Bank(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	SF2Bank* bank = s_SF2BankMap[id];
+	SynthInput input(bank->Samples(), bank->Samples24(), bank->Mips());
+
+	tsf_region region;
+	PyObject* o_region = PyTuple_GetItem(args, 1);
+	unpackRegion(o_region, region);
+
+	float key = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 2));
+	float vel = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 3));
+	unsigned numSamples = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 4));
+	OutputMode outputmode = (OutputMode)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 5));
+	float samplerate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 6));
+	float global_gain_db = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 7));
+
+	return SynthRegion(input, region, key, vel, numSamples, outputmode, samplerate, global_gain_db);
+}
+
+typedef std::vector<SF2CompiledPreset_Deferred> SF2CompiledPresetMap;
+static SF2CompiledPresetMap s_SF2CompiledPresetMap;
+
+static PyObject* SF2PresetCompileBank(PyObject *self, PyObject *args)
+{
+	unsigned bankId = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	unsigned index = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 1));
+	const SF2Bank_Deferred& bank = s_SF2BankMap[bankId];
+	if (index >= bank->Presets().size())
+	{
+		PyErr_SetString(PyExc_IndexError, "preset index out of range");
+		return NULL;
+	}
+
+	SF2CompiledPreset_Deferred preset;
+	preset->SetBank(bank, bank->Presets()[index]);
+
+	unsigned id = (unsigned)s_SF2CompiledPresetMap.size();
+	s_SF2CompiledPresetMap.push_back(preset);
+	return PyLong_FromUnsignedLong((unsigned long)(id));
+}
+
+// float32 sample pool + preset dict of SF2Presets.LoadPresets()
+static PyObject* SF2PresetCompile(PyObject *self, PyObject *args)
+{
+	PyObject* obj_input = PyTuple_GetItem(args, 0);
+	PyObject* o_regions = PyDict_GetItemString(PyTuple_GetItem(args, 1), "regions");
+
+	std::vector<tsf_region> regions(PyList_Size(o_regions));
+	for (size_t i = 0; i < regions.size(); i++)
+		unpackRegion(PyList_GetItem(o_regions, i), regions[i]);
+
+	SF2CompiledPreset_Deferred preset;
+	preset->SetF32(obj_input, regions);
+
+	unsigned id = (unsigned)s_SF2CompiledPresetMap.size();
+	s_SF2CompiledPresetMap.push_back(preset);
+	return PyLong_FromUnsignedLong((unsigned long)(id));
+}
+
+static PyObject* SF2PresetDel(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	s_SF2CompiledPresetMap[id].Abondon();
+	return PyLong_FromLong(0);
+}
+
+// never destroyed, items hold Python objects which must not be released after finalization
+static NoteCache* s_NoteCache = new NoteCache;
+
+static PyObject* NoteCacheSetBudget(PyObject *self, PyObject *args)
+{
+	unsigned long long bytes = PyLong_AsUnsignedLongLong(PyTuple_GetItem(args, 0));
+	s_NoteCache->SetBudget((size_t)bytes);
+	return PyLong_FromLong(0);
+}
+
+static PyObject* NoteCacheSetDiskDir(PyObject *self, PyObject *args)
+{
+	PyObject* o_dir = PyTuple_GetItem(args, 0);
+	std::string dir;
+	if (o_dir != Py_None)
+	{
+		PyObject* bytes = PyUnicode_EncodeFSDefault(o_dir);
+		if (bytes == nullptr) return NULL;
+		dir = std::string(PyBytes_AsString(bytes), (size_t)PyBytes_Size(bytes));
+		Py_DECREF(bytes);
+	}
+	s_NoteCache->SetDiskDir(dir);
+	return PyLong_FromLong(0);
+}
+
+static PyObject* NoteCacheClear(PyObject *self, PyObject *args)
+{
+	s_NoteCache->Clear();
+	return PyLong_FromLong(0);
+}
+
+static PyObject* NoteCacheGetInfo(PyObject *self, PyObject *args)
+{
+	return PackNoteCacheInfo(*s_NoteCache);
+}
+
+static PyObject* SynthNotePreset(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	SF2CompiledPreset* preset = s_SF2CompiledPresetMap[id];
+
+	double dkey = PyFloat_AsDouble(PyTuple_GetItem(args, 1));
+	double dvel = PyFloat_AsDouble(PyTuple_GetItem(args, 2));
+	float key = (float)dkey;
+	float vel = (float)dvel;
+	unsigned numSamples = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 3));
+	OutputMode outputmode = (OutputMode)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 4));
+	float samplerate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 5));
+	float global_gain_db = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 6));
+
+	NoteKey noteKey("SF2:2");
+	noteKey.Add(preset->ContentHash()).Add(dkey).Add(dvel).Add(numSamples).Add(outputmode).Add(samplerate).Add(global_gain_db);
+	unsigned cachedSamples;
+	PyObject* cached = s_NoteCache->Find(noteKey, cachedSamples);
+	if (cached != nullptr)
+	{
+		PyObject* ret = PyTuple_New(2);
+		PyTuple_SetItem(ret, 0, PyLong_FromUnsignedLong(cachedSamples));
+		PyTuple_SetItem(ret, 1, cached);
+		return ret;
+	}
+
+	std::vector<const tsf_region*> regions(preset->Regions().size() + 1);
+	unsigned numRegions = preset->Lookup((int)(dkey + 0.5), (int)(dvel * 127), regions.data());
+
+	PyObject* ret = SynthRegions(preset->Input(), regions.data(), numRegions, key, vel, numSamples, outputmode, samplerate, global_gain_db);
+	PyObject* data = PyTuple_GetItem(ret, 1);
+	if (data != Py_None)
+		s_NoteCache->Insert(noteKey, data, (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(ret, 0)));
+	return ret;
+}
+
+static double getSeqFloat(PyObject* seq, ssize_t i)
+{
+	PyObject* item = PySequence_GetItem(seq, i);
+	double v = PyFloat_AsDouble(item);
+	Py_XDECREF(item);
+	return v;
+}
+
+// notes -- list of (onset in ms, key, vel, duration in ms), mixed into one buffer starting at 0
+static PyObject* RenderNotesPreset(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	SF2CompiledPreset_Deferred preset = s_SF2CompiledPresetMap[id];
+	PyObject* o_notes = PySequence_Fast(PyTuple_GetItem(args, 1), "notes must be a sequence");
+	if (o_notes == nullptr) return NULL;
+	OutputMode outputmode = (OutputMode)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 2));
+	float samplerate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 3));
+	float global_gain_db = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 4));
+	unsigned numThreads = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 5));
+
+	unsigned numNotes = (unsigned)PySequence_Fast_GET_SIZE(o_notes);
+	size_t numPresetRegions = preset->Regions().size();
+	std::vector<SF2NoteEvent> events(numNotes);
+	std::vector<const tsf_region*> regions(numNotes * (numPresetRegions + 1));
+	for (unsigned i = 0; i < numNotes; i++)
+	{
+		PyObject* o_note = PySequence_Fast_GET_ITEM(o_notes, i);
+		double onset = getSeqFloat(o_note, 0);
+		double dkey = getSeqFloat(o_note, 1);
+		double dvel = getSeqFloat(o_note, 2);
+		double duration = getSeqFloat(o_note, 3);
+		if (PyErr_Occurred())
+		{
+			Py_DECREF(o_notes);
+			return NULL;
+		}
+		// also rejects NaNs, offsets are unsigned sample positions
+		if (!(onset >= 0.0) || !(duration >= 0.0))
+		{
+			Py_DECREF(o_notes);
+			PyErr_SetString(PyExc_ValueError, "note onsets and durations must not be negative");
+			return NULL;
+		}
+		if ((onset + duration) * samplerate * 0.001 >= 4294967295.0)
+		{
+			Py_DECREF(o_notes);
+			PyErr_SetString(PyExc_ValueError, "note ends beyond the sample range");
+			return NULL;
+		}
+
+		SF2NoteEvent& e = events[i];
+		e.onset = (unsigned)(onset * samplerate * 0.001 + 0.5);
+		e.key = (float)dkey;
+		e.vel = (float)dvel;
+		e.numSamples = (unsigned)(duration * samplerate * 0.001 + 0.5);
+		const tsf_region** noteRegions = regions.data() + i * (numPresetRegions + 1);
+		e.regions = noteRegions;
+		e.numRegions = preset->Lookup((int)(dkey + 0.5), (int)(dvel * 127), noteRegions);
+	}
+	Py_DECREF(o_notes);
+
+	std::stable_sort(events.begin(), events.end(), [](const SF2NoteEvent& a, const SF2NoteEvent& b)
+	{
+		return a.onset < b.onset;
+	});
+
+	std::vector<float> out;
+	unsigned numSamples;
+	Py_BEGIN_ALLOW_THREADS
+	numSamples = RenderNotes(preset->Input(), events.data(), numNotes, outputmode, samplerate, global_gain_db, numThreads, out);
+	Py_END_ALLOW_THREADS
+
+	PyObject* ret = PyTuple_New(2);
+	PyTuple_SetItem(ret, 0, PyLong_FromUnsignedLong(numSamples));
+	if (numSamples > 0)
+	{
+		PyTuple_SetItem(ret, 1, PyBytes_FromStringAndSize((const char*)out.data(), sizeof(float)*out.size()));
+	}
+	else
+	{
+		Py_INCREF(Py_None);
+		PyTuple_SetItem(ret, 1, Py_None);
+	}
+	return ret;
+}
+
 static PyMethodDef s_Methods[] = {
 	{
 		"Synth",
@@ -149,6 +614,114 @@ static PyMethodDef s_Methods[] = {
 		METH_VARARGS,
 		""
 	},
+	{
+		"SF2BankLoad",
+		SF2BankLoad,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2BankDel",
+		SF2BankDel,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2BankGetPresetList",
+		SF2BankGetPresetList,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2BankGetPreset",
+		SF2BankGetPreset,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2BankGetSamples",
+		SF2BankGetSamples,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2BankGetF32Samples",
+		SF2BankGetF32Samples,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2BankSetResidencyBudget",
+		SF2BankSetResidencyBudget,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2BankResidencyInfo",
+		SF2BankResidencyInfo,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SynthRegionSF2Bank",
+		SynthRegionSF2Bank,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2PresetCompileBank",
+		SF2PresetCompileBank,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2PresetCompile",
+		SF2PresetCompile,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SF2PresetDel",
+		SF2PresetDel,
+		METH_VARARGS,
+		""
+	},
+	{
+		"SynthNotePreset",
+		SynthNotePreset,
+		METH_VARARGS,
+		""
+	},
+	{
+		"RenderNotesPreset",
+		RenderNotesPreset,
+		METH_VARARGS,
+		""
+	},
+	{
+		"NoteCacheSetBudget",
+		NoteCacheSetBudget,
+		METH_VARARGS,
+		""
+	},
+	{
+		"NoteCacheSetDiskDir",
+		NoteCacheSetDiskDir,
+		METH_VARARGS,
+		""
+	},
+	{
+		"NoteCacheClear",
+		NoteCacheClear,
+		METH_VARARGS,
+		""
+	},
+	{
+		"NoteCacheGetInfo",
+		NoteCacheGetInfo,
+		METH_VARARGS,
+		""
+	},
 	{ NULL, NULL, 0, NULL }
 };
 
@@ -164,5 +737,6 @@ static struct PyModuleDef cModPyDem =
 
 PyMODINIT_FUNC PyInit_PySF2Synth(void)
 {
+	if (!s_InitSF2SampleBufferType()) return NULL;
 	return PyModule_Create(&cModPyDem);
 }
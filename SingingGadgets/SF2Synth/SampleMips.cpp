@@ -0,0 +1,130 @@
+#include "SampleMips.h"
+#include <cmath>
+#include <tuple>
+
+// Kaiser windowed-sinc half-band filter of 4*s_halfTaps-1 taps, every other tap beside the center is 0
+static const int s_halfTaps = 16;
+static const double s_kaiserBeta = 6.0;
+
+static double BesselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+struct HalfBand
+{
+	float center;
+	float taps[s_halfTaps];
+
+	HalfBand()
+	{
+		const double pi = 3.14159265358979323846;
+		const double m = (double)(s_halfTaps * 2);
+		double t[s_halfTaps];
+		double sum = 0.5;
+		for (int i = 0; i < s_halfTaps; i++)
+		{
+			int n = i * 2 + 1;
+			double x = pi * (double)n * 0.5;
+			double r = (double)n / m;
+			double w = BesselI0(s_kaiserBeta * sqrt(1.0 - r * r)) / BesselI0(s_kaiserBeta);
+			t[i] = 0.5 * sin(x) / x * w;
+			sum += 2.0 * t[i];
+		}
+		// unity gain at DC
+		center = (float)(0.5 / sum);
+		for (int i = 0; i < s_halfTaps; i++)
+			taps[i] = (float)(t[i] / sum);
+	}
+};
+
+// samples inside the loop [loopStart, loopEnd] read the ones across its boundary 
+// as the loop is played, loopEnd < loopStart when there is no loop
+static void Downsample(const std::vector<float>& in, std::vector<float>& out, int loopStart, int loopEnd)
+{
+	static const HalfBand hb;
+	int len = (int)in.size();
+	int loopLength = loopEnd - loopStart + 1;
+	out.resize((in.size() + 1) / 2);
+	for (int j = 0; j < (int)out.size(); j++)
+	{
+		int i = j * 2;
+		bool inLoop = i >= loopStart && i <= loopEnd;
+		float v = in[i] * hb.center;
+		for (int k = 0; k < s_halfTaps; k++)
+		{
+			int d = k * 2 + 1;
+			int i0 = i - d;
+			int i1 = i + d;
+			if (inLoop)
+			{
+				while (i0 < loopStart) i0 += loopLength;
+				while (i1 > loopEnd) i1 -= loopLength;
+			}
+			if (i0 < 0) i0 = 0;
+			if (i1 >= len) i1 = len - 1;
+			v += (in[i0] + in[i1]) * hb.taps[k];
+		}
+		out[j] = v;
+	}
+}
+
+SampleMipLevels::SampleMipLevels(unsigned start, unsigned end, unsigned loopStart, unsigned loopEnd)
+	: start(start), end(end), loopStart(loopStart), loopEnd(loopEnd)
+{
+	for (unsigned k = 0; k <= MaxLevel; k++)
+		ready[k].store(nullptr, std::memory_order_relaxed);
+}
+
+SampleMipLevels* SampleMipCache::Find(unsigned start, unsigned end, unsigned loopStart, unsigned loopEnd)
+{
+	if (loopEnd <= loopStart || loopStart < start || loopEnd >= end)
+		loopStart = loopEnd = 0;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Key key(std::make_pair(start, end), std::make_pair(loopStart, loopEnd));
+	std::map<Key, SampleMipLevels>::iterator it = m_samples.find(key);
+	if (it == m_samples.end())
+	{
+		it = m_samples.emplace(std::piecewise_construct, std::forward_as_tuple(key), 
+			std::forward_as_tuple(start, end, loopStart, loopEnd)).first;
+	}
+	return &it->second;
+}
+
+const float* SampleMipCache::_build(const SynthInput& input, SampleMipLevels& levels, unsigned level)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (levels.data[level].empty())
+	{
+		unsigned start = levels.start;
+		unsigned end = levels.end;
+		bool looped = levels.loopEnd > levels.loopStart;
+		int loopStart = looped ? (int)(levels.loopStart - start) : 0;
+		int loopEnd = looped ? (int)(levels.loopEnd - start) : -1;
+
+		// level 0 is only kept while building
+		std::vector<float> source;
+		unsigned k = level;
+		while (k > 1 && levels.data[k - 1].empty()) k--;
+		if (k == 1)
+		{
+			source.resize(end > start ? end - start : 1, 0.0f);
+			ReadSamples(input, start, end - start, source.data());
+			Downsample(source, levels.data[1], loopStart, loopEnd);
+			levels.ready[1].store(levels.data[1].data(), std::memory_order_release);
+			k = 2;
+		}
+		for (; k <= level; k++)
+		{
+			Downsample(levels.data[k - 1], levels.data[k], loopStart >> (k - 1), looped ? loopEnd >> (k - 1) : -1);
+			levels.ready[k].store(levels.data[k].data(), std::memory_order_release);
+		}
+	}
+	return levels.data[level].data();
+}
@@ -0,0 +1,67 @@
+#ifndef _SampleMips_h
+#define _SampleMips_h
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include "Synth.h"
+
+/*
+Half-rate levels of the samples of a pool, built on first use. Level k of 
+the sample [start, end) holds one sample for every 2^k source samples, 
+low-passed by a half-band filter at each step. Level 0 is the pool itself.
+Inside the loop of a looped sample, the filter reads across the loop 
+boundary the way the loop is played.
+A voice looks up the levels of its sample once, with Find(). Reading a 
+level that is already built doesn't lock, so rendering threads only wait 
+for each other while a level is being built. Levels are never released 
+before the cache, so the returned pointers stay valid.
+*/
+struct SampleMipLevels
+{
+	enum { MaxLevel = 8 };
+
+	unsigned start, end, loopStart, loopEnd;
+	std::vector<float> data[MaxLevel + 1];
+	// data[k].data() once level k is built
+	std::atomic<const float*> ready[MaxLevel + 1];
+
+	SampleMipLevels(unsigned start, unsigned end, unsigned loopStart, unsigned loopEnd);
+};
+
+class SampleMipCache
+{
+public:
+	enum { MaxLevel = SampleMipLevels::MaxLevel };
+
+	SampleMipCache() {}
+
+	// levels of the sample [start, end), loopEnd <= loopStart if it isn't looped
+	SampleMipLevels* Find(unsigned start, unsigned end, unsigned loopStart, unsigned loopEnd);
+
+	// level 1..MaxLevel of the sample, 'length' receives its number of samples
+	const float* Level(const SynthInput& input, SampleMipLevels& levels, unsigned level, unsigned& length);
+
+private:
+	SampleMipCache(const SampleMipCache&);
+	void operator=(const SampleMipCache&);
+
+	const float* _build(const SynthInput& input, SampleMipLevels& levels, unsigned level);
+
+	typedef std::pair<std::pair<unsigned, unsigned>, std::pair<unsigned, unsigned> > Key;
+
+	std::mutex m_mutex;
+	std::map<Key, SampleMipLevels> m_samples;
+};
+
+inline const float* SampleMipCache::Level(const SynthInput& input, SampleMipLevels& levels, unsigned level, unsigned& length)
+{
+	const float* data = levels.ready[level].load(std::memory_order_acquire);
+	if (data == nullptr) data = _build(input, levels, level);
+	length = (unsigned)levels.data[level].size();
+	return data;
+}
+
+#endif
@@ -1,130 +1,316 @@
 #include "Synth.h"
+#include "SampleMips.h"
+#include "FixedPhase.h"
 #include <cmath>
 
-void Synth(const float* input, float* outputBuffer, unsigned numSamples, NoteState& noteState, const SynthCtrl& control)
+struct InputS16
 {
-	float* outL = outputBuffer;
-	float* outR = (control.outputmode == STEREO_UNWEAVED ? outL + numSamples : nullptr);
+	const int16_t* s16;
+	float operator[](int i) const
+	{
+		return (float)s16[i] * (1.0f / 32767.0f);
+	}
+};
 
-	unsigned tmpLoopStart = control.loopStart;
-	unsigned tmpLoopEnd = control.loopEnd;
-	unsigned tmpEnd = control.end;
-	double tmpSourceSamplePosition = noteState.sourceSamplePosition;
+struct InputS24
+{
+	const int16_t* s16;
+	const uint8_t* s24;
+	float operator[](int i) const
+	{
+		return (float)((int)s16[i] * 256 + (int)s24[i]) * (1.0f / (32767.0f*256.0f));
+	}
+};
 
-	double tmpSampleEndDbl = (double)tmpEnd;
-	double tmpLoopEndDbl = (double)tmpLoopEnd + 1.0;
+// per block constants of a voice
+struct BlockParams
+{
+	unsigned loopStart, loopEnd, end;
+	FixedPhase sampleEnd, loopEndPhase, loopLength;
+	double pitchRatio;
+	FixedPhase step;
+	float gainLeft, gainRight, gainMono;
+	LowPassCtrlPnt lowPass;
+};
 
-	unsigned i_ctrl = 0;
-	SynthCtrlPnt ctrlPnt;
+struct VoiceCursor
+{
+	FixedPhase pos;
+	LowPassState lowPass;
+	float* outL;
+	float* outR;
+};
 
-	LowPassState lowPassState = noteState.lowPass;
+// Decisions that are constant over a block are template parameters, 
+// one instance for each combination.
+template<class TInput, OutputMode outputmode, bool lowPass, bool looping, bool interpolation>
+static void SynthBlock(const TInput& input, const BlockParams& bp, int blockSamples, VoiceCursor& cur)
+{
+	FixedPhase pos = cur.pos;
+	FixedPhase halfStep = bp.step >> 1;
+	LowPassState lps = cur.lowPass;
+	float* outL = cur.outL;
+	float* outR = cur.outR;
 
-	while (numSamples)
+	while (blockSamples-- && pos < bp.sampleEnd)
 	{
-		float gainLeft, gainRight;
-		int blockSamples = (numSamples > control.effect_sample_block ? control.effect_sample_block : numSamples);
-		numSamples -= blockSamples;
-
-		if (i_ctrl<control.controlPnts.size())
-			ctrlPnt = control.controlPnts[i_ctrl];
-		else
-			break;
-
-		float gainMono = ctrlPnt.gainMono;
-		double pitchRatio = ctrlPnt.pitchRatio;
-		bool interpolation = pitchRatio <= 1.0f;
+		float val = 0.0f;
+		if (interpolation)
+		{
+			int ipos1 = FixedPhaseIndex(pos);
+			float frac = FixedPhaseFrac(pos);
+			int ipos2 = ipos1 + 1;
+			int ipos3 = ipos1 + 2;
+			int ipos0 = ipos1 - 1;
 
-		gainLeft = gainMono *control.panFactorLeft;
-		gainRight = gainMono  * control.panFactorRight;
+			if (looping && ipos1 > (int)bp.loopEnd)
+			{
+				ipos2 = bp.loopStart;
+				ipos3 = bp.loopStart + 1;
+			}
+			if (ipos2 >= (int)bp.end) ipos2 = bp.end - 1;
+			if (ipos3 >= (int)bp.end) ipos3 = bp.end - 1;
+			if (ipos0 < 0) ipos0 = 0;
 
-		LowPassCtrlPnt lowPassCtrlPnt = ctrlPnt.lowPass;
+			float p0 = input[ipos0];
+			float p1 = input[ipos1];
+			float p2 = input[ipos2];
+			float p3 = input[ipos3];
 
-		while (blockSamples-- && tmpSourceSamplePosition < tmpSampleEndDbl)
+			// cubic Hermite, Horner form
+			float a = -0.5f*p0 + 1.5f*p1 - 1.5f*p2 + 0.5f*p3;
+			float b = p0 - 2.5f*p1 + 2.0f*p2 - 0.5f*p3;
+			float c = -0.5f*p0 + 0.5f*p2;
+			val = ((a*frac + b)*frac + c)*frac + p1;
+		}
+		else
 		{
-			float val = 0.0f;
-			if (interpolation)
+			int ipos1 = FixedPhaseCeil(pos - halfStep);
+			int ipos2 = FixedPhaseIndex(pos + halfStep);
+			int count = ipos2 - ipos1 + 1;
+			for (int ipos = ipos1; ipos <= ipos2; ipos++)
 			{
-				int ipos1 = (int)tmpSourceSamplePosition;
-				float frac = (float)(tmpSourceSamplePosition - (double)ipos1);
-				int ipos2 = ipos1 + 1;
-				int ipos3 = ipos1 + 2;
-				int ipos0 = ipos1 - 1;
-
-				if (ipos1 > (int)tmpLoopEnd && ctrlPnt.looping)
+				int _ipos = ipos;
+				if (_ipos < 0) _ipos = 0;
+				if (looping && _ipos > (int)bp.loopEnd)
 				{
-					ipos2 = tmpLoopStart;
-					ipos3 = tmpLoopStart + 1;
+					_ipos += (int)bp.loopStart - (int)bp.loopEnd - 1;
 				}
-				if (ipos2 >= (int)tmpEnd) ipos2 = tmpEnd - 1;
-				if (ipos3 >= (int)tmpEnd) ipos3 = tmpEnd - 1;
-				if (ipos0 < 0) ipos0 = 0;
-
-				float p0 = input[ipos0];
-				float p1 = input[ipos1];
-				float p2 = input[ipos2];
-				float p3 = input[ipos3];
-
-				val = (-0.5f*p0 + 1.5f*p1 - 1.5f*p2 + 0.5f*p3)*powf(frac, 3.0f) +
-					(p0 - 2.5f*p1 + 2.0f*p2 - 0.5f*p3)*powf(frac, 2.0f) +
-					(-0.5f*p0 + 0.5f*p2)*frac + p1;
-			}
-			else
-			{
-				int ipos1 = (int)ceil(tmpSourceSamplePosition - 0.5* pitchRatio);
-				int ipos2 = (int)floor(tmpSourceSamplePosition + 0.5* pitchRatio);
-				int count = ipos2 - ipos1 + 1;
-				for (int ipos = ipos1; ipos <= ipos2; ipos++)
+				if (_ipos >= (int)bp.end)
 				{
-					int _ipos = ipos;
-					if (_ipos < 0) _ipos = 0;
-					if (_ipos > (int)tmpLoopEnd && ctrlPnt.looping)
-					{
-						_ipos += (int)tmpLoopStart - (int)tmpLoopEnd -1;
-					}
-					if (_ipos >= (int)tmpEnd)
-					{
-						_ipos = tmpEnd - 1;
-					}
-					val += input[_ipos];
+					_ipos = bp.end - 1;
 				}
-				val /= (float)count;
+				val += input[_ipos];
 			}
+			val /= (float)count;
+		}
 
-			if (lowPassCtrlPnt.active)
-			{
-				double In = val;
-				val = (float)(In * lowPassCtrlPnt.a0 + lowPassState.z1);
-				lowPassState.z1 = In * lowPassCtrlPnt.a1 + lowPassState.z2 - lowPassCtrlPnt.b1 * val; 
-				lowPassState.z2 = In * lowPassCtrlPnt.a0 - lowPassCtrlPnt.b2 * val; 
-			}
+		if (lowPass)
+		{
+			double In = val;
+			val = (float)(In * bp.lowPass.a0 + lps.z1);
+			lps.z1 = In * bp.lowPass.a1 + lps.z2 - bp.lowPass.b1 * val;
+			lps.z2 = In * bp.lowPass.a0 - bp.lowPass.b2 * val;
+		}
 
-			switch (control.outputmode)
-			{
-			case STEREO_INTERLEAVED:
-				*outL++ += val * gainLeft;
-				*outL++ += val * gainRight;
-				break;
-			case STEREO_UNWEAVED:
-				*outL++ += val * gainLeft;
-				*outR++ += val * gainRight;
-				break;
-			case MONO:
-				*outL++ += val * gainMono;
-				break;
-			}
-			// Next sample.
-			tmpSourceSamplePosition += pitchRatio;
-			if (tmpSourceSamplePosition >= tmpLoopEndDbl && ctrlPnt.looping) 
-				tmpSourceSamplePosition -= (tmpLoopEnd - tmpLoopStart + 1.0f);
+		if (outputmode == STEREO_INTERLEAVED)
+		{
+			*outL++ += val * bp.gainLeft;
+			*outL++ += val * bp.gainRight;
+		}
+		else if (outputmode == STEREO_UNWEAVED)
+		{
+			*outL++ += val * bp.gainLeft;
+			*outR++ += val * bp.gainRight;
+		}
+		else
+		{
+			*outL++ += val * bp.gainMono;
+		}
+
+		// Next sample.
+		pos += bp.step;
+		if (looping && pos >= bp.loopEndPhase)
+			pos -= bp.loopLength;
+	}
+
+	cur.pos = pos;
+	cur.lowPass = lps;
+	cur.outL = outL;
+	cur.outR = outR;
+}
 
+template<class TInput, OutputMode outputmode, bool lowPass, bool looping>
+static void SynthBlockI(const TInput& input, const BlockParams& bp, int blockSamples, VoiceCursor& cur, bool interpolation)
+{
+	if (interpolation) SynthBlock<TInput, outputmode, lowPass, looping, true>(input, bp, blockSamples, cur);
+	else SynthBlock<TInput, outputmode, lowPass, looping, false>(input, bp, blockSamples, cur);
+}
+
+template<class TInput, OutputMode outputmode, bool lowPass>
+static void SynthBlockL(const TInput& input, const BlockParams& bp, int blockSamples, VoiceCursor& cur, bool looping, bool interpolation)
+{
+	if (looping) SynthBlockI<TInput, outputmode, lowPass, true>(input, bp, blockSamples, cur, interpolation);
+	else SynthBlockI<TInput, outputmode, lowPass, false>(input, bp, blockSamples, cur, interpolation);
+}
+
+template<class TInput, OutputMode outputmode>
+static void SynthBlockF(const TInput& input, const BlockParams& bp, int blockSamples, VoiceCursor& cur, bool looping, bool interpolation)
+{
+	if (bp.lowPass.active) SynthBlockL<TInput, outputmode, true>(input, bp, blockSamples, cur, looping, interpolation);
+	else SynthBlockL<TInput, outputmode, false>(input, bp, blockSamples, cur, looping, interpolation);
+}
+
+template<class TInput>
+static void SynthBlockT(const TInput& input, const BlockParams& bp, OutputMode outputmode, bool looping, unsigned blockSamples, VoiceCursor& cur)
+{
+	bool interpolation = bp.pitchRatio <= 1.0f;
+	switch (outputmode)
+	{
+	case STEREO_INTERLEAVED:
+		SynthBlockF<TInput, STEREO_INTERLEAVED>(input, bp, (int)blockSamples, cur, looping, interpolation);
+		break;
+	case STEREO_UNWEAVED:
+		SynthBlockF<TInput, STEREO_UNWEAVED>(input, bp, (int)blockSamples, cur, looping, interpolation);
+		break;
+	case MONO:
+		SynthBlockF<TInput, MONO>(input, bp, (int)blockSamples, cur, looping, interpolation);
+		break;
+	}
+}
+
+// Plays the block from the mip level where the pitch ratio is in [1, 2), so at 
+// most 3 samples are averaged for each output sample whatever the ratio. 
+// Positions are shifted into the level and back, loop points keep their 
+// fractional position so the loop length and the pitch are unchanged.
+static bool SynthBlockMip(const SynthInput& input, const SynthCtrl& control, SampleMipLevels& levels, BlockParams& bp, bool looping, unsigned blockSamples, VoiceCursor& cur)
+{
+	unsigned level = 0;
+	double ratio = bp.pitchRatio;
+	while (ratio >= 2.0 && level < SampleMipCache::MaxLevel)
+	{
+		ratio *= 0.5;
+		level++;
+	}
+	FixedPhase start = (FixedPhase)control.start << 32;
+
+	unsigned length;
+	const float* samples = input.mips->Level(input, levels, level, length);
+
+	bp.pitchRatio = ratio;
+	bp.step >>= level;
+	bp.end = length;
+	bp.sampleEnd = (bp.sampleEnd - start) >> level;
+	if (looping)
+	{
+		bp.loopStart = (bp.loopStart - control.start) >> level;
+		bp.loopEnd = (bp.loopEnd - control.start) >> level;
+		bp.loopEndPhase = (bp.loopEndPhase - start) >> level;
+		bp.loopLength >>= level;
+	}
+
+	cur.pos = (cur.pos - start) >> level;
+	SynthBlockT(samples, bp, control.outputmode, looping, blockSamples, cur);
+	cur.pos = (cur.pos << level) + start;
+	return cur.pos < ((FixedPhase)control.end << 32);
+}
+
+bool SynthBlock(const SynthInput& input, const SynthCtrl& control, const SynthCtrlPnt& ctrlPnt, unsigned blockSamples, NoteState& noteState, float*& outL, float*& outR)
+{
+	BlockParams bp;
+	bp.loopStart = control.loopStart;
+	bp.loopEnd = control.loopEnd;
+	bp.end = control.end;
+	bp.sampleEnd = (FixedPhase)control.end << 32;
+	bp.loopEndPhase = ((FixedPhase)control.loopEnd + 1) << 32;
+	bp.loopLength = ((FixedPhase)control.loopEnd - (FixedPhase)control.loopStart + 1) << 32;
+	bp.gainMono = ctrlPnt.gainMono;
+	bp.pitchRatio = ctrlPnt.pitchRatio;
+	bp.step = ToFixedPhase(ctrlPnt.pitchRatio);
+	bp.gainLeft = ctrlPnt.gainMono * control.panFactorLeft;
+	bp.gainRight = ctrlPnt.gainMono * control.panFactorRight;
+	bp.lowPass = ctrlPnt.lowPass;
+
+	bool looping = ctrlPnt.looping != 0;
+
+	VoiceCursor cur;
+	cur.pos = noteState.sourceSamplePosition;
+	cur.lowPass = noteState.lowPass;
+	cur.outL = outL;
+	cur.outR = outR;
+
+	bool more;
+	if (input.mips != nullptr && bp.pitchRatio >= 2.0 && control.end > control.start && (!looping || control.loopStart >= control.start))
+	{
+		if (noteState.mips == nullptr)
+			noteState.mips = input.mips->Find(control.start, control.end, control.loopStart, control.loopEnd);
+		more = SynthBlockMip(input, control, *noteState.mips, bp, looping, blockSamples, cur);
+	}
+	else
+	{
+		if (input.f32 != nullptr)
+		{
+			SynthBlockT(input.f32, bp, control.outputmode, looping, blockSamples, cur);
+		}
+		else if (input.s24 != nullptr)
+		{
+			InputS24 in = { input.s16, input.s24 };
+			SynthBlockT(in, bp, control.outputmode, looping, blockSamples, cur);
 		}
+		else
+		{
+			InputS16 in = { input.s16 };
+			SynthBlockT(in, bp, control.outputmode, looping, blockSamples, cur);
+		}
+		more = cur.pos < bp.sampleEnd;
+	}
+
+	noteState.sourceSamplePosition = cur.pos;
+	noteState.lowPass = cur.lowPass;
+	outL = cur.outL;
+	outR = cur.outR;
+	return more;
+}
+
+template<class TInput>
+static void ReadSamplesT(const TInput& input, unsigned start, unsigned count, float* out)
+{
+	for (unsigned i = 0; i < count; i++)
+		out[i] = input[(int)(start + i)];
+}
 
-		if (tmpSourceSamplePosition >= tmpSampleEndDbl)
+void ReadSamples(const SynthInput& input, unsigned start, unsigned count, float* out)
+{
+	if (input.f32 != nullptr)
+	{
+		ReadSamplesT(input.f32, start, count, out);
+	}
+	else if (input.s24 != nullptr)
+	{
+		InputS24 in = { input.s16, input.s24 };
+		ReadSamplesT(in, start, count, out);
+	}
+	else
+	{
+		InputS16 in = { input.s16 };
+		ReadSamplesT(in, start, count, out);
+	}
+}
+
+void Synth(const SynthInput& input, float* outputBuffer, unsigned numSamples, NoteState& noteState, const SynthCtrl& control)
+{
+	float* outL = outputBuffer;
+	float* outR = (control.outputmode == STEREO_UNWEAVED ? outL + numSamples : nullptr);
+
+	unsigned i_ctrl = 0;
+	while (numSamples && i_ctrl < control.controlPnts.size())
+	{
+		unsigned blockSamples = (numSamples > control.effect_sample_block ? control.effect_sample_block : numSamples);
+		numSamples -= blockSamples;
+
+		if (!SynthBlock(input, control, control.controlPnts[i_ctrl], blockSamples, noteState, outL, outR))
 			break;
 
 		i_ctrl++;
 	}
-
-	noteState.sourceSamplePosition= tmpSourceSamplePosition;
-	noteState.lowPass = lowPassState;
 }
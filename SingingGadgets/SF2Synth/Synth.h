@@ -2,16 +2,23 @@
 #define _Synth_h
 
 #include <vector>
+#include <stdint.h>
+#include "FixedPhase.h"
 
 struct LowPassState
 {
 	double z1, z2;
 };
 
+struct SampleMipLevels;
+
 struct NoteState
 {
-	double sourceSamplePosition;
+	FixedPhase sourceSamplePosition; // 32.32 fixed-point
 	LowPassState lowPass;
+	SampleMipLevels* mips; // levels of the voice's sample, looked up once when first needed
+
+	NoteState() : mips(nullptr) {}
 };
 
 struct LowPassCtrlPnt
@@ -42,6 +49,7 @@ enum OutputMode
 struct SynthCtrl
 {
 	OutputMode outputmode;
+	unsigned start;
 	unsigned loopStart, loopEnd;
 	unsigned end;
 	float panFactorLeft, panFactorRight;
@@ -49,6 +57,33 @@ struct SynthCtrl
 	std::vector<SynthCtrlPnt> controlPnts;
 };
 
-void Synth(const float* input, float* outputBuffer, unsigned numSamples, NoteState& noteState, const SynthCtrl& control);
+class SampleMipCache;
+
+// Sample pool, either float samples or the 16-bit samples of a SF2 bank, 
+// with the sm24 low bytes when available. 16/24-bit samples are converted 
+// while interpolating.
+// With a mip cache, samples played faster than their rate are read from
+// a band-limited level of half rate instead of being box filtered.
+struct SynthInput
+{
+	const float* f32;
+	const int16_t* s16;
+	const uint8_t* s24;
+	SampleMipCache* mips;
+
+	SynthInput(const float* f32, SampleMipCache* mips = nullptr) : f32(f32), s16(nullptr), s24(nullptr), mips(mips) {}
+	SynthInput(const int16_t* s16, const uint8_t* s24, SampleMipCache* mips = nullptr) : f32(nullptr), s16(s16), s24(s24), mips(mips) {}
+};
+
+// samples [start, start+count) of the pool as floats
+void ReadSamples(const SynthInput& input, unsigned start, unsigned count, float* out);
+
+void Synth(const SynthInput& input, float* outputBuffer, unsigned numSamples, NoteState& noteState, const SynthCtrl& control);
+
+// One block of at most control.effect_sample_block samples with the given control point, 
+// control.controlPnts is not used. outL/outR are advanced. 
+// Returns false once the end of the sample is reached.
+bool SynthBlock(const SynthInput& input, const SynthCtrl& control, const SynthCtrlPnt& ctrlPnt, unsigned blockSamples, 
+	NoteState& noteState, float*& outL, float*& outR);
 
 #endif
@@ -1 +1,49 @@
 from .PySimpleInstruments import *
+from . import PySimpleInstruments
+
+# Oscillator types of GenerateNotes()
+PURE_SIN = 0
+SQUARE = 1
+TRIANGLE = 2
+SAWTOOTH = 3
+NAIVE_PIANO = 4
+BOTTLE_BLOW = 5
+
+def GenerateNotes(osc_type, notes, sampleRate):
+	'''
+	Renders a chord or a note list of one simple instrument in one call.
+	notes -- list of (onset, freq, duration), onset and duration in ms, not negative
+	Returns a mono wav buffer starting at onset 0, with every note mixed in.
+	'''
+	return PySimpleInstruments.GenerateNotes(osc_type, notes, sampleRate)
+
+
+# Built-in tables of GenerateWavetable()
+WT_SINE = 0
+WT_NAIVE_PIANO = 1
+WT_SQUARE = 2
+WT_TRIANGLE = 3
+WT_SAWTOOTH = 4
+
+def AddWavetable(cycle):
+	'''
+	Registers a new timbre for GenerateWavetable().
+	cycle -- list of the samples of one period, of any length
+	Returns the table id. The table is band-limited per octave when played.
+	'''
+	return PySimpleInstruments.AddWavetable(cycle)
+
+def DelWavetable(table_id):
+	'''
+	Frees a table of AddWavetable(). Its id is not reused and can no longer be
+	played. Built-in tables can't be deleted.
+	'''
+	PySimpleInstruments.DelWavetable(table_id)
+
+def GenerateWavetable(table_id, freq, fduration, sampleRate):
+	'''
+	Plays a wavetable at constant amplitude, without envelope.
+	fduration -- duration in ms
+	Returns a mono wav buffer.
+	'''
+	return PySimpleInstruments.GenerateWavetable(table_id, freq, fduration, sampleRate)
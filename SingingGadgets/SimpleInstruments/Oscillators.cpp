@@ -0,0 +1,225 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "Oscillators.h"
+#include "Wavetable.h"
+
+#define PI 3.14159265359f
+
+struct PhaseAccumulator
+{
+	uint32_t phase;
+	uint32_t step;
+
+	PhaseAccumulator(float sampleFreq) : phase(0)
+	{
+		double s = (double)sampleFreq - floor((double)sampleFreq);
+		step = (uint32_t)(uint64_t)llround(s * 4294967296.0);
+	}
+
+	// phases of the next 'count' samples, in [0, 1)
+	void Next(float* t, unsigned count)
+	{
+		for (unsigned j = 0; j < count; j++)
+			t[j] = (float)(uint32_t)(phase + j*step) * (1.0f / 4294967296.0f);
+		phase += count*step;
+	}
+};
+
+// correction of a step of +2 at phase 0, dt: phase increment per sample
+static inline float PolyBLEP(float t, float dt)
+{
+	if (t < dt)
+	{
+		float x = t / dt;
+		return -(1.0f - x)*(1.0f - x);
+	}
+	if (t > 1.0f - dt)
+	{
+		float x = (1.0f - t) / dt;
+		return (1.0f - x)*(1.0f - x);
+	}
+	return 0.0f;
+}
+
+// correction of a change of slope of +1 per sample at phase 0
+static inline float PolyBLAMP(float t, float dt)
+{
+	float x;
+	if (t < dt) x = 1.0f - t / dt;
+	else if (t > 1.0f - dt) x = 1.0f - (1.0f - t) / dt;
+	else return 0.0f;
+	return x*x*x*(1.0f / 6.0f);
+}
+
+static inline float Wrap(float t)
+{
+	return t >= 1.0f ? t - 1.0f : t;
+}
+
+static void s_Square(float sampleFreq, float* out, unsigned len)
+{
+	PhaseAccumulator acc(sampleFreq);
+	float t[OscBlockSize];
+	for (unsigned start = 0; start < len; start += OscBlockSize)
+	{
+		unsigned count = len - start;
+		if (count > OscBlockSize) count = OscBlockSize;
+		acc.Next(t, count);
+		for (unsigned j = 0; j < count; j++)
+		{
+			float wave = t[j] > 0.5f ? -1.0f : 1.0f;
+			wave += PolyBLEP(t[j], sampleFreq) - PolyBLEP(Wrap(t[j] + 0.5f), sampleFreq);
+			out[start + j] = wave;
+		}
+	}
+}
+
+// envelope 1 - 2|j/(len-1) - 0.5|
+static void s_Triangle(float sampleFreq, float* out, unsigned len)
+{
+	PhaseAccumulator acc(sampleFreq);
+	float t[OscBlockSize];
+	float slope = 8.0f*sampleFreq;
+	double amplitude = 0.0;
+	double dAmp = len > 1 ? 2.0 / (double)(len - 1) : 0.0;
+	for (unsigned start = 0; start < len; start += OscBlockSize)
+	{
+		unsigned count = len - start;
+		if (count > OscBlockSize) count = OscBlockSize;
+		acc.Next(t, count);
+		for (unsigned j = 0; j < count; j++)
+		{
+			float x = t[j];
+			float wave = x > 0.5f ? (x - 0.75f)*4.0f : (0.25f - x)*4.0f;
+			wave += slope*(PolyBLAMP(Wrap(x + 0.5f), sampleFreq) - PolyBLAMP(x, sampleFreq));
+			out[start + j] = wave;
+		}
+		for (unsigned j = 0; j < count; j++)
+		{
+			unsigned i = start + j;
+			out[i] *= (float)(amplitude < 1.0 ? amplitude : 2.0 - amplitude);
+			amplitude += dAmp;
+		}
+	}
+}
+
+// envelope 1 - j/(len-1)
+static void s_Sawtooth(float sampleFreq, float* out, unsigned len)
+{
+	PhaseAccumulator acc(sampleFreq);
+	float t[OscBlockSize];
+	double amplitude = 1.0;
+	double dAmp = len > 1 ? 1.0 / (double)(len - 1) : 0.0;
+	for (unsigned start = 0; start < len; start += OscBlockSize)
+	{
+		unsigned count = len - start;
+		if (count > OscBlockSize) count = OscBlockSize;
+		acc.Next(t, count);
+		for (unsigned j = 0; j < count; j++)
+		{
+			float wave = 1.0f - 2.0f*t[j] + PolyBLEP(t[j], sampleFreq);
+			out[start + j] = wave;
+		}
+		for (unsigned j = 0; j < count; j++)
+		{
+			out[start + j] *= (float)amplitude;
+			amplitude -= dAmp;
+		}
+	}
+}
+
+// wave by a resonator, envelope sin(PI*j/len) by another one
+static void s_PureSin(float sampleFreq, float* out, unsigned len)
+{
+	float wave = 1.0f;
+	float Dwave = 0.0f;
+	float a = powf(2.0f * PI*sampleFreq, 2.0f);
+
+	double c = 2.0*cos(3.14159265358979 / (double)len);
+	double e0 = -sin(3.14159265358979 / (double)len);
+	double e1 = 0.0;
+
+	for (unsigned j = 0; j < len; j++)
+	{
+		out[j] = (float)e1*wave;
+
+		float DDwave = -a*wave;
+		Dwave += DDwave;
+		wave += Dwave;
+
+		double e2 = c*e1 - e0;
+		e0 = e1;
+		e1 = e2;
+	}
+}
+
+/*
+Waveform read from the NaivePiano wavetable. Envelope 1 - 8(x2 - 0.5)^3, 
+x2 = j/numOfSamples, a cubic, stepped by forward differences.
+*/
+static void s_NaivePiano(float sampleFreq, float numOfSamples, float* out, unsigned len)
+{
+	uint32_t phase = 0;
+	GetWavetable(WtNaivePiano)->Render(sampleFreq, out, len, phase);
+
+	double h = 1.0 / (double)numOfSamples;
+	// p(x2) = 1 + 8(0.5 - x2)^3 = 2 - 6x2 + 12x2^2 - 8x2^3, and its differences at 0
+	double e = 2.0;
+	double d1 = -6.0*h + 12.0*h*h - 8.0*h*h*h;
+	double d2 = 24.0*h*h - 48.0*h*h*h;
+	double d3 = -48.0*h*h*h;
+	for (unsigned j = 0; j < len; j++)
+	{
+		out[j] *= (float)e;
+		e += d1; d1 += d2; d2 += d3;
+	}
+}
+
+static inline float rand01()
+{
+	float f = (float)rand() / (float)RAND_MAX;
+	if (f < 0.0000001f) f = 0.0000001f;
+	if (f > 0.9999999f) f = 0.9999999f;
+	return f;
+}
+
+static void s_BottleBlow(float sampleFreq, float numOfSamples, float* out, unsigned len)
+{
+	float outv = 0.0f;
+	float Dout = 0.0f;
+
+	float k = 0.02f;
+	float FreqCut = k*sampleFreq;
+	float a = powf(2 * PI, 2.0f)*sqrtf(powf(FreqCut, 4.0f) + powf(sampleFreq, 4.0f));
+	float b = 2 * PI * FreqCut*FreqCut / sampleFreq;
+
+	float ampfac = powf(FreqCut, 1.5f);
+
+	for (unsigned j = 0; j < len; j++)
+	{
+		float x2 = (float)j / numOfSamples;
+		float amplitude = 1.0f - powf(x2 - 0.5f, 3.0f)*8.0f;
+
+		out[j] = amplitude*outv*ampfac;
+
+		float e = rand01() - 0.5f;
+		float DDout = e - b*Dout - a*outv;
+		Dout += DDout;
+		outv += Dout;
+	}
+}
+
+void RenderOscillator(OscillatorType type, float sampleFreq, float numOfSamples, float* outBuf, unsigned outBufLen)
+{
+	switch (type)
+	{
+	case OscPureSin: s_PureSin(sampleFreq, outBuf, outBufLen); break;
+	case OscSquare: s_Square(sampleFreq, outBuf, outBufLen); break;
+	case OscTriangle: s_Triangle(sampleFreq, outBuf, outBufLen); break;
+	case OscSawtooth: s_Sawtooth(sampleFreq, outBuf, outBufLen); break;
+	case OscNaivePiano: s_NaivePiano(sampleFreq, numOfSamples, outBuf, outBufLen); break;
+	case OscBottleBlow: s_BottleBlow(sampleFreq, numOfSamples, outBuf, outBufLen); break;
+	default: break;
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef _Oscillators_h
+#define _Oscillators_h
+
+enum OscillatorType
+{
+	OscPureSin,
+	OscSquare,
+	OscTriangle,
+	OscSawtooth,
+	OscNaivePiano,
+	OscBottleBlow,
+	OscCount
+};
+
+/*
+Renders one note of a simple instrument, waveform and envelope, into outBuf.
+sampleFreq: frequency / sample rate
+numOfSamples: exact length of the note in samples, outBufLen = ceil(numOfSamples)
+
+The phase is a 32-bit accumulator. Square and sawtooth are band-limited by 
+PolyBLEP, the triangle by PolyBLAMP, NaivePiano plays its wavetable.
+Envelopes are evaluated by recurrences, per block of OscBlockSize samples.
+*/
+enum { OscBlockSize = 16 };
+
+void RenderOscillator(OscillatorType type, float sampleFreq, float numOfSamples, float* outBuf, unsigned outBufLen);
+
+#endif
@@ -1,9 +1,11 @@
 #include <Python.h>
 #include <WavBuf.h>
+#include <vector>
+#include <algorithm>
+#include "Oscillators.h"
+#include "Wavetable.h"
 
-#define PI 3.14159265359f
-
-PyObject* GeneratePureSin(PyObject *self, PyObject *args)
+static PyObject* s_Generate(OscillatorType type, PyObject *args)
 {
 	float freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 0));
 	float fduration = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
@@ -21,101 +23,145 @@ PyObject* GeneratePureSin(PyObject *self, PyObject *args)
 	float* ptr;
 	res.GetDataPtrAndLen(ptr, len);
 
-	ssize_t j;
-
-	float wave = 1.0f;
-	float Dwave = 0.0f;
-	float a = powf(2.0f * PI*sampleFreq, 2.0f);
-
-	for (j = 0; j<len; j++)
-	{
-		float amplitude = sinf(PI*(float)j / (float)len);
-
-		ptr[j] = amplitude*wave;
-
-		float DDwave = -a*wave;
-		Dwave += DDwave;
-		wave += Dwave;
-	}
+	RenderOscillator(type, sampleFreq, fNumOfSamples, ptr, (unsigned)len);
 
 	return res.pyWavBuf;
 }
 
-PyObject* GenerateSquare(PyObject *self, PyObject *args)
+PyObject* GeneratePureSin(PyObject *self, PyObject *args)
 {
-	float freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 0));
-	float fduration = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
-	float sampleRate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 2));
+	return s_Generate(OscPureSin, args);
+}
 
-	float fNumOfSamples = fduration*sampleRate*0.001f;
-	ssize_t len = (ssize_t)ceilf(fNumOfSamples);
-	float sampleFreq = freq / sampleRate;
+PyObject* GenerateSquare(PyObject *self, PyObject *args)
+{
+	return s_Generate(OscSquare, args);
+}
 
-	PyWavBuf res;
-	res.SetSampleRate(sampleRate);
-	res.SetNumChannels(1);
-	res.Allocate(len);
+PyObject* GenerateTriangle(PyObject *self, PyObject *args)
+{
+	return s_Generate(OscTriangle, args);
+}
 
-	float* ptr;
-	res.GetDataPtrAndLen(ptr, len);
+PyObject* GenerateSawtooth(PyObject *self, PyObject *args)
+{
+	return s_Generate(OscSawtooth, args);
+}
 
-	ssize_t j;
+PyObject* GenerateNaivePiano(PyObject *self, PyObject *args)
+{
+	return s_Generate(OscNaivePiano, args);
+}
 
-	for (j = 0; j<len; j++)
-	{
-		float x = sampleFreq*j;
-		x = x - floor(x);
-		float wave = x > 0.5f ? -1.0f : 1.0f;
-		ptr[j] = wave;
-	}
+PyObject* GenerateBottleBlow(PyObject *self, PyObject *args)
+{
+	return s_Generate(OscBottleBlow, args);
+}
 
-	return res.pyWavBuf;
+static double getSeqFloat(PyObject* seq, ssize_t i)
+{
+	PyObject* item = PySequence_GetItem(seq, i);
+	double v = PyFloat_AsDouble(item);
+	Py_XDECREF(item);
+	return v;
 }
 
-PyObject* GenerateTriangle(PyObject *self, PyObject *args)
+// (type, [(onset, freq, duration)...], sampleRate), onset and duration in ms
+// all notes mixed into one mono buffer starting at onset 0
+PyObject* GenerateNotes(PyObject *self, PyObject *args)
 {
-	float freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 0));
-	float fduration = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
+	unsigned type = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	PyObject* o_notes = PyTuple_GetItem(args, 1);
 	float sampleRate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 2));
+	if (type >= OscCount)
+	{
+		PyErr_SetString(PyExc_ValueError, "unknown oscillator type");
+		return NULL;
+	}
 
-	float fNumOfSamples = fduration*sampleRate*0.001f;
-	ssize_t len = (ssize_t)ceilf(fNumOfSamples);
-	float sampleFreq = freq / sampleRate;
+	struct Note
+	{
+		unsigned onset;
+		float sampleFreq;
+		float numOfSamples;
+		unsigned len;
+	};
+
+	ssize_t numNotes = PySequence_Size(o_notes);
+	std::vector<Note> notes((size_t)(numNotes > 0 ? numNotes : 0));
+	size_t total = 0;
+	unsigned maxLen = 0;
+	for (ssize_t i = 0; i < numNotes; i++)
+	{
+		PyObject* o_note = PySequence_GetItem(o_notes, i);
+		double onset = getSeqFloat(o_note, 0);
+		double freq = getSeqFloat(o_note, 1);
+		double duration = getSeqFloat(o_note, 2);
+		Py_XDECREF(o_note);
+		if (PyErr_Occurred()) return NULL;
+		// also rejects NaNs, offsets are unsigned sample positions
+		if (!(onset >= 0.0) || !(duration >= 0.0))
+		{
+			PyErr_SetString(PyExc_ValueError, "note onsets and durations must not be negative");
+			return NULL;
+		}
+		if ((onset + duration) * sampleRate * 0.001 >= 4294967295.0)
+		{
+			PyErr_SetString(PyExc_ValueError, "note ends beyond the sample range");
+			return NULL;
+		}
+
+		Note& note = notes[i];
+		// placed as RenderNotesPreset places notes, lengths as the single note generators
+		note.onset = (unsigned)(onset * sampleRate * 0.001 + 0.5);
+		note.sampleFreq = (float)freq / sampleRate;
+		note.numOfSamples = (float)duration*sampleRate*0.001f;
+		note.len = (unsigned)ceilf(note.numOfSamples);
+		total = std::max(total, (size_t)note.onset + note.len);
+		maxLen = std::max(maxLen, note.len);
+	}
+	if (PyErr_Occurred()) return NULL;
 
 	PyWavBuf res;
 	res.SetSampleRate(sampleRate);
 	res.SetNumChannels(1);
-	res.Allocate(len);
+	res.Allocate((ssize_t)total);
 
 	float* ptr;
+	ssize_t len;
 	res.GetDataPtrAndLen(ptr, len);
+	memset(ptr, 0, sizeof(float)*total);
 
-	ssize_t j;
-
-	for (j = 0; j<len; j++)
+	std::vector<float> scratch(maxLen);
+	for (size_t i = 0; i < notes.size(); i++)
 	{
-		float amplitude = 1.0f - 2.0f*fabsf((float)j / (float)(len - 1) - 0.5f);
-
-		float x = sampleFreq*j;
-		x = x - floor(x);
-
-		float wave = x > 0.5f ? (x - 0.75f)*4.0f : (0.25f - x)*4.0f;
-		ptr[j] = wave*amplitude;
+		const Note& note = notes[i];
+		RenderOscillator((OscillatorType)type, note.sampleFreq, note.numOfSamples, scratch.data(), note.len);
+		float* dst = ptr + note.onset;
+		for (unsigned j = 0; j < note.len; j++)
+			dst[j] += scratch[j];
 	}
 
 	return res.pyWavBuf;
 }
 
-
-PyObject* GenerateSawtooth(PyObject *self, PyObject *args)
+// (table_id, freq, duration, sampleRate), duration in ms, no envelope
+PyObject* GenerateWavetable(PyObject *self, PyObject *args)
 {
-	float freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 0));
-	float fduration = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
-	float sampleRate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 2));
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	float freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
+	float fduration = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 2));
+	float sampleRate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 3));
+	if (PyErr_Occurred()) return NULL;
+
+	const Wavetable* table = GetWavetable(id);
+	if (table == nullptr)
+	{
+		PyErr_SetString(PyExc_ValueError, "unknown wavetable");
+		return NULL;
+	}
 
-	float fNumOfSamples = fduration*sampleRate*0.001f;
-	ssize_t len = (ssize_t)ceilf(fNumOfSamples);
-	float sampleFreq = freq / sampleRate;
+	ssize_t len = (ssize_t)ceilf(fduration*sampleRate*0.001f);
 
 	PyWavBuf res;
 	res.SetSampleRate(sampleRate);
@@ -125,112 +171,43 @@ PyObject* GenerateSawtooth(PyObject *self, PyObject *args)
 	float* ptr;
 	res.GetDataPtrAndLen(ptr, len);
 
-	ssize_t j;
-
-	for (j = 0; j<len; j++)
-	{
-		float amplitude = 1.0f - ((float)j / (float)(len - 1));
-		float phase = sampleFreq*j;
-		float wave = 1.0f - 2.0f*(phase - floor(phase));
-		ptr[j] = amplitude*wave;
-	}
+	uint32_t phase = 0;
+	table->Render(freq / sampleRate, ptr, (unsigned)len, phase);
 
 	return res.pyWavBuf;
 }
 
-
-PyObject* GenerateNaivePiano(PyObject *self, PyObject *args)
+// ([samples of one period]) -> table_id
+PyObject* AddWavetable(PyObject *self, PyObject *args)
 {
-	float freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 0));
-	float fduration = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
-	float sampleRate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 2));
-
-	float fNumOfSamples = fduration*sampleRate*0.001f;
-	ssize_t len = (ssize_t)ceilf(fNumOfSamples);
-	float sampleFreq = freq / sampleRate;
-
-	PyWavBuf res;
-	res.SetSampleRate(sampleRate);
-	res.SetNumChannels(1);
-	res.Allocate(len);
-
-	float* ptr;
-	res.GetDataPtrAndLen(ptr, len);
-
-	ssize_t j;
-
-	for (j = 0; j<len; j++)
+	PyObject* o_cycle = PyTuple_GetItem(args, 0);
+	ssize_t count = PySequence_Size(o_cycle);
+	if (count < 3)
 	{
-		float x = sampleFreq*j;
-		x = x - floor(x);
-
-		float x2 = (float)j / fNumOfSamples;
-
-		float amplitude = 1.0f - powf(x2 - 0.5f, 3.0f)*8.0f;
-		float wave = (1.0f + 0.5f*cos(2 * PI*x * 5))*sin(PI*x)* powf(1.0f - 2.0f * x, 3.0f);
-
-		ptr[j] = amplitude*wave;
+		if (!PyErr_Occurred())
+			PyErr_SetString(PyExc_ValueError, "a wavetable cycle needs at least 3 samples");
+		return NULL;
 	}
 
-	return res.pyWavBuf;
-}
+	std::vector<float> cycle((size_t)count);
+	for (ssize_t i = 0; i < count; i++)
+		cycle[i] = getSeqFloat(o_cycle, i);
+	if (PyErr_Occurred()) return NULL;
 
-inline float rand01()
-{
-	float f = (float)rand() / (float)RAND_MAX;
-	if (f < 0.0000001f) f = 0.0000001f;
-	if (f > 0.9999999f) f = 0.9999999f;
-	return f;
+	return PyLong_FromUnsignedLong((unsigned long)AddWavetable(cycle.data(), (unsigned)count));
 }
 
-PyObject* GenerateBottleBlow(PyObject *self, PyObject *args)
+// (table_id), tables of AddWavetable() only
+PyObject* DelWavetable(PyObject *self, PyObject *args)
 {
-	float freq = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 0));
-	float fduration = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
-	float sampleRate = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 2));
-
-	float fNumOfSamples = fduration*sampleRate*0.001f;
-	ssize_t len = (ssize_t)ceilf(fNumOfSamples);
-	float sampleFreq = freq / sampleRate;
-
-	PyWavBuf res;
-	res.SetSampleRate(sampleRate);
-	res.SetNumChannels(1);
-	res.Allocate(len);
-
-	float* ptr;
-	res.GetDataPtrAndLen(ptr, len);
-
-	ssize_t j;
-
-	float out = 0.0f;
-	float Dout = 0.0f;
-
-	//float FreqCut = 1.0f / 5000.0f;
-	float k = 0.02f;
-	float FreqCut = k*sampleFreq;
-	float a = powf(2 * PI, 2.0f)*sqrtf(powf(FreqCut, 4.0f) + powf(sampleFreq, 4.0f));
-	//float b = 2 * PI * powf(2.0f*(sqrtf(powf(FreqCut, 4.0f) + powf(sampleFreq, 4.0f)) - powf(sampleFreq, 2.0f)),0.5f);
-	float b = 2 * PI * FreqCut*FreqCut / sampleFreq;
-
-	float ampfac = powf(FreqCut, 1.5f);
-
-	for (j = 0; j < len; j++)
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	if (PyErr_Occurred()) return NULL;
+	if (!DelWavetable(id))
 	{
-		float x2 = (float)j / fNumOfSamples;
-		float amplitude = 1.0f - powf(x2 - 0.5f, 3.0f)*8.0f;
-
-		ptr[j] = amplitude*out*ampfac;
-
-		//float e = randGauss();
-		float e = rand01() - 0.5f;
-		float DDout = e - b*Dout - a*out;
-		Dout += DDout;
-		out += Dout;
-
+		PyErr_SetString(PyExc_ValueError, "not a wavetable of AddWavetable()");
+		return NULL;
 	}
-
-	return res.pyWavBuf;
+	return PyLong_FromLong(0);
 }
 
 static PyMethodDef s_Methods[] = {
@@ -270,6 +247,30 @@ static PyMethodDef s_Methods[] = {
 		METH_VARARGS,
 		""
 	},
+	{
+		"GenerateNotes",
+		GenerateNotes,
+		METH_VARARGS,
+		""
+	},
+	{
+		"GenerateWavetable",
+		GenerateWavetable,
+		METH_VARARGS,
+		""
+	},
+	{
+		"AddWavetable",
+		AddWavetable,
+		METH_VARARGS,
+		""
+	},
+	{
+		"DelWavetable",
+		DelWavetable,
+		METH_VARARGS,
+		""
+	},
 	{ NULL, NULL, 0, NULL }
 };
 
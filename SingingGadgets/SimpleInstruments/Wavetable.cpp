@@ -0,0 +1,202 @@
+#include <math.h>
+#include "Wavetable.h"
+
+#define PI 3.14159265358979
+
+Wavetable::Wavetable(const float* cycle, unsigned count)
+{
+	unsigned numHarmonics = count > 2 ? (count - 1) / 2 : 0;
+	if (numHarmonics > WtMaxHarmonics) numHarmonics = WtMaxHarmonics;
+
+	std::vector<double> cosTable(count);
+	for (unsigned n = 0; n < count; n++)
+		cosTable[n] = cos(2.0 * PI * (double)n / (double)count);
+
+	// direct DFT of the bins kept, cycles are short and analyzed only once
+	std::vector<double> cosAmps(numHarmonics + 1);
+	std::vector<double> sinAmps(numHarmonics + 1);
+	double sum = 0.0;
+	for (unsigned n = 0; n < count; n++)
+		sum += (double)cycle[n];
+	cosAmps[0] = sum / (double)count;
+	sinAmps[0] = 0.0;
+
+	unsigned quarter = count / 4;
+	bool exactQuarter = count % 4 == 0;
+	for (unsigned k = 1; k <= numHarmonics; k++)
+	{
+		double c = 0.0, s = 0.0;
+		unsigned idx = 0;
+		for (unsigned n = 0; n < count; n++)
+		{
+			double x = (double)cycle[n];
+			c += x*cosTable[idx];
+			// sin(a) = cos(a - PI/2)
+			if (exactQuarter)
+				s += x*cosTable[idx >= quarter ? idx - quarter : idx + count - quarter];
+			else
+				s += x*sin(2.0 * PI * (double)idx / (double)count);
+			idx += k;
+			if (idx >= count) idx -= count;
+		}
+		cosAmps[k] = c * 2.0 / (double)count;
+		sinAmps[k] = s * 2.0 / (double)count;
+	}
+
+	_build(cosAmps.data(), sinAmps.data(), numHarmonics);
+}
+
+Wavetable::Wavetable(const double* cosAmps, const double* sinAmps, unsigned numHarmonics)
+{
+	if (numHarmonics > WtMaxHarmonics) numHarmonics = WtMaxHarmonics;
+	_build(cosAmps, sinAmps, numHarmonics);
+}
+
+void Wavetable::_build(const double* cosAmps, const double* sinAmps, unsigned numHarmonics)
+{
+	std::vector<double> cosTable(WtCycleSize);
+	for (unsigned n = 0; n < WtCycleSize; n++)
+		cosTable[n] = cos(2.0 * PI * (double)n / (double)WtCycleSize);
+
+	// levels from the poorest up, each one adds its octave of harmonics to the previous one
+	std::vector<double> acc(WtCycleSize, cosAmps[0]);
+	unsigned done = 0;
+	for (int level = WtNumLevels - 1; level >= 0; level--)
+	{
+		unsigned limit = (unsigned)WtMaxHarmonics >> level;
+		if (limit > numHarmonics) limit = numHarmonics;
+		for (unsigned k = done + 1; k <= limit; k++)
+		{
+			double c = cosAmps[k];
+			double s = sinAmps[k];
+			unsigned idx = 0;
+			for (unsigned n = 0; n < WtCycleSize; n++)
+			{
+				// sin(a) = cos(a - PI/2)
+				unsigned sidx = (idx + WtCycleSize - WtCycleSize / 4) & (WtCycleSize - 1);
+				acc[n] += c*cosTable[idx] + s*cosTable[sidx];
+				idx = (idx + k) & (WtCycleSize - 1);
+			}
+		}
+		if (limit > done) done = limit;
+
+		std::vector<float>& table = m_levels[level];
+		table.resize(WtCycleSize + 1);
+		for (unsigned n = 0; n < WtCycleSize; n++)
+			table[n] = (float)acc[n];
+		table[WtCycleSize] = table[0];
+	}
+}
+
+void Wavetable::Render(float sampleFreq, float* outBuf, unsigned len, uint32_t& phase) const
+{
+	int level = 0;
+	while (level < WtNumLevels && (double)((unsigned)WtMaxHarmonics >> level) * (double)sampleFreq >= 0.5)
+		level++;
+	if (level >= WtNumLevels || sampleFreq <= 0.0f)
+	{
+		for (unsigned j = 0; j < len; j++)
+			outBuf[j] = 0.0f;
+		return;
+	}
+
+	const float* table = m_levels[level].data();
+	uint32_t step = (uint32_t)(uint64_t)llround((double)sampleFreq * 4294967296.0);
+	const unsigned shift = 32 - WtCycleLog2;
+	const uint32_t fracMask = ((uint32_t)1 << shift) - 1;
+	const float fracScale = 1.0f / (float)((uint32_t)1 << shift);
+
+	uint32_t p = phase;
+	for (unsigned j = 0; j < len; j++)
+	{
+		uint32_t i = p >> shift;
+		float frac = (float)(p & fracMask) * fracScale;
+		float a = table[i];
+		outBuf[j] = a + (table[i + 1] - a)*frac;
+		p += step;
+	}
+	phase = p;
+}
+
+static void s_FourierSeries(std::vector<double>& cosAmps, std::vector<double>& sinAmps, unsigned id)
+{
+	cosAmps.assign(WtMaxHarmonics + 1, 0.0);
+	sinAmps.assign(WtMaxHarmonics + 1, 0.0);
+	for (unsigned k = 1; k <= WtMaxHarmonics; k++)
+	{
+		switch (id)
+		{
+		case WtSine:
+			if (k == 1) sinAmps[k] = 1.0;
+			break;
+		// +1 on the first half, -1 on the second
+		case WtSquare:
+			if (k % 2 == 1) sinAmps[k] = 4.0 / (PI*(double)k);
+			break;
+		// 1 at phase 0, -1 at phase 0.5
+		case WtTriangle:
+			if (k % 2 == 1) cosAmps[k] = 8.0 / (PI*PI*(double)k*(double)k);
+			break;
+		// 1 - 2*phase
+		case WtSawtooth:
+			sinAmps[k] = 2.0 / (PI*(double)k);
+			break;
+		}
+	}
+}
+
+static Wavetable* s_BuildBuiltin(unsigned id)
+{
+	if (id == WtNaivePiano)
+	{
+		// (1 + 0.5cos(10*PI*x))*sin(PI*x)*(1 - 2x)^3, smooth, sampled finely enough to be analyzed directly
+		const unsigned count = WtCycleSize * 8;
+		std::vector<float> cycle(count);
+		for (unsigned n = 0; n < count; n++)
+		{
+			double x = (double)n / (double)count;
+			double y = 1.0 - 2.0*x;
+			cycle[n] = (float)((1.0 + 0.5*cos(10.0*PI*x))*sin(PI*x)*y*y*y);
+		}
+		return new Wavetable(cycle.data(), count);
+	}
+
+	std::vector<double> cosAmps, sinAmps;
+	s_FourierSeries(cosAmps, sinAmps, id);
+	return new Wavetable(cosAmps.data(), sinAmps.data(), WtMaxHarmonics);
+}
+
+// never destroyed, built-in tables are shared by every note for the life of the module,
+// user tables until DelWavetable()
+static std::vector<Wavetable*>* s_Wavetables = new std::vector<Wavetable*>(WtBuiltinCount, (Wavetable*)nullptr);
+
+const Wavetable* GetWavetable(unsigned id)
+{
+	if (id >= s_Wavetables->size()) return nullptr;
+	Wavetable*& table = (*s_Wavetables)[id];
+	if (table == nullptr && id < WtBuiltinCount)
+		table = s_BuildBuiltin(id);
+	return table;
+}
+
+unsigned AddWavetable(const float* cycle, unsigned count)
+{
+	unsigned id = (unsigned)s_Wavetables->size();
+	s_Wavetables->push_back(new Wavetable(cycle, count));
+	return id;
+}
+
+bool DelWavetable(unsigned id)
+{
+	if (id < WtBuiltinCount || id >= s_Wavetables->size()) return false;
+	Wavetable*& table = (*s_Wavetables)[id];
+	if (table == nullptr) return false;
+	delete table;
+	table = nullptr;
+	return true;
+}
+
+unsigned NumWavetables()
+{
+	return (unsigned)s_Wavetables->size();
+}
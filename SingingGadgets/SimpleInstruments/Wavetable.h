@@ -0,0 +1,60 @@
+#ifndef _Wavetable_h
+#define _Wavetable_h
+
+#include <stdint.h>
+#include <vector>
+
+enum WavetableId
+{
+	WtSine,
+	WtNaivePiano,
+	WtSquare,
+	WtTriangle,
+	WtSawtooth,
+	WtBuiltinCount
+};
+
+enum
+{
+	WtCycleLog2 = 11,
+	WtCycleSize = 1 << WtCycleLog2,
+	WtMaxHarmonics = WtCycleSize / 4,
+	WtNumLevels = 10
+};
+
+/*
+Single-cycle wavetable, mip-mapped by octave. Level k holds the DC and the
+harmonics 1..(WtMaxHarmonics>>k) of the cycle in WtCycleSize samples, so every
+level is oversampled at least twice and is read by linear interpolation.
+A note is played from the richest level whose highest harmonic stays below
+Nyquist.
+*/
+class Wavetable
+{
+public:
+	// one period of 'count' samples, harmonics above count/2 are lost
+	Wavetable(const float* cycle, unsigned count);
+	// cosine and sine amplitudes, index 0 is the DC (sinAmps[0] unused)
+	Wavetable(const double* cosAmps, const double* sinAmps, unsigned numHarmonics);
+
+	/*
+	Writes len samples at sampleFreq (frequency / sample rate), starting from
+	phase, a 32-bit accumulator which is advanced. Silence at or above Nyquist.
+	*/
+	void Render(float sampleFreq, float* outBuf, unsigned len, uint32_t& phase) const;
+
+private:
+	void _build(const double* cosAmps, const double* sinAmps, unsigned numHarmonics);
+
+	std::vector<float> m_levels[WtNumLevels]; // WtCycleSize + 1 samples, the last one wraps
+};
+
+// built-in tables are built at first use, nullptr for an unknown or deleted id
+const Wavetable* GetWavetable(unsigned id);
+// returns the id of the new table
+unsigned AddWavetable(const float* cycle, unsigned count);
+// frees a table of AddWavetable(), its id is not reused; false for a built-in, unknown or deleted id
+bool DelWavetable(unsigned id);
+unsigned NumWavetables();
+
+#endif
@@ -133,17 +133,23 @@ def MixTrackBufferList (targetbuf, bufferList):
 	'''
 	PyTrackBuffer.MixTrackBufferList(targetbuf.id, ObjectToId(bufferList))
 
-def WriteTrackBufferToWav(buf, filename):
+WavSampleFormats = { 's16': 0, 's24': 1, 'f32': 2 }
+
+def WriteTrackBufferToWav(buf, filename, sampleFormat='s16', dither=False):
 	'''
 	Function used to write a track-buffer to a .wav file.
 	buf -- an instance of TrackBuffer
 	filename -- a string
+	sampleFormat -- 's16', 's24' (PCM) or 'f32' (float, not clipped)
+	dither -- add TPDF dither before quantizing to 16 or 24 bits
+	Raises OSError when the file can't be opened, written or closed.
 	'''
-	PyTrackBuffer.WriteTrackBufferToWav(buf.id, filename)
+	PyTrackBuffer.WriteTrackBufferToWav(buf.id, filename, WavSampleFormats[sampleFormat], dither)
 
 def ReadTrackBufferFromWav(buf, filename):
 	'''
-	Function used to read a track-buffer from a .wav file.
+	Function used to read a track-buffer from a .wav file, 8/16/24/32 bit PCM
+	or float, mono or stereo.
 	buf -- an instance of TrackBuffer
 	filename -- a string
 	'''
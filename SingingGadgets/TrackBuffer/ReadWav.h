@@ -1,7 +1,14 @@
 #ifndef _ReadWav_h
 #define _ReadWav_h
 
-#include <stdio.h>
+#include "MappedFile.h"
+#include "WavFile.h"
+
+/*
+Reads 8/16/24/32 bit PCM or float .wav files, mono or stereo. The file is
+mapped and walked chunk by chunk (LIST, fact... are skipped), samples are
+decoded block by block straight from the mapping.
+*/
 class ReadWav
 {
 public:
@@ -15,7 +22,8 @@ public:
 	bool ReadSamples(float* samples, unsigned count, float& maxv);
 
 private:
-	FILE* m_fp;
+	MappedFile m_file;
+	WavFileInfo m_info;
 	unsigned m_totalSamples;
 	unsigned m_num_channels;
 	unsigned m_readSamples;
@@ -1,4 +1,5 @@
 #include <Python.h>
+#include <errno.h>
 #include "TrackBuffer.h"
 #include "WavBuf.h"
 #include "WriteWav.h"
@@ -12,7 +13,7 @@
 #define min(a,b)            (((a) < (b)) ? (a) : (b))
 #endif
 
-void WriteToWav(TrackBuffer& track, const char* fileName)
+bool WriteToWav(TrackBuffer& track, const char* fileName, WavSampleFormat format, bool dither)
 {
 	unsigned numSamples = track.NumberOfSamples();
 	unsigned chn = track.NumberOfChannels();
@@ -21,8 +22,8 @@ void WriteToWav(TrackBuffer& track, const char* fileName)
 	float pan = track.Pan();
 
 	WriteWav writer;
-	writer.OpenFile(fileName);
-	writer.WriteHeader(sampleRate, numSamples, chn);
+	if (!writer.OpenFile(fileName)) return false;
+	writer.WriteHeader(sampleRate, numSamples, chn, format, dither);
 
 	unsigned localBufferSize = track.GetLocalBufferSize();
 	float *buffer = new float[localBufferSize*chn];
@@ -35,19 +36,27 @@ void WriteToWav(TrackBuffer& track, const char* fileName)
 		numSamples -= writeCount;
 		pos += writeCount;
 	}
-
 	delete[] buffer;
+
+	// already closed after the last sample, unless there was none
+	writer.CloseFile();
+	if (writer.Error() != 0)
+	{
+		// for the caller's PyErr_SetFromErrnoWithFilename()
+		errno = writer.Error();
+		return false;
+	}
+	return true;
 }
 
-void ReadFromWav(TrackBuffer& track, const char* fileName)
+bool ReadFromWav(TrackBuffer& track, const char* fileName)
 {
 	unsigned numSamples;
 	unsigned chn;
 	unsigned sampleRate;
 
 	ReadWav reader;
-	reader.OpenFile(fileName);
-	reader.ReadHeader(sampleRate, numSamples, chn);
+	if (!reader.OpenFile(fileName) || !reader.ReadHeader(sampleRate, numSamples, chn)) return false;
 
 	unsigned localBufferSize = track.GetLocalBufferSize();
 
@@ -59,12 +68,13 @@ void ReadFromWav(TrackBuffer& track, const char* fileName)
 	{
 		unsigned readCount = min(numSamples, localBufferSize);
 		float maxv;
-		reader.ReadSamples(buf.m_data, readCount, maxv);
+		if (!reader.ReadSamples(buf.m_data, readCount, maxv)) return false;
 		buf.m_sampleNum = readCount;
 		track.WriteBlend(buf);
 		track.MoveCursor((float)readCount / (float)track.Rate()*1000.0f);
 		numSamples -= readCount;
 	}
+	return true;
 }
 
 typedef std::vector<TrackBuffer_deferred> TrackBufferMap;
@@ -248,11 +258,19 @@ static PyObject* WriteTrackBufferToWav(PyObject *self, PyObject *args)
 {
 	unsigned BufferId;
 	const char* fn;
-	if (!PyArg_ParseTuple(args, "Is", &BufferId, &fn))
+	unsigned format = WavFormatS16;
+	int dither = 0;
+	if (!PyArg_ParseTuple(args, "Is|Ip", &BufferId, &fn, &format, &dither))
 		return NULL;
+	if (format > WavFormatF32)
+	{
+		PyErr_SetString(PyExc_ValueError, "unknown sample format");
+		return NULL;
+	}
 
 	TrackBuffer_deferred buffer = s_TrackBufferMap[BufferId];
-	WriteToWav(*buffer, fn);
+	if (!WriteToWav(*buffer, fn, (WavSampleFormat)format, dither != 0))
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError, fn);
 
 	return PyLong_FromUnsignedLong(0);
 }
@@ -264,7 +282,11 @@ static PyObject* ReadTrackBufferFromWav(PyObject *self, PyObject *args)
 	if (!PyArg_ParseTuple(args, "Is", &BufferId, &fn))
 		return NULL;
 	TrackBuffer_deferred buffer = s_TrackBufferMap[BufferId];
-	ReadFromWav(*buffer, fn);
+	if (!ReadFromWav(*buffer, fn))
+	{
+		PyErr_Format(PyExc_OSError, "cannot read %s as a mono or stereo .wav file", fn);
+		return NULL;
+	}
 
 	return PyLong_FromUnsignedLong(0);
 }
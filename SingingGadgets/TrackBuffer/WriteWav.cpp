@@ -1,26 +1,44 @@
+#include <string.h>
+#include <errno.h>
 #include "WriteWav.h"
+#include "WavFile.h"
 
-#ifndef max
-#define max(a,b)            (((a) > (b)) ? (a) : (b))
-#endif
+static unsigned s_BytesPerSample(WavSampleFormat format)
+{
+	return format == WavFormatS16 ? 2 : format == WavFormatS24 ? 3 : 4;
+}
+
+static void s_PutU16(unsigned char*& p, unsigned v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p += 2;
+}
 
-#ifndef min
-#define min(a,b)            (((a) < (b)) ? (a) : (b))
-#endif
+static void s_PutU32(unsigned char*& p, uint32_t v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+	p += 4;
+}
 
-struct WavHeader
+static void s_PutTag(unsigned char*& p, const char* tag)
 {
-	unsigned short wFormatTag;
-	unsigned short wChannels;
-	unsigned int dwSamplesPerSec;
-	unsigned int dwAvgBytesPerSec;
-	unsigned short wBlockAlign;
-	unsigned short wBitsPerSample;
-};
+	memcpy(p, tag, 4);
+	p += 4;
+}
 
 WriteWav::WriteWav()
 {
 	m_fp = nullptr;
+	m_error = 0;
+	m_totalSamples = 0;
+	m_num_channels = 0;
+	m_writenSamples = 0;
+	m_format = WavFormatS16;
+	m_dither = false;
 }
 
 WriteWav::~WriteWav()
@@ -32,95 +50,118 @@ bool WriteWav::OpenFile(const char* filename)
 {
 	if (m_fp) fclose(m_fp);
 	m_fp = fopen(filename, "wb");
+	m_error = m_fp != nullptr ? 0 : errno;
 	return m_fp != nullptr;
 }
 
 void WriteWav::CloseFile()
 {
-	if (m_fp) fclose(m_fp);
+	// buffered data is written by fclose, a full disk may only show here
+	if (m_fp) _check(fclose(m_fp) == 0);
 	m_fp = nullptr;
 }
 
-void WriteWav::WriteHeader(unsigned sampleRate, unsigned numSamples, unsigned chn)
+void WriteWav::_check(bool ok)
 {
-	if (!m_fp) return;
-	unsigned dataSize = numSamples * chn * sizeof(short);
-	unsigned int adWord;
-	WavHeader header;
-
-	fwrite("RIFF", 1, 4, m_fp);
-	adWord = dataSize + 20 + sizeof(WavHeader);
-	fwrite(&adWord, 4, 1, m_fp);
-	fwrite("WAVEfmt ", 1, 8, m_fp);
-	adWord = 0x00000010;
-	fwrite(&adWord, 4, 1, m_fp);
-
-	header.wFormatTag = 1;
-	header.wChannels = chn;
-	header.dwSamplesPerSec = sampleRate;
-	header.dwAvgBytesPerSec = sampleRate *chn* sizeof(short);
-	header.wBlockAlign = chn* sizeof(short);
-	header.wBitsPerSample = 16;
-
-	fwrite(&header, sizeof(WavHeader), 1, m_fp);
-	fwrite("data", 1, 4, m_fp);
-	adWord = dataSize;
-	fwrite(&adWord, 4, 1, m_fp);
-
-	m_totalSamples = numSamples;
-	m_num_channels = chn;
-	m_writenSamples = 0;
+	if (!ok && m_error == 0)
+		m_error = errno != 0 ? errno : EIO;
 }
 
-
-inline void CalcPan(float pan, float& l, float& r)
+void WriteWav::WriteHeader(unsigned sampleRate, unsigned numSamples, unsigned chn, WavSampleFormat format, bool dither)
 {
-	if (pan == 0.0f) return;
-	else if (pan < 0.0f)
-	{
-		pan = -pan;
-		float ll = l;
-		float rl = r*pan;
-		float rr = r*(1.0f - pan);
-		l = ll + rl;
-		r = rr;
-	}
-	else
+	if (!m_fp) return;
+	unsigned bytesPerSample = s_BytesPerSample(format);
+	unsigned dataSize = numSamples * chn * bytesPerSample;
+	bool isFloat = format == WavFormatF32;
+
+	// float data takes the extended fmt chunk and a fact chunk, as non-PCM formats should
+	unsigned fmtSize = isFloat ? 18 : 16;
+	unsigned riffSize = 4 + (8 + fmtSize) + (isFloat ? 12 : 0) + 8 + dataSize + (dataSize & 1);
+
+	unsigned char header[58];
+	unsigned char* p = header;
+	s_PutTag(p, "RIFF");
+	s_PutU32(p, riffSize);
+	s_PutTag(p, "WAVE");
+	s_PutTag(p, "fmt ");
+	s_PutU32(p, fmtSize);
+	s_PutU16(p, isFloat ? WAVE_FORMAT_IEEE_FLOAT_TAG : WAVE_FORMAT_PCM_TAG);
+	s_PutU16(p, chn);
+	s_PutU32(p, sampleRate);
+	s_PutU32(p, sampleRate * chn * bytesPerSample);
+	s_PutU16(p, chn * bytesPerSample);
+	s_PutU16(p, bytesPerSample * 8);
+	if (isFloat)
 	{
-		float ll = l*(1.0f - pan);
-		float lr = l*pan;
-		float rr = r;
-		l = ll;
-		r = lr + rr;
+		s_PutU16(p, 0);
+		s_PutTag(p, "fact");
+		s_PutU32(p, 4);
+		s_PutU32(p, numSamples);
 	}
+	s_PutTag(p, "data");
+	s_PutU32(p, dataSize);
+	_check(fwrite(header, 1, p - header, m_fp) == (size_t)(p - header));
+
+	m_totalSamples = numSamples;
+	m_num_channels = chn;
+	m_writenSamples = 0;
+	m_format = format;
+	m_dither = dither && !isFloat;
+	if (m_dither) DitherInit(m_ditherState, 0);
 }
 
 void WriteWav::WriteSamples(const float* samples, unsigned count, float volume, float pan)
 {
 	if (!m_fp) return;
-	count = min(count, m_totalSamples - m_writenSamples);
+	if (count > m_totalSamples - m_writenSamples)
+		count = m_totalSamples - m_writenSamples;
 	if (count > 0)
 	{
-		short* data = new short[count*m_num_channels];
+		size_t numValues = (size_t)count*m_num_channels;
+		if (m_mixBuf.size() < numValues) m_mixBuf.resize(numValues);
+		float* mixed = m_mixBuf.data();
+		memset(mixed, 0, numValues*sizeof(float));
+		MixFramesF32(mixed, m_num_channels, samples, m_num_channels, count, volume, pan);
 
-		unsigned i;
-		for (i = 0; i < count; i++)
+		if (m_format == WavFormatF32)
 		{
-			float sample[2];
-			for (unsigned c = 0; c < m_num_channels; c++)
-				sample[c] = samples[i*m_num_channels+c];
-			if (m_num_channels == 2)
-				CalcPan(pan, sample[0], sample[1]);
-			for (unsigned c = 0; c < m_num_channels; c++)
-				data[i*m_num_channels + c] = (short)(max(min(sample[c] * volume, 1.0f), -1.0f)*32767.0f);
+			_check(fwrite(mixed, sizeof(float), numValues, m_fp) == numValues);
+		}
+		else
+		{
+			if (m_intBuf.size() < numValues) m_intBuf.resize(numValues);
+			int32_t* q = m_intBuf.data();
+			QuantizeF32(mixed, q, numValues, m_format == WavFormatS16 ? 32767.0f : 8388607.0f, m_dither ? m_ditherState : nullptr);
+
+			unsigned bytesPerSample = s_BytesPerSample(m_format);
+			if (m_outBuf.size() < numValues*bytesPerSample) m_outBuf.resize(numValues*bytesPerSample);
+			unsigned char* out = m_outBuf.data();
+			if (m_format == WavFormatS16)
+			{
+				int16_t* s16 = (int16_t*)out;
+				for (size_t i = 0; i < numValues; i++)
+					s16[i] = (int16_t)q[i];
+			}
+			else
+			{
+				for (size_t i = 0; i < numValues; i++, out += 3)
+				{
+					uint32_t v = (uint32_t)q[i];
+					out[0] = (unsigned char)v;
+					out[1] = (unsigned char)(v >> 8);
+					out[2] = (unsigned char)(v >> 16);
+				}
+			}
+			_check(fwrite(m_outBuf.data(), bytesPerSample, numValues, m_fp) == numValues);
 		}
-
-		fwrite(data, sizeof(short), count*m_num_channels, m_fp);
-
-		delete[] data;
 
 		m_writenSamples += count;
 	}
-	if (m_totalSamples - m_writenSamples<=0) CloseFile();
+	if (m_writenSamples >= m_totalSamples)
+	{
+		// RIFF chunks are word aligned
+		if ((m_totalSamples * m_num_channels * s_BytesPerSample(m_format)) & 1)
+			_check(fputc(0, m_fp) != EOF);
+		CloseFile();
+	}
 }
-
@@ -2,6 +2,24 @@
 #define _WriteWav_h
 
 #include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "WavKernels.h"
+
+enum WavSampleFormat
+{
+	WavFormatS16,
+	WavFormatS24,
+	WavFormatF32
+};
+
+/*
+Writes 16 or 24 bit PCM, optionally with TPDF dither, or 32 bit float .wav
+files. Samples are converted in buffers kept from one WriteSamples() to the
+next and written a block at a time.
+The first failed write or close is kept: Error() is its errno, 0 while every
+write since OpenFile() succeeded.
+*/
 class WriteWav
 {
 public:
@@ -11,14 +29,26 @@ public:
 	bool OpenFile(const char* filename);
 	void CloseFile();
 
-	void WriteHeader(unsigned sampleRate, unsigned numSamples, unsigned chn=1);
+	void WriteHeader(unsigned sampleRate, unsigned numSamples, unsigned chn = 1, WavSampleFormat format = WavFormatS16, bool dither = false);
 	void WriteSamples(const float* samples, unsigned count, float volume=1.0f, float pan=0.0f);
 
+	int Error() const { return m_error; }
+
 private:
+	void _check(bool ok);
+
 	FILE* m_fp;
+	int m_error;
 	unsigned m_totalSamples;
 	unsigned m_num_channels;
 	unsigned m_writenSamples;
+	WavSampleFormat m_format;
+	bool m_dither;
+	uint32_t m_ditherState[WavDitherLanes];
+
+	std::vector<float> m_mixBuf;
+	std::vector<int32_t> m_intBuf;
+	std::vector<unsigned char> m_outBuf;
 };
 
 #endif
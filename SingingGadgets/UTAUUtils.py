@@ -1,9 +1,13 @@
-# from .PyUTAUUtils import *
+from . import PyUTAUUtils
+from . import PyWavUtils
+from . import PyVoiceSampler
 
 import struct
 import os
 import math
 import re
+import wave
+import warnings
 
 def LoadFrq(filename):
 	with open(filename, 'rb') as f:
@@ -24,6 +28,28 @@ def LoadFrq(filename):
 			"data": data
 		}
 
+def LoadWav(filename):
+	'''
+	Loads a wav file as float32 bytes. Decoded buffers are shared through a
+	native LRU cache, see SetWavCacheBudget()
+	'''
+	wavF32=PyUTAUUtils.LoadWavCached(filename)
+	if wavF32==None:
+		# formats the native reader doesn't handle
+		with wave.open(filename, mode='rb') as wavFile:
+			wavS16=wavFile.readframes(wavFile.getnframes())
+		wavF32=PyWavUtils.S16ToF32(wavS16)
+	return wavF32
+
+def SetWavCacheBudget(numBytes):
+	PyUTAUUtils.WavCacheSetBudget(numBytes)
+
+def ClearWavCache():
+	PyUTAUUtils.WavCacheClear()
+
+def WavCacheInfo():
+	return PyUTAUUtils.WavCacheInfo()
+
 def LoadOtoINIPath(otoMap, path, encoding):
 	otoIniPath=path+'/oto.ini'
 	with open(otoIniPath,'r', encoding=encoding) as f:
@@ -144,9 +170,14 @@ def LookUpPrefixMap(prefixMap, freq):
 		return ''
 
 class VoiceBank:
+	'''
+	UTAU voicebank. oto.ini, prefix.map and _wav.frq files are compiled into an index
+	by the native module. The index is saved as indexFile (default: <path>/.vbindex)
+	and memory-mapped by later runs, as long as none of the source files has changed.
+	Set indexFile to None before initialize() to keep the index in memory only.
+	'''
 	def __init__ (self, path):
 		self.path=path
-		self.otoMap={}
 		self.prefixMap={}
 		self.encoding='shift-jis'
 		if os.name == 'nt':
@@ -155,35 +186,55 @@ class VoiceBank:
 			self.fsEncoding = 'gbk'
 		self.wavFileNameTranscode=True
 		self.frqFileNameTranscode=True
+		self.indexFile=os.path.join(path, '.vbindex')
+		self.id=None
 		self.initialized=False
 
-	def buildOtoMap(self,path):
-		for item in os.walk(path):
-			if os.path.isfile(item[0]+'/oto.ini'):
-				LoadOtoINIPath(self.otoMap, item[0], self.encoding)
+	def __del__(self):
+		if self.id!=None:
+			PyUTAUUtils.VoiceBankIndexDel(self.id)
 
 	def initialize(self):
-		self.buildOtoMap(self.path)
-		if os.path.isfile(self.path+'/prefix.map'):
-			self.prefixMap=LoadPrefixMap(self.path+'/prefix.map')
+		if self.id!=None:
+			PyUTAUUtils.VoiceBankIndexDel(self.id)
+		self.id=PyUTAUUtils.VoiceBankIndexLoad(self.path, self.encoding, self.fsEncoding, self.wavFileNameTranscode, self.frqFileNameTranscode, self.indexFile)
+		self.prefixMap=PyUTAUUtils.VoiceBankIndexGetPrefixMap(self.id)
 		self.initialized=True
 
+	def generateMissingFrqs(self, interval=256, threads=0):
+		'''
+		Detects the pitch of every wav that has no _wav.frq file yet and writes the 
+		frq files, using all cores by default. The index is reloaded afterwards.
+		Returns the number of frq files written. A warning is issued for each wav 
+		that cannot be read and each frq file that cannot be written.
+		'''
+		missing=PyUTAUUtils.VoiceBankIndexGetMissingFrqs(self.id)
+		written=0
+		if len(missing)>0:
+			results=PyVoiceSampler.DetectFrqBatch(missing, interval, threads, True, False)
+			for i in range(len(results)):
+				if results[i]==None:
+					warnings.warn("failed to read: "+ missing[i][0])
+				elif results[i]['error']!=None:
+					warnings.warn(results[i]['error'])
+				else:
+					written+=1
+			self.initialize()
+		return written
+
+	def getLyrics(self):
+		return PyUTAUUtils.VoiceBankIndexGetLyrics(self.id)
+
 	def getWavFrq(self,lyric):
-		if not (lyric in self.otoMap):
+		'''
+		Returns (wav, frq), frq['data'] is packed (freq, dyn) float64 pairs
+		'''
+		wavFrq=PyUTAUUtils.VoiceBankIndexGetWavFrq(self.id, lyric)
+		if wavFrq==None:
 			print("missed lyic: "+ lyric)
-			return None
-		wav=self.otoMap[lyric].copy()
-		wavFileName=wav['filename']
-		if self.wavFileNameTranscode:
-			wav['filename']=wavFileName.encode(self.encoding).decode(self.fsEncoding)
-		frqFileName=wavFileName[0:len(wavFileName)-4]+'_wav.frq'
-		if self.frqFileNameTranscode:
-			frqFileName=frqFileName.encode(self.encoding).decode(self.fsEncoding)
-		frq=LoadFrq(frqFileName)
-		return (wav,frq)
+		return wavFrq
 
 	def getWavFrq_PrefixMap(self,lyric, freq):
 		if len(self.prefixMap)>0:
 			lyric+=LookUpPrefixMap(self.prefixMap, freq)
 		return self.getWavFrq(lyric)
-
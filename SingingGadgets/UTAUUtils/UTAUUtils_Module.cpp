@@ -0,0 +1,273 @@
+#include <Python.h>
+#include "VoiceBankIndex.h"
+#include "WavCache.h"
+
+typedef std::vector<VoiceBankIndex_Deferred> VoiceBankIndexMap;
+VoiceBankIndexMap s_VoiceBankIndexMap;
+
+static std::string ToFSString(PyObject* str)
+{
+	std::string ret;
+	PyObject* bytes = PyUnicode_EncodeFSDefault(str);
+	if (bytes != nullptr)
+	{
+		ret = std::string(PyBytes_AsString(bytes), (size_t)PyBytes_Size(bytes));
+		Py_DECREF(bytes);
+	}
+	return ret;
+}
+
+static PyObject* VoiceBankIndexLoad(PyObject *self, PyObject *args)
+{
+	PyObject* o_root = PyTuple_GetItem(args, 0);
+	VoiceBankParams params;
+	params.root = ToFSString(o_root);
+	params.encoding = PyUnicode_AsUTF8(PyTuple_GetItem(args, 1));
+	params.fsEncoding = PyUnicode_AsUTF8(PyTuple_GetItem(args, 2));
+	params.wavFileNameTranscode = PyObject_IsTrue(PyTuple_GetItem(args, 3)) != 0;
+	params.frqFileNameTranscode = PyObject_IsTrue(PyTuple_GetItem(args, 4)) != 0;
+
+	std::string indexFile;
+	PyObject* o_indexFile = PyTuple_GetItem(args, 5);
+	if (o_indexFile != Py_None)
+		indexFile = ToFSString(o_indexFile);
+
+	VoiceBankIndex_Deferred index;
+	if (!index->Load(params, indexFile.c_str()))
+		return NULL;
+
+	unsigned id = (unsigned)s_VoiceBankIndexMap.size();
+	s_VoiceBankIndexMap.push_back(index);
+	return PyLong_FromUnsignedLong((unsigned long)(id));
+}
+
+static PyObject* VoiceBankIndexDel(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	s_VoiceBankIndexMap[id].Abondon();
+	return PyLong_FromLong(0);
+}
+
+static PyObject* VoiceBankIndexFromCache(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	return PyBool_FromLong(s_VoiceBankIndexMap[id]->FromCache() ? 1 : 0);
+}
+
+static PyObject* VoiceBankIndexGetWavFrq(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	VoiceBankIndex* index = s_VoiceBankIndexMap[id];
+
+	ssize_t len;
+	const char* lyric = PyUnicode_AsUTF8AndSize(PyTuple_GetItem(args, 1), &len);
+	if (lyric == nullptr) return NULL;
+
+	const VBIndexEntry* entry = index->FindEntry(lyric, (size_t)len);
+	if (entry == nullptr)
+		Py_RETURN_NONE;
+
+	const VBIndexFrq& frq = index->Frqs()[entry->frqId];
+	if (frq.count < 0)
+	{
+		PyErr_Format(PyExc_FileNotFoundError, "cannot load frq file: %s", index->String(frq.pathOff));
+		return NULL;
+	}
+
+	PyObject* wav = PyDict_New();
+	PyObject* filename = PyUnicode_FromStringAndSize(index->String(entry->filenameOff), entry->filenameLen);
+	PyDict_SetItemString(wav, "filename", filename);
+	Py_DECREF(filename);
+	PyDict_SetItemString(wav, "offset", PyFloat_FromDouble(entry->offset));
+	PyDict_SetItemString(wav, "consonant", PyFloat_FromDouble(entry->consonant));
+	PyDict_SetItemString(wav, "cutoff", PyFloat_FromDouble(entry->cutoff));
+	PyDict_SetItemString(wav, "preutterance", PyFloat_FromDouble(entry->preutterance));
+	PyDict_SetItemString(wav, "overlap", PyFloat_FromDouble(entry->overlap));
+
+	PyObject* o_frq = PyDict_New();
+	PyDict_SetItemString(o_frq, "interval", PyLong_FromLong((long)frq.interval));
+	PyDict_SetItemString(o_frq, "key", PyFloat_FromDouble(frq.key));
+	PyObject* data = PyBytes_FromStringAndSize((const char*)index->FrqData(frq), sizeof(double) * 2 * frq.count);
+	PyDict_SetItemString(o_frq, "data", data);
+	Py_DECREF(data);
+
+	PyObject* ret = PyTuple_New(2);
+	PyTuple_SetItem(ret, 0, wav);
+	PyTuple_SetItem(ret, 1, o_frq);
+	return ret;
+}
+
+static PyObject* VoiceBankIndexGetPrefixMap(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	VoiceBankIndex* index = s_VoiceBankIndexMap[id];
+
+	PyObject* ret = PyDict_New();
+	const VBIndexPrefix* prefixes = index->Prefixes();
+	for (uint32_t i = 0; i < index->Header().numPrefixes; i++)
+	{
+		PyObject* key = PyUnicode_FromStringAndSize(index->String(prefixes[i].keyOff), prefixes[i].keyLen);
+		PyObject* value = PyUnicode_FromStringAndSize(index->String(prefixes[i].valueOff), prefixes[i].valueLen);
+		PyDict_SetItem(ret, key, value);
+		Py_DECREF(key);
+		Py_DECREF(value);
+	}
+	return ret;
+}
+
+// (wav filename, frq filename) of entries whose frq file is missing, one per frq file
+static PyObject* VoiceBankIndexGetMissingFrqs(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	VoiceBankIndex* index = s_VoiceBankIndexMap[id];
+
+	uint32_t count = index->Header().numEntries;
+	const VBIndexEntry* entries = index->Entries();
+	const VBIndexFrq* frqs = index->Frqs();
+	std::vector<bool> listed(index->Header().numFrqs, false);
+	PyObject* ret = PyList_New(0);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int32_t frqId = entries[i].frqId;
+		if (frqs[frqId].count >= 0 || listed[frqId]) continue;
+		listed[frqId] = true;
+		PyObject* wavName = PyUnicode_FromStringAndSize(index->String(entries[i].filenameOff), entries[i].filenameLen);
+		PyObject* frqName = PyUnicode_DecodeFSDefaultAndSize(index->String(frqs[frqId].pathOff), frqs[frqId].pathLen);
+		PyObject* item = PyTuple_New(2);
+		PyTuple_SetItem(item, 0, wavName);
+		PyTuple_SetItem(item, 1, frqName);
+		PyList_Append(ret, item);
+		Py_DECREF(item);
+	}
+	return ret;
+}
+
+static PyObject* VoiceBankIndexGetLyrics(PyObject *self, PyObject *args)
+{
+	unsigned id = (unsigned)PyLong_AsUnsignedLong(PyTuple_GetItem(args, 0));
+	VoiceBankIndex* index = s_VoiceBankIndexMap[id];
+
+	uint32_t count = index->Header().numEntries;
+	const VBIndexEntry* entries = index->Entries();
+	PyObject* ret = PyList_New(count);
+	for (uint32_t i = 0; i < count; i++)
+		PyList_SetItem(ret, i, PyUnicode_FromStringAndSize(index->String(entries[i].lyricOff), entries[i].lyricLen));
+	return ret;
+}
+
+// never destroyed, items hold Python objects which must not be released after finalization
+static WavCache* s_WavCache = new WavCache;
+
+static PyObject* LoadWavCached(PyObject *self, PyObject *args)
+{
+	std::string filename = ToFSString(PyTuple_GetItem(args, 0));
+	return s_WavCache->Load(filename);
+}
+
+static PyObject* WavCacheSetBudget(PyObject *self, PyObject *args)
+{
+	unsigned long long bytes = PyLong_AsUnsignedLongLong(PyTuple_GetItem(args, 0));
+	s_WavCache->SetBudget((size_t)bytes);
+	return PyLong_FromLong(0);
+}
+
+static PyObject* WavCacheClear(PyObject *self, PyObject *args)
+{
+	s_WavCache->Clear();
+	return PyLong_FromLong(0);
+}
+
+static PyObject* WavCacheInfo(PyObject *self, PyObject *args)
+{
+	PyObject* ret = PyDict_New();
+	PyDict_SetItemString(ret, "budget", PyLong_FromSize_t(s_WavCache->Budget()));
+	PyDict_SetItemString(ret, "used", PyLong_FromSize_t(s_WavCache->Used()));
+	PyDict_SetItemString(ret, "count", PyLong_FromSize_t(s_WavCache->Count()));
+	PyDict_SetItemString(ret, "hits", PyLong_FromUnsignedLongLong(s_WavCache->Hits()));
+	PyDict_SetItemString(ret, "misses", PyLong_FromUnsignedLongLong(s_WavCache->Misses()));
+	return ret;
+}
+
+static PyMethodDef s_Methods[] = {
+	{
+		"VoiceBankIndexLoad",
+		VoiceBankIndexLoad,
+		METH_VARARGS,
+		""
+	},
+	{
+		"VoiceBankIndexDel",
+		VoiceBankIndexDel,
+		METH_VARARGS,
+		""
+	},
+	{
+		"VoiceBankIndexFromCache",
+		VoiceBankIndexFromCache,
+		METH_VARARGS,
+		""
+	},
+	{
+		"VoiceBankIndexGetWavFrq",
+		VoiceBankIndexGetWavFrq,
+		METH_VARARGS,
+		""
+	},
+	{
+		"VoiceBankIndexGetPrefixMap",
+		VoiceBankIndexGetPrefixMap,
+		METH_VARARGS,
+		""
+	},
+	{
+		"VoiceBankIndexGetMissingFrqs",
+		VoiceBankIndexGetMissingFrqs,
+		METH_VARARGS,
+		""
+	},
+	{
+		"VoiceBankIndexGetLyrics",
+		VoiceBankIndexGetLyrics,
+		METH_VARARGS,
+		""
+	},
+	{
+		"LoadWavCached",
+		LoadWavCached,
+		METH_VARARGS,
+		""
+	},
+	{
+		"WavCacheSetBudget",
+		WavCacheSetBudget,
+		METH_VARARGS,
+		""
+	},
+	{
+		"WavCacheClear",
+		WavCacheClear,
+		METH_VARARGS,
+		""
+	},
+	{
+		"WavCacheInfo",
+		WavCacheInfo,
+		METH_VARARGS,
+		""
+	},
+	{ NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef cModPyDem =
+{
+	PyModuleDef_HEAD_INIT,
+	"UTAUUtils_module", /* name of module */
+	"",          /* module documentation, may be NULL */
+	-1,          /* size of per-interpreter state of the module, or -1 if the module keeps state in global variables. */
+	s_Methods
+};
+
+PyMODINIT_FUNC PyInit_PyUTAUUtils(void)
+{
+	return PyModule_Create(&cModPyDem);
+}
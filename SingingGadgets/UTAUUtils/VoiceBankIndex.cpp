@@ -0,0 +1,787 @@
+#include <Python.h>
+#include "VoiceBankIndex.h"
+#include "FileStat.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <unordered_map>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#define PATH_SEP "\\"
+#else
+#include <dirent.h>
+#define PATH_SEP "/"
+#endif
+
+static const char s_magic[8] = { 'S', 'G', 'V', 'B', 'I', 'D', 'X', 0 };
+
+// sub-directories in listing order, symbolic links are not followed (same as os.walk)
+static void ListSubDirs(const std::string& path, std::vector<std::string>& dirs)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE h = FindFirstFileA((path + "\\*").c_str(), &data);
+	if (h == INVALID_HANDLE_VALUE) return;
+	do
+	{
+		if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) continue;
+		if ((data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0) continue;
+		if (strcmp(data.cFileName, ".") == 0 || strcmp(data.cFileName, "..") == 0) continue;
+		dirs.push_back(data.cFileName);
+	} while (FindNextFileA(h, &data));
+	FindClose(h);
+#else
+	DIR* dir = opendir(path.c_str());
+	if (dir == nullptr) return;
+	struct dirent* ent;
+	while ((ent = readdir(dir)) != nullptr)
+	{
+		if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+		bool isDir = false;
+#ifdef _DIRENT_HAVE_D_TYPE
+		if (ent->d_type != DT_UNKNOWN)
+			isDir = ent->d_type == DT_DIR;
+		else
+#endif
+		{
+			struct stat st;
+			if (lstat((path + "/" + ent->d_name).c_str(), &st) == 0)
+				isDir = S_ISDIR(st.st_mode);
+		}
+		if (isDir) dirs.push_back(ent->d_name);
+	}
+	closedir(dir);
+#endif
+}
+
+static bool ReadWholeFile(const std::string& path, std::vector<char>& buf)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (!fp) return false;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	buf.resize(size > 0 ? (size_t)size : 0);
+	bool ok = size <= 0 || fread(buf.data(), 1, (size_t)size, fp) == (size_t)size;
+	fclose(fp);
+	return ok;
+}
+
+static int CompareStr(const char* a, size_t lenA, const char* b, size_t lenB)
+{
+	int c = memcmp(a, b, lenA < lenB ? lenA : lenB);
+	if (c != 0) return c;
+	if (lenA < lenB) return -1;
+	if (lenA > lenB) return 1;
+	return 0;
+}
+
+static bool LessStr(const std::string& a, const std::string& b)
+{
+	return CompareStr(a.data(), a.size(), b.data(), b.size()) < 0;
+}
+
+static std::string PyToUTF8(PyObject* str)
+{
+	ssize_t len;
+	const char* p = PyUnicode_AsUTF8AndSize(str, &len);
+	if (p == nullptr)
+	{
+		PyErr_Clear();
+		return std::string();
+	}
+	return std::string(p, (size_t)len);
+}
+
+static std::string PyToFS(PyObject* str)
+{
+	PyObject* bytes = PyUnicode_EncodeFSDefault(str);
+	if (bytes == nullptr)
+	{
+		PyErr_Clear();
+		return std::string();
+	}
+	std::string ret(PyBytes_AsString(bytes), (size_t)PyBytes_Size(bytes));
+	Py_DECREF(bytes);
+	return ret;
+}
+
+// str.encode(encoding).decode(fsEncoding), returns a new reference
+static PyObject* Transcode(PyObject* str, const char* encoding, const char* fsEncoding)
+{
+	PyObject* bytes = PyUnicode_AsEncodedString(str, encoding, "strict");
+	if (bytes != nullptr)
+	{
+		PyObject* ret = PyUnicode_FromEncodedObject(bytes, fsEncoding, "strict");
+		Py_DECREF(bytes);
+		if (ret != nullptr) return ret;
+	}
+	PyErr_Clear();
+	Py_INCREF(str);
+	return str;
+}
+
+// str[0:len(str)-4]+suffix, returns a new reference
+static PyObject* ReplaceExt(PyObject* str, const char* suffix)
+{
+	PyObject* base = PySequence_GetSlice(str, 0, PyUnicode_GetLength(str) - 4);
+	if (suffix == nullptr) return base;
+	PyObject* o_suffix = PyUnicode_FromString(suffix);
+	PyObject* ret = PyUnicode_Concat(base, o_suffix);
+	Py_DECREF(o_suffix);
+	Py_DECREF(base);
+	return ret;
+}
+
+struct BuildEntry
+{
+	std::string lyric;
+	std::string filename;
+	std::string frqPath;
+	double offset;
+	double consonant;
+	double cutoff;
+	double preutterance;
+	double overlap;
+};
+
+struct BuildFrq
+{
+	std::string path;
+	int interval;
+	int count;
+	double key;
+	std::vector<double> data;
+};
+
+struct BuildStamp
+{
+	std::string path;
+	int64_t mtime;
+	int64_t size;
+};
+
+struct OtoParser
+{
+	const VoiceBankParams* params;
+	std::vector<BuildEntry> entries;
+	std::unordered_map<std::string, size_t> lyricMap;
+
+	void AddEntry(BuildEntry& entry)
+	{
+		std::unordered_map<std::string, size_t>::iterator iter = lyricMap.find(entry.lyric);
+		if (iter == lyricMap.end())
+		{
+			lyricMap[entry.lyric] = entries.size();
+			entries.push_back(entry);
+		}
+		else
+		{
+			entries[iter->second] = entry;
+		}
+	}
+
+	bool ParseFile(const std::string& dirPath, const std::string& otoPath)
+	{
+		std::vector<char> raw;
+		if (!ReadWholeFile(otoPath, raw))
+		{
+			PyErr_SetFromErrnoWithFilename(PyExc_OSError, otoPath.c_str());
+			return false;
+		}
+		PyObject* text = PyUnicode_Decode(raw.data(), (ssize_t)raw.size(), params->encoding.c_str(), "strict");
+		if (text == nullptr) return false;
+
+		PyObject* dirStr = PyUnicode_DecodeFSDefaultAndSize(dirPath.data(), (ssize_t)dirPath.size());
+		PyObject* slash = PyUnicode_FromString("/");
+		PyObject* dirPrefix = PyUnicode_Concat(dirStr, slash);
+		Py_DECREF(slash);
+		Py_DECREF(dirStr);
+
+		ssize_t textLen;
+		const char* p_text = PyUnicode_AsUTF8AndSize(text, &textLen);
+		const char* end = p_text + textLen;
+		const char* line = p_text;
+		while (line < end)
+		{
+			const char* lineEnd = line;
+			while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r') lineEnd++;
+			_parseLine(dirPrefix, std::string(line, lineEnd));
+			line = lineEnd + 1;
+		}
+
+		Py_DECREF(dirPrefix);
+		Py_DECREF(text);
+		return true;
+	}
+
+	void _parseLine(PyObject* dirPrefix, const std::string& line)
+	{
+		size_t p = line.find('=');
+		if (p == std::string::npos) return;
+		std::string fn = line.substr(0, p);
+		p++;
+
+		size_t p2 = line.find(',', p);
+		if (p2 == std::string::npos) return;
+		std::string lyric = line.substr(p, p2 - p);
+		p = p2 + 1;
+
+		double values[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+		for (int i = 0; i < 4; i++)
+		{
+			p2 = line.find(',', p);
+			if (p2 == std::string::npos) return;
+			if (p2 > p) values[i] = strtod(line.substr(p, p2 - p).c_str(), nullptr);
+			p = p2 + 1;
+		}
+		if (p < line.size()) values[4] = strtod(line.substr(p).c_str(), nullptr);
+
+		PyObject* o_fn = PyUnicode_DecodeUTF8(fn.data(), (ssize_t)fn.size(), "strict");
+		if (o_fn == nullptr)
+		{
+			PyErr_Clear();
+			return;
+		}
+
+		if (lyric.size() == 0)
+		{
+			PyObject* o_lyric = ReplaceExt(o_fn, nullptr);
+			lyric = PyToUTF8(o_lyric);
+			Py_DECREF(o_lyric);
+		}
+
+		PyObject* filename = PyUnicode_Concat(dirPrefix, o_fn);
+		Py_DECREF(o_fn);
+
+		BuildEntry entry;
+		entry.lyric = lyric;
+		if (params->wavFileNameTranscode)
+		{
+			PyObject* transcoded = Transcode(filename, params->encoding.c_str(), params->fsEncoding.c_str());
+			entry.filename = PyToUTF8(transcoded);
+			Py_DECREF(transcoded);
+		}
+		else
+			entry.filename = PyToUTF8(filename);
+
+		PyObject* frqName = ReplaceExt(filename, "_wav.frq");
+		if (params->frqFileNameTranscode)
+		{
+			PyObject* transcoded = Transcode(frqName, params->encoding.c_str(), params->fsEncoding.c_str());
+			Py_DECREF(frqName);
+			frqName = transcoded;
+		}
+		entry.frqPath = PyToFS(frqName);
+		Py_DECREF(frqName);
+		Py_DECREF(filename);
+
+		entry.offset = values[0];
+		entry.consonant = values[1];
+		entry.cutoff = values[2];
+		entry.preutterance = values[3];
+		entry.overlap = values[4];
+
+		AddEntry(entry);
+	}
+};
+
+static void LoadFrq(BuildFrq& frq)
+{
+	frq.interval = 0;
+	frq.count = -1;
+	frq.key = 0.0;
+
+	std::vector<char> raw;
+	if (!ReadWholeFile(frq.path, raw) || raw.size() < 40) return;
+
+	int32_t interval, count;
+	double key;
+	memcpy(&interval, raw.data() + 8, sizeof(int32_t));
+	memcpy(&key, raw.data() + 12, sizeof(double));
+	memcpy(&count, raw.data() + 36, sizeof(int32_t));
+	if (count < 0 || raw.size() < 40 + (size_t)count * 2 * sizeof(double)) return;
+
+	frq.interval = interval;
+	frq.key = key;
+	frq.count = count;
+	frq.data.resize((size_t)count * 2);
+	if (count > 0)
+		memcpy(frq.data.data(), raw.data() + 40, (size_t)count * 2 * sizeof(double));
+}
+
+static void LoadPrefixMap(const std::string& text, std::vector<std::pair<std::string, std::string> >& prefixes)
+{
+	std::unordered_map<std::string, size_t> keyMap;
+	const char* p = text.data();
+	const char* end = p + text.size();
+	while (p < end)
+	{
+		const char* lineEnd = p;
+		while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r') lineEnd++;
+
+		std::vector<std::string> words;
+		const char* q = p;
+		while (q < lineEnd)
+		{
+			while (q < lineEnd && isspace((unsigned char)*q)) q++;
+			const char* wordStart = q;
+			while (q < lineEnd && !isspace((unsigned char)*q)) q++;
+			if (q > wordStart) words.push_back(std::string(wordStart, q));
+		}
+		if (words.size() > 0)
+		{
+			std::string prefix;
+			if (words.size() > 1) prefix = words[1];
+			std::unordered_map<std::string, size_t>::iterator iter = keyMap.find(words[0]);
+			if (iter == keyMap.end())
+			{
+				keyMap[words[0]] = prefixes.size();
+				prefixes.push_back(std::pair<std::string, std::string>(words[0], prefix));
+			}
+			else
+				prefixes[iter->second].second = prefix;
+		}
+		p = lineEnd + 1;
+	}
+}
+
+static void AddStamp(std::vector<BuildStamp>& stamps, const std::string& path)
+{
+	BuildStamp stamp;
+	stamp.path = path;
+	bool isDir;
+	if (!StatPath(path, stamp.mtime, stamp.size, isDir))
+	{
+		stamp.mtime = 0;
+		stamp.size = -1;
+	}
+	stamps.push_back(stamp);
+}
+
+/*
+The mtime of a directory also changes when the index file itself is written into it,
+so directories are stamped by the list of their sub-directories instead.
+*/
+#define VBINDEX_DIR_STAMP (-2)
+
+static int64_t HashSubDirs(const std::vector<std::string>& subDirs)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < subDirs.size(); i++)
+	{
+		const std::string& name = subDirs[i];
+		for (size_t j = 0; j <= name.size(); j++)
+		{
+			hash ^= (unsigned char)name.c_str()[j];
+			hash *= 1099511628211ULL;
+		}
+	}
+	return (int64_t)hash;
+}
+
+static void AddDirStamp(std::vector<BuildStamp>& stamps, const std::string& path, const std::vector<std::string>& subDirs)
+{
+	BuildStamp stamp;
+	stamp.path = path;
+	stamp.mtime = HashSubDirs(subDirs);
+	stamp.size = VBINDEX_DIR_STAMP;
+	stamps.push_back(stamp);
+}
+
+class StringPool
+{
+public:
+	uint32_t Add(const std::string& s)
+	{
+		uint32_t off = (uint32_t)m_data.size();
+		m_data += s;
+		m_data.push_back(0);
+		return off;
+	}
+	const std::string& Data() const { return m_data; }
+private:
+	std::string m_data;
+};
+
+static uint64_t Align8(uint64_t v)
+{
+	return (v + 7) & ~(uint64_t)7;
+}
+
+bool VoiceBankIndex::_build(const VoiceBankParams& params, std::vector<char>& blob)
+{
+	std::vector<BuildStamp> stamps;
+	OtoParser parser;
+	parser.params = &params;
+
+	// walk the directories top-down
+	std::vector<std::string> dirStack;
+	dirStack.push_back(params.root);
+	while (dirStack.size() > 0)
+	{
+		std::string dirPath = dirStack.back();
+		dirStack.pop_back();
+
+		std::string otoPath = dirPath + "/oto.ini";
+		AddStamp(stamps, otoPath);
+		if (stamps.back().size >= 0)
+		{
+			if (!parser.ParseFile(dirPath, otoPath)) return false;
+		}
+
+		std::vector<std::string> subDirs;
+		ListSubDirs(dirPath, subDirs);
+		AddDirStamp(stamps, dirPath, subDirs);
+		std::string sep = PATH_SEP;
+		char last = dirPath.size() > 0 ? dirPath[dirPath.size() - 1] : 0;
+		if (last == '/' || last == '\\') sep = "";
+		for (size_t i = subDirs.size(); i > 0; i--)
+			dirStack.push_back(dirPath + sep + subDirs[i - 1]);
+	}
+
+	std::vector<std::pair<std::string, std::string> > prefixes;
+	std::string prefixPath = params.root + "/prefix.map";
+	AddStamp(stamps, prefixPath);
+	if (stamps.back().size >= 0)
+	{
+		std::vector<char> raw;
+		if (!ReadWholeFile(prefixPath, raw))
+		{
+			PyErr_SetFromErrnoWithFilename(PyExc_OSError, prefixPath.c_str());
+			return false;
+		}
+		raw.push_back(0);
+		PyObject* text = PyUnicode_DecodeLocaleAndSize(raw.data(), (ssize_t)raw.size() - 1, "strict");
+		if (text == nullptr) return false;
+		LoadPrefixMap(PyToUTF8(text), prefixes);
+		Py_DECREF(text);
+		std::sort(prefixes.begin(), prefixes.end(),
+			[](const std::pair<std::string, std::string>& a, const std::pair<std::string, std::string>& b) { return LessStr(a.first, b.first); });
+	}
+
+	std::vector<BuildEntry>& entries = parser.entries;
+	std::sort(entries.begin(), entries.end(),
+		[](const BuildEntry& a, const BuildEntry& b) { return LessStr(a.lyric, b.lyric); });
+
+	// aliases often share one wav file, load each frq only once
+	std::vector<BuildFrq> frqs;
+	std::vector<int32_t> entryFrqIds(entries.size());
+	std::unordered_map<std::string, int32_t> frqMap;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const std::string& path = entries[i].frqPath;
+		std::unordered_map<std::string, int32_t>::iterator iter = frqMap.find(path);
+		if (iter != frqMap.end())
+		{
+			entryFrqIds[i] = iter->second;
+			continue;
+		}
+		int32_t id = (int32_t)frqs.size();
+		frqMap[path] = id;
+		entryFrqIds[i] = id;
+		frqs.push_back(BuildFrq());
+		frqs.back().path = path;
+		LoadFrq(frqs.back());
+		AddStamp(stamps, path);
+	}
+
+	// layout
+	StringPool strings;
+	VBIndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, s_magic, 8);
+	header.version = VBINDEX_VERSION;
+	header.flags = (params.wavFileNameTranscode ? VBINDEX_WAV_TRANSCODE : 0) | (params.frqFileNameTranscode ? VBINDEX_FRQ_TRANSCODE : 0);
+	header.rootLen = (uint32_t)params.root.size();
+	header.rootOff = strings.Add(params.root);
+	header.encodingLen = (uint32_t)params.encoding.size();
+	header.encodingOff = strings.Add(params.encoding);
+	header.fsEncodingLen = (uint32_t)params.fsEncoding.size();
+	header.fsEncodingOff = strings.Add(params.fsEncoding);
+	header.numStamps = (uint32_t)stamps.size();
+	header.numEntries = (uint32_t)entries.size();
+	header.numPrefixes = (uint32_t)prefixes.size();
+	header.numFrqs = (uint32_t)frqs.size();
+
+	uint64_t offset = Align8(sizeof(VBIndexHeader));
+	header.stampsOffset = offset;
+	offset = Align8(offset + sizeof(VBIndexStamp)*stamps.size());
+	header.entriesOffset = offset;
+	offset = Align8(offset + sizeof(VBIndexEntry)*entries.size());
+	header.prefixesOffset = offset;
+	offset = Align8(offset + sizeof(VBIndexPrefix)*prefixes.size());
+	header.frqsOffset = offset;
+	offset = Align8(offset + sizeof(VBIndexFrq)*frqs.size());
+
+	std::vector<VBIndexFrq> o_frqs(frqs.size());
+	for (size_t i = 0; i < frqs.size(); i++)
+	{
+		VBIndexFrq& o_frq = o_frqs[i];
+		memset(&o_frq, 0, sizeof(VBIndexFrq));
+		o_frq.interval = frqs[i].interval;
+		o_frq.count = frqs[i].count;
+		o_frq.key = frqs[i].key;
+		o_frq.dataOffset = offset;
+		o_frq.pathLen = (uint32_t)frqs[i].path.size();
+		o_frq.pathOff = strings.Add(frqs[i].path);
+		offset += sizeof(double)*frqs[i].data.size();
+	}
+
+	std::vector<VBIndexStamp> o_stamps(stamps.size());
+	for (size_t i = 0; i < stamps.size(); i++)
+	{
+		o_stamps[i].pathLen = (uint32_t)stamps[i].path.size();
+		o_stamps[i].pathOff = strings.Add(stamps[i].path);
+		o_stamps[i].mtime = stamps[i].mtime;
+		o_stamps[i].size = stamps[i].size;
+	}
+
+	std::vector<VBIndexEntry> o_entries(entries.size());
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		VBIndexEntry& o_entry = o_entries[i];
+		memset(&o_entry, 0, sizeof(VBIndexEntry));
+		o_entry.lyricLen = (uint32_t)entries[i].lyric.size();
+		o_entry.lyricOff = strings.Add(entries[i].lyric);
+		o_entry.filenameLen = (uint32_t)entries[i].filename.size();
+		o_entry.filenameOff = strings.Add(entries[i].filename);
+		o_entry.frqId = entryFrqIds[i];
+		o_entry.offset = entries[i].offset;
+		o_entry.consonant = entries[i].consonant;
+		o_entry.cutoff = entries[i].cutoff;
+		o_entry.preutterance = entries[i].preutterance;
+		o_entry.overlap = entries[i].overlap;
+	}
+
+	std::vector<VBIndexPrefix> o_prefixes(prefixes.size());
+	for (size_t i = 0; i < prefixes.size(); i++)
+	{
+		o_prefixes[i].keyLen = (uint32_t)prefixes[i].first.size();
+		o_prefixes[i].keyOff = strings.Add(prefixes[i].first);
+		o_prefixes[i].valueLen = (uint32_t)prefixes[i].second.size();
+		o_prefixes[i].valueOff = strings.Add(prefixes[i].second);
+	}
+
+	offset = Align8(offset);
+	header.stringsOffset = offset;
+	header.stringsSize = strings.Data().size();
+	header.totalSize = offset + header.stringsSize;
+
+	blob.assign((size_t)header.totalSize, 0);
+	char* p = blob.data();
+	memcpy(p, &header, sizeof(header));
+	if (stamps.size() > 0)
+		memcpy(p + header.stampsOffset, o_stamps.data(), sizeof(VBIndexStamp)*stamps.size());
+	if (entries.size() > 0)
+		memcpy(p + header.entriesOffset, o_entries.data(), sizeof(VBIndexEntry)*entries.size());
+	if (prefixes.size() > 0)
+		memcpy(p + header.prefixesOffset, o_prefixes.data(), sizeof(VBIndexPrefix)*prefixes.size());
+	if (frqs.size() > 0)
+		memcpy(p + header.frqsOffset, o_frqs.data(), sizeof(VBIndexFrq)*frqs.size());
+	for (size_t i = 0; i < frqs.size(); i++)
+	{
+		if (frqs[i].data.size() > 0)
+			memcpy(p + o_frqs[i].dataOffset, frqs[i].data.data(), sizeof(double)*frqs[i].data.size());
+	}
+	memcpy(p + header.stringsOffset, strings.Data().data(), strings.Data().size());
+
+	return true;
+}
+
+// off + len <= size, without overflowing
+static bool InRange(uint64_t off, uint64_t len, uint64_t size)
+{
+	return off <= size && len <= size - off;
+}
+
+// tables are 8-aligned, they are read in place
+static bool TableInRange(uint64_t off, uint64_t count, size_t itemSize, uint64_t size)
+{
+	return off % 8 == 0 && off >= sizeof(VBIndexHeader) && count <= size / itemSize && InRange(off, count*itemSize, size);
+}
+
+/*
+A truncated or damaged file must not be read past its end: every table, string
+and frq data block is checked against the sizes, and frq ids against the frq
+table, before the stamps are.
+*/
+static bool CheckLayout(const VBIndexHeader& header, const unsigned char* data)
+{
+	uint64_t stringsSize = header.stringsSize;
+	uint64_t tablesEnd = header.stringsOffset;
+	if (!TableInRange(header.stampsOffset, header.numStamps, sizeof(VBIndexStamp), tablesEnd)) return false;
+	if (!TableInRange(header.entriesOffset, header.numEntries, sizeof(VBIndexEntry), tablesEnd)) return false;
+	if (!TableInRange(header.prefixesOffset, header.numPrefixes, sizeof(VBIndexPrefix), tablesEnd)) return false;
+	if (!TableInRange(header.frqsOffset, header.numFrqs, sizeof(VBIndexFrq), tablesEnd)) return false;
+
+	if (!InRange(header.rootOff, header.rootLen, stringsSize)) return false;
+	if (!InRange(header.encodingOff, header.encodingLen, stringsSize)) return false;
+	if (!InRange(header.fsEncodingOff, header.fsEncodingLen, stringsSize)) return false;
+
+	const VBIndexStamp* stamps = (const VBIndexStamp*)(data + header.stampsOffset);
+	for (uint32_t i = 0; i < header.numStamps; i++)
+		if (!InRange(stamps[i].pathOff, stamps[i].pathLen, stringsSize)) return false;
+
+	const VBIndexEntry* entries = (const VBIndexEntry*)(data + header.entriesOffset);
+	for (uint32_t i = 0; i < header.numEntries; i++)
+	{
+		if (!InRange(entries[i].lyricOff, entries[i].lyricLen, stringsSize)) return false;
+		if (!InRange(entries[i].filenameOff, entries[i].filenameLen, stringsSize)) return false;
+		if (entries[i].frqId < 0 || (uint32_t)entries[i].frqId >= header.numFrqs) return false;
+	}
+
+	const VBIndexPrefix* prefixes = (const VBIndexPrefix*)(data + header.prefixesOffset);
+	for (uint32_t i = 0; i < header.numPrefixes; i++)
+	{
+		if (!InRange(prefixes[i].keyOff, prefixes[i].keyLen, stringsSize)) return false;
+		if (!InRange(prefixes[i].valueOff, prefixes[i].valueLen, stringsSize)) return false;
+	}
+
+	const VBIndexFrq* frqs = (const VBIndexFrq*)(data + header.frqsOffset);
+	for (uint32_t i = 0; i < header.numFrqs; i++)
+	{
+		if (!InRange(frqs[i].pathOff, frqs[i].pathLen, stringsSize)) return false;
+		if (frqs[i].count < 0) continue;
+		// (freq, dyn) pairs of doubles
+		if (!TableInRange(frqs[i].dataOffset, (uint64_t)frqs[i].count, sizeof(double) * 2, tablesEnd)) return false;
+	}
+	return true;
+}
+
+static bool SameString(const char* strings, uint32_t off, uint32_t len, const std::string& s)
+{
+	return len == s.size() && memcmp(strings + off, s.data(), len) == 0;
+}
+
+bool VoiceBankIndex::_checkFile(const VoiceBankParams& params, const unsigned char* data, size_t size)
+{
+	if (size < sizeof(VBIndexHeader)) return false;
+	const VBIndexHeader& header = *(const VBIndexHeader*)data;
+	if (memcmp(header.magic, s_magic, 8) != 0) return false;
+	if (header.version != VBINDEX_VERSION) return false;
+	if (header.totalSize != size) return false;
+	if (header.stringsOffset > size || header.stringsSize != size - header.stringsOffset) return false;
+	if (!CheckLayout(header, data)) return false;
+
+	uint32_t flags = (params.wavFileNameTranscode ? VBINDEX_WAV_TRANSCODE : 0) | (params.frqFileNameTranscode ? VBINDEX_FRQ_TRANSCODE : 0);
+	if (header.flags != flags) return false;
+
+	const char* strings = (const char*)data + header.stringsOffset;
+	if (!SameString(strings, header.rootOff, header.rootLen, params.root)) return false;
+	if (!SameString(strings, header.encodingOff, header.encodingLen, params.encoding)) return false;
+	if (!SameString(strings, header.fsEncodingOff, header.fsEncodingLen, params.fsEncoding)) return false;
+
+	const VBIndexStamp* stamps = (const VBIndexStamp*)(data + header.stampsOffset);
+	for (uint32_t i = 0; i < header.numStamps; i++)
+	{
+		std::string path(strings + stamps[i].pathOff, stamps[i].pathLen);
+		if (stamps[i].size == VBINDEX_DIR_STAMP)
+		{
+			std::vector<std::string> subDirs;
+			ListSubDirs(path, subDirs);
+			if (HashSubDirs(subDirs) != stamps[i].mtime) return false;
+			continue;
+		}
+		int64_t mtime, fsize;
+		bool isDir;
+		if (!StatPath(path, mtime, fsize, isDir))
+		{
+			if (stamps[i].size != -1) return false;
+		}
+		else if (mtime != stamps[i].mtime || fsize != stamps[i].size) return false;
+	}
+	return true;
+}
+
+VoiceBankIndex::VoiceBankIndex() : m_data(nullptr), m_size(0), m_fromCache(false)
+{
+
+}
+
+VoiceBankIndex::~VoiceBankIndex()
+{
+
+}
+
+bool VoiceBankIndex::Load(const VoiceBankParams& params, const char* indexFile)
+{
+	m_file.Close();
+	m_blob.clear();
+	m_data = nullptr;
+	m_size = 0;
+	m_fromCache = false;
+
+	bool hasIndexFile = indexFile != nullptr && indexFile[0] != 0;
+
+	if (hasIndexFile && m_file.Open(indexFile))
+	{
+		if (_checkFile(params, m_file.Data(), m_file.Size()))
+		{
+			m_data = (const char*)m_file.Data();
+			m_size = m_file.Size();
+			m_fromCache = true;
+			return true;
+		}
+		m_file.Close();
+	}
+
+	if (!_build(params, m_blob)) return false;
+	m_data = m_blob.data();
+	m_size = m_blob.size();
+
+	// failing to write the index is not an error, we just keep it in memory
+	if (hasIndexFile)
+	{
+		std::string tmpFile = std::string(indexFile) + ".tmp";
+		FILE* fp = fopen(tmpFile.c_str(), "wb");
+		if (fp)
+		{
+			bool ok = fwrite(m_blob.data(), 1, m_blob.size(), fp) == m_blob.size();
+			ok = (fclose(fp) == 0) && ok;
+#ifdef _WIN32
+			if (ok) remove(indexFile);
+#endif
+			if (!ok || rename(tmpFile.c_str(), indexFile) != 0)
+				remove(tmpFile.c_str());
+		}
+	}
+
+	return true;
+}
+
+const VBIndexEntry* VoiceBankIndex::FindEntry(const char* lyric, size_t len) const
+{
+	const VBIndexEntry* entries = Entries();
+	size_t lo = 0;
+	size_t hi = Header().numEntries;
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		int c = CompareStr(String(entries[mid].lyricOff), entries[mid].lyricLen, lyric, len);
+		if (c == 0) return entries + mid;
+		if (c < 0) lo = mid + 1;
+		else hi = mid;
+	}
+	return nullptr;
+}
+
+const VBIndexPrefix* VoiceBankIndex::FindPrefix(const char* key, size_t len) const
+{
+	const VBIndexPrefix* prefixes = Prefixes();
+	size_t lo = 0;
+	size_t hi = Header().numPrefixes;
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		int c = CompareStr(String(prefixes[mid].keyOff), prefixes[mid].keyLen, key, len);
+		if (c == 0) return prefixes + mid;
+		if (c < 0) lo = mid + 1;
+		else hi = mid;
+	}
+	return nullptr;
+}
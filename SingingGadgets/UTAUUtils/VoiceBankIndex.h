@@ -0,0 +1,131 @@
+#ifndef _VoiceBankIndex_h
+#define _VoiceBankIndex_h
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "Deferred.h"
+
+/*
+Compiled index of an UTAU voicebank.
+The index is one flat blob which can be written to disk and memory-mapped back
+on the next start. All offsets are in bytes. String offsets are relative to
+stringsOffset, other offsets are relative to the beginning of the blob.
+*/
+
+#define VBINDEX_VERSION 1
+
+struct VBIndexHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t rootOff, rootLen;
+	uint32_t encodingOff, encodingLen;
+	uint32_t fsEncodingOff, fsEncodingLen;
+	uint32_t numStamps;
+	uint32_t numEntries;
+	uint32_t numPrefixes;
+	uint32_t numFrqs;
+	uint64_t stampsOffset;
+	uint64_t entriesOffset;
+	uint64_t prefixesOffset;
+	uint64_t frqsOffset;
+	uint64_t stringsOffset;
+	uint64_t stringsSize;
+	uint64_t totalSize;
+};
+
+// a file or directory the index depends on, size==-1 means the file did not exist,
+// size==-2 marks a directory, whose mtime field holds a hash of its sub-directory names
+struct VBIndexStamp
+{
+	uint32_t pathOff, pathLen;
+	int64_t mtime;
+	int64_t size;
+};
+
+// oto.ini entry, sorted by lyric
+struct VBIndexEntry
+{
+	uint32_t lyricOff, lyricLen;
+	uint32_t filenameOff, filenameLen;
+	int32_t frqId;
+	uint32_t reserved;
+	double offset;
+	double consonant;
+	double cutoff;
+	double preutterance;
+	double overlap;
+};
+
+// content of a _wav.frq file, count==-1 means the file is missing or broken
+struct VBIndexFrq
+{
+	int32_t interval;
+	int32_t count;
+	double key;
+	uint64_t dataOffset;
+	uint32_t pathOff, pathLen;
+};
+
+// prefix.map entry, sorted by key
+struct VBIndexPrefix
+{
+	uint32_t keyOff, keyLen;
+	uint32_t valueOff, valueLen;
+};
+
+#define VBINDEX_WAV_TRANSCODE 1
+#define VBINDEX_FRQ_TRANSCODE 2
+
+struct VoiceBankParams
+{
+	std::string root;
+	std::string encoding;
+	std::string fsEncoding;
+	bool wavFileNameTranscode;
+	bool frqFileNameTranscode;
+};
+
+class VoiceBankIndex
+{
+public:
+	VoiceBankIndex();
+	~VoiceBankIndex();
+
+	// Try the index file first, rebuild (and try to rewrite it) when any stamp is outdated.
+	// indexFile can be empty, in which case the index only lives in memory.
+	// Returns false with a Python exception set on failure.
+	bool Load(const VoiceBankParams& params, const char* indexFile);
+
+	// true if the last Load() was served from an existing index file
+	bool FromCache() const { return m_fromCache; }
+
+	const VBIndexHeader& Header() const { return *(const VBIndexHeader*)m_data; }
+	const char* String(uint32_t off) const { return m_data + Header().stringsOffset + off; }
+
+	const VBIndexEntry* Entries() const { return (const VBIndexEntry*)(m_data + Header().entriesOffset); }
+	const VBIndexStamp* Stamps() const { return (const VBIndexStamp*)(m_data + Header().stampsOffset); }
+	const VBIndexPrefix* Prefixes() const { return (const VBIndexPrefix*)(m_data + Header().prefixesOffset); }
+	const VBIndexFrq* Frqs() const { return (const VBIndexFrq*)(m_data + Header().frqsOffset); }
+	const double* FrqData(const VBIndexFrq& frq) const { return (const double*)(m_data + frq.dataOffset); }
+
+	const VBIndexEntry* FindEntry(const char* lyric, size_t len) const;
+	const VBIndexPrefix* FindPrefix(const char* key, size_t len) const;
+
+private:
+	bool _checkFile(const VoiceBankParams& params, const unsigned char* data, size_t size);
+	bool _build(const VoiceBankParams& params, std::vector<char>& blob);
+
+	MappedFile m_file;
+	std::vector<char> m_blob;
+	const char* m_data;
+	size_t m_size;
+	bool m_fromCache;
+};
+
+typedef Deferred<VoiceBankIndex> VoiceBankIndex_Deferred;
+
+#endif
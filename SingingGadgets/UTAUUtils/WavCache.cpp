@@ -0,0 +1,103 @@
+#include "WavCache.h"
+#include "WavFile.h"
+#include "MappedFile.h"
+#include "FileStat.h"
+
+WavCache::WavCache() : m_budget((size_t)256 * 1024 * 1024), m_used(0), m_hits(0), m_misses(0)
+{
+
+}
+
+WavCache::~WavCache()
+{
+	Clear();
+}
+
+void WavCache::_remove(ItemList::iterator iter)
+{
+	m_used -= iter->bytes;
+	Py_DECREF(iter->data);
+	m_map.erase(iter->path);
+	m_items.erase(iter);
+}
+
+void WavCache::_trim()
+{
+	while (m_used > m_budget && m_items.size() > 0)
+		_remove(--m_items.end());
+}
+
+void WavCache::SetBudget(size_t bytes)
+{
+	m_budget = bytes;
+	_trim();
+}
+
+void WavCache::Clear()
+{
+	while (m_items.size() > 0)
+		_remove(m_items.begin());
+}
+
+PyObject* WavCache::Load(const std::string& path)
+{
+	int64_t mtime, size;
+	bool isDir;
+	if (!StatPath(path, mtime, size, isDir) || isDir)
+	{
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+		return NULL;
+	}
+
+	std::unordered_map<std::string, ItemList::iterator>::iterator iter = m_map.find(path);
+	if (iter != m_map.end())
+	{
+		ItemList::iterator item = iter->second;
+		if (item->mtime == mtime && item->size == size)
+		{
+			m_hits++;
+			m_items.splice(m_items.begin(), m_items, item);
+			Py_INCREF(item->data);
+			return item->data;
+		}
+		_remove(item);
+	}
+	m_misses++;
+
+	MappedFile file;
+	if (!file.Open(path.c_str()))
+	{
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+		return NULL;
+	}
+
+	WavFileInfo info;
+	if (!ParseWavFile(file.Data(), file.Size(), info))
+		Py_RETURN_NONE;
+
+	size_t count = info.numFrames * info.numChannels;
+	PyObject* data = PyBytes_FromStringAndSize(nullptr, (ssize_t)(count * sizeof(float)));
+	if (!WavFileToF32(info, (float*)PyBytes_AsString(data)))
+	{
+		Py_DECREF(data);
+		Py_RETURN_NONE;
+	}
+
+	size_t bytes = count * sizeof(float);
+	if (bytes <= m_budget)
+	{
+		Item item;
+		item.path = path;
+		item.mtime = mtime;
+		item.size = size;
+		item.data = data;
+		item.bytes = bytes;
+		Py_INCREF(data);
+		m_items.push_front(item);
+		m_map[path] = m_items.begin();
+		m_used += bytes;
+		_trim();
+	}
+
+	return data;
+}
@@ -0,0 +1,56 @@
+#ifndef _WavCache_h
+#define _WavCache_h
+
+#include <Python.h>
+#include <stdint.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+
+/*
+Decoded voicebank wavs, kept as float32 bytes objects so that the same buffer
+can be handed to the VoiceSampler again and again.
+Least recently used items are dropped when the byte budget is exceeded.
+*/
+class WavCache
+{
+public:
+	WavCache();
+	~WavCache();
+
+	// New reference to a float32 bytes object.
+	// Py_None if the format is not supported natively, NULL with an exception set if the file cannot be read.
+	PyObject* Load(const std::string& path);
+
+	void SetBudget(size_t bytes);
+	size_t Budget() const { return m_budget; }
+	size_t Used() const { return m_used; }
+	size_t Count() const { return m_items.size(); }
+	unsigned long long Hits() const { return m_hits; }
+	unsigned long long Misses() const { return m_misses; }
+
+	void Clear();
+
+private:
+	struct Item
+	{
+		std::string path;
+		int64_t mtime;
+		int64_t size;
+		PyObject* data;
+		size_t bytes;
+	};
+	typedef std::list<Item> ItemList;
+
+	void _remove(ItemList::iterator iter);
+	void _trim();
+
+	ItemList m_items; // most recently used first
+	std::unordered_map<std::string, ItemList::iterator> m_map;
+	size_t m_budget;
+	size_t m_used;
+	unsigned long long m_hits;
+	unsigned long long m_misses;
+};
+
+#endif
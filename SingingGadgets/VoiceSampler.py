@@ -1 +1,16 @@
 from .PyVoiceSampler import *
+from . import PyVoiceSampler
+
+def GenerateSentence(sentence, quality='full'):
+	'''
+	quality -- 'full': HNM synthesis
+	           'draft': TD-PSOLA preview, no noise synthesis. Much faster, same timing and alignment
+	'''
+	if quality=='draft':
+		return PyVoiceSampler.GenerateSentenceDraft(sentence)
+	return PyVoiceSampler.GenerateSentence(sentence)
+
+def GenerateSentenceCUDA(sentence, quality='full'):
+	if quality=='draft':
+		return PyVoiceSampler.GenerateSentenceDraft(sentence)
+	return PyVoiceSampler.GenerateSentenceCUDA(sentence)
@@ -1,5 +1,7 @@
 #include "FrequencyDetection.h"
 #include "fft.h"
+#include "fftplan.h"
+#include <vector>
 #include <memory.h>
 #include <stdio.h>
 #include <math.h>
@@ -41,21 +43,31 @@ void fetchFrequency(unsigned length, float *samples, unsigned sampleRate, float&
 	}
 
 	ifft(fftData, l);
-	
-	dyn = (float)fftData[0].Re*700.0f;
+
+	pickFrequency(&fftData[0].Re, 2, len, sampleRate, freq, dyn);
+
+	delete[] fftData;
+
+}
+
+// Picks the pitch from an autocorrelation sequence r[0], r[stride], r[2*stride]...
+void pickFrequency(const double* r, unsigned stride, unsigned len, unsigned sampleRate, float& freq, float& dyn)
+{
+	double r0 = r[0];
+	dyn = (float)r0*700.0f;
 	freq = 55.0f;
 
-	if (fftData[0].Re > 0.01)
+	if (r0 > 0.01)
 	{
 		unsigned maxi = (unsigned)(-1);
 
-		double lastV = fftData[0].Re;
+		double lastV = r0;
 		double maxV = 0.0f;
 		bool ascending = false;
 
 		for (unsigned i = sampleRate / 600; i < min(sampleRate / 55, len / 2); i++)
 		{
-			double v = fftData[i].Re;
+			double v = r[i*stride];
 			if (!ascending)
 			{
 				if (v > lastV) ascending = true;
@@ -64,9 +76,9 @@ void fetchFrequency(unsigned length, float *samples, unsigned sampleRate, float&
 			{
 				if (v < lastV)
 				{
-					if (fftData[i - 1].Re>maxV)
+					if (r[(i - 1)*stride]>maxV)
 					{
-						maxV = fftData[i - 1].Re;
+						maxV = r[(i - 1)*stride];
 						maxi = i - 1;
 					}
 					ascending = false;
@@ -75,12 +87,98 @@ void fetchFrequency(unsigned length, float *samples, unsigned sampleRate, float&
 			lastV = v;
 		}
 
-		if (maxi != (unsigned)(-1) && maxV > 0.3f* fftData[0].Re)
+		if (maxi != (unsigned)(-1) && maxV > 0.3f* r0)
 		{
 			freq = (float)sampleRate / (float)maxi;
 		}
 	}
+}
 
-	delete[] fftData;
+/*
+Same detector as DetectFreqs()/fetchFrequency(), but
+ - the Hann window is a table instead of being re-evaluated for every frame
+ - the FFT uses a shared plan with precomputed twiddles
+ - two real frames are packed into one complex FFT (x + iy), their power spectra
+   are separated, then packed again (Px + iPy) so one inverse FFT gives both
+   autocorrelations. Every 2 frames cost 1 FFT + 1 IFFT instead of 2 + 2.
+*/
+#define FAST_HALF_WIN 1024
+#define FAST_FFT_LOG 12
+
+struct HannTable
+{
+	float data[FAST_HALF_WIN * 2];
+	HannTable()
+	{
+		float halfWidth = (float)FAST_HALF_WIN;
+		// same expression as Window::CreateFromBuffer, which drops the first sample
+		data[0] = 0.0f;
+		for (int i = -FAST_HALF_WIN + 1; i < FAST_HALF_WIN; i++)
+			data[i + FAST_HALF_WIN] = (cosf((float)i * (float)PI / halfWidth) + 1.0f)*0.5f;
+	}
+};
+
+static const float* Hann()
+{
+	static HannTable s_table;
+	return s_table.data;
+}
+
+static const FFTPlan& FastPlan()
+{
+	static FFTPlan s_plan(FAST_FFT_LOG);
+	return s_plan;
+}
+
+static void fillFrame(const float* samples, unsigned numSamples, int center, const float* hann, DComp* fftData, bool imag)
+{
+	for (int i = 0; i < FAST_HALF_WIN * 2; i++)
+	{
+		int srcIndex = center - FAST_HALF_WIN + i;
+		float v = (srcIndex >= 0 && srcIndex < (int)numSamples) ? samples[srcIndex] : 0.0f;
+		float w = hann[i] * v;
+		if (imag) fftData[i].Im = (double)w;
+		else fftData[i].Re = (double)w;
+	}
+}
+
+void detectFrequenciesFast(const float* samples, unsigned numSamples, unsigned sampleRate, unsigned step, unsigned begin, unsigned end, float* freqs, float* dyns)
+{
+	const float* hann = Hann();
+	const FFTPlan& plan = FastPlan();
+	unsigned len = plan.Size();
 
+	std::vector<DComp> fftData(len);
+	for (unsigned f = begin; f < end; f += 2)
+	{
+		bool pair = f + 1 < end;
+		memset(fftData.data(), 0, sizeof(DComp)*len);
+		fillFrame(samples, numSamples, (int)(f*step), hann, fftData.data(), false);
+		if (pair) fillFrame(samples, numSamples, (int)((f + 1)*step), hann, fftData.data(), true);
+
+		plan.Forward(fftData.data());
+
+		// separate the 2 power spectra, which are real and even, and pack them again
+		for (unsigned k = 0; k <= len / 2; k++)
+		{
+			unsigned nk = (len - k) & (len - 1);
+			DComp a = fftData[k];
+			DComp b = fftData[nk];
+			double xr = a.Re + b.Re;
+			double xi = a.Im - b.Im;
+			double yr = a.Im + b.Im;
+			double yi = a.Re - b.Re;
+			double px = (xr*xr + xi*xi)*0.25;
+			double py = (yr*yr + yi*yi)*0.25;
+			fftData[k].Re = px;
+			fftData[k].Im = py;
+			fftData[nk].Re = px;
+			fftData[nk].Im = py;
+		}
+
+		plan.Inverse(fftData.data());
+
+		pickFrequency(&fftData[0].Re, 2, len, sampleRate, freqs[f], dyns[f]);
+		if (pair) pickFrequency(&fftData[0].Im, 2, len, sampleRate, freqs[f + 1], dyns[f + 1]);
+	}
 }
@@ -2,5 +2,15 @@
 #define _FrequencyDetection_h
 
 void fetchFrequency(unsigned length, float *samples, unsigned sampleRate, float& freq, float& dyn);
+void pickFrequency(const double* r, unsigned stride, unsigned len, unsigned sampleRate, float& freq, float& dyn);
+
+enum FreqDetectMode
+{
+	FreqDetect_FFT, // one zero-padded FFT autocorrelation per frame
+	FreqDetect_Fast // same detector, 2 frames per FFT, cached window and FFT plan
+};
+
+// frames [begin, end) of a 2048 sample Hann window sliding by step, same results as fetchFrequency() on each frame
+void detectFrequenciesFast(const float* samples, unsigned numSamples, unsigned sampleRate, unsigned step, unsigned begin, unsigned end, float* freqs, float* dyns);
 
 #endif
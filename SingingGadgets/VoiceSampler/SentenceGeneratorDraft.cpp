@@ -0,0 +1,249 @@
+#include "SentenceDescriptor.h"
+#include "SentenceGeneratorGeneral.h"
+#include "SentenceGeneratorDraft.h"
+
+#include "VoiceUtil.h"
+using namespace VoiceUtil;
+
+static float rate = 44100.0f;
+
+inline void Clamp01(float& v)
+{
+	if (v < 0.0f) v = 0.0f;
+	else if (v > 1.0f) v = 1.0f;
+}
+
+/*
+Differences from GenerateSentenceCPU():
+ - Each source period is kept as a Hann-windowed grain of 2 periods, taken directly 
+   from the source. No spectral analysis, no voiced/unvoiced separation, no noise synthesis.
+ - Grains are overlap-added at the destination period without being repitched, 
+   so formants are kept the TD-PSOLA way. Grains are scaled by destPeriod/srcPeriod 
+   to keep the loudness when the overlap changes.
+Piece mapping, frequency smoothing, stretching and the volume map are the same, 
+so the result lines up sample by sample with the full quality render.
+*/
+void GenerateSentenceDraft(const SentenceDescriptor* desc, float* outBuf, unsigned outBufLen)
+{
+	struct Grain
+	{
+		Window win;
+		float m_pos;
+	};
+
+	typedef std::vector<Grain> GrainVec;
+	std::vector<GrainVec> GrainVecs;
+
+	const std::vector<Piece>& pieces = desc->pieces;
+
+	GrainVecs.resize(pieces.size());
+
+	for (size_t i = 0; i < pieces.size(); i++)
+	{
+		const Piece& piece = pieces[i];
+		GrainVec& grains = GrainVecs[i];
+
+		int srcStart = (int)(piece.srcMap[0].srcPos*0.001f*rate);
+		int srcEnd = (int)ceilf(piece.srcMap[piece.srcMap.size() - 1].srcPos*0.001f*rate);
+
+		float fPeriodCount = 0.0f;
+		unsigned i_srcMap = 0;
+
+		Buffer SrcBuffer;
+		SrcBuffer.m_sampleRate = (unsigned)rate;
+		RegulateSource(piece.src.wav.buf, piece.src.wav.len, SrcBuffer, srcStart, srcEnd);
+
+		for (int srcPos = srcStart; srcPos < srcEnd; srcPos++)
+		{
+			float fsrcPos = (float)srcPos / rate*1000.0f;
+			while (i_srcMap + 1 < piece.srcMap.size() && fsrcPos >= piece.srcMap[i_srcMap + 1].srcPos)
+				i_srcMap++;
+
+			float k_srcMap = (fsrcPos - piece.srcMap[i_srcMap].srcPos) / (piece.srcMap[i_srcMap + 1].srcPos - piece.srcMap[i_srcMap].srcPos);
+			Clamp01(k_srcMap);
+			float fdstPos = piece.srcMap[i_srcMap].dstPos*(1.0f - k_srcMap) + piece.srcMap[i_srcMap + 1].dstPos*k_srcMap;
+			float dstPos = fdstPos*0.001f*rate;
+
+			float srcFreqPos = (float)srcPos / (float)piece.src.frq.interval;
+			unsigned uSrcFreqPos = (unsigned)srcFreqPos;
+			float fracSrcFreqPos = srcFreqPos - (float)uSrcFreqPos;
+
+			float freq1 = (float)piece.src.frq.data[uSrcFreqPos].freq;
+			if (freq1 <= 55.0f) freq1 = (float)piece.src.frq.key;
+
+			float freq2 = (float)piece.src.frq.data[uSrcFreqPos + 1].freq;
+			if (freq2 <= 55.0f) freq2 = (float)piece.src.frq.key;
+
+			float srcSampleFreq = (freq1*(1.0f - fracSrcFreqPos) + freq2*fracSrcFreqPos) / rate;
+
+			unsigned grainId = (unsigned)fPeriodCount;
+			if (grainId >= grains.size())
+			{
+				grains.push_back(Grain());
+				Grain& grain = grains.back();
+				grain.win.CreateFromBuffer(SrcBuffer, (float)(srcPos - srcStart), 1.0f / srcSampleFreq);
+				grain.m_pos = dstPos;
+			}
+
+			fPeriodCount += srcSampleFreq;
+		}
+	}
+
+	float* freqMap = new float[outBufLen];
+	std::vector<unsigned> bounds;
+
+	PreprocessFreqMap(desc, outBufLen, freqMap, bounds);
+
+	float phase = 0.0f;
+	unsigned i_pieceMap = 0;
+	unsigned i_volumeMap = 0;
+
+	const std::vector<GeneralCtrlPnt>& piece_map = desc->piece_map;
+	const std::vector<GeneralCtrlPnt>& volume_map = desc->volume_map;
+
+	// synthesis positions only move forward
+	std::vector<unsigned> grainCursors(pieces.size(), 0);
+
+	for (unsigned i = 0; i < (unsigned)bounds.size() - 1; i++)
+	{
+		float* pFreqMap = freqMap + bounds[i];
+		unsigned uSumLen = bounds[i + 1] - bounds[i];
+
+		float minSampleFreq = FLT_MAX;
+		for (unsigned pos = 0; pos < uSumLen; pos++)
+		{
+			float sampleFreq = pFreqMap[pos];
+			if (sampleFreq < minSampleFreq) minSampleFreq = sampleFreq;
+		}
+
+		float* stretchingMap;
+		stretchingMap = new float[uSumLen];
+
+		float pos_tmpBuf = 0.0f;
+		for (unsigned pos = 0; pos < uSumLen; pos++)
+		{
+			float sampleFreq;
+			sampleFreq = pFreqMap[pos];
+
+			float speed = sampleFreq / minSampleFreq;
+			pos_tmpBuf += speed;
+			stretchingMap[pos] = pos_tmpBuf;
+		}
+
+		float tempLen = stretchingMap[uSumLen - 1];
+		unsigned uTempLen = (unsigned)ceilf(tempLen);
+
+		Buffer tempBuf;
+		tempBuf.m_sampleRate = (unsigned)rate;
+		tempBuf.Allocate(uTempLen);
+
+		float tempHalfWinLen = 1.0f / minSampleFreq;
+		unsigned pos_local = 0;
+
+		while (phase > -1.0f) phase -= 1.0f;
+
+		float fTmpWinCenter;
+		for (fTmpWinCenter = phase*tempHalfWinLen; fTmpWinCenter - tempHalfWinLen <= tempLen; fTmpWinCenter += tempHalfWinLen)
+		{
+			while (fTmpWinCenter > stretchingMap[pos_local] && pos_local < uSumLen - 1) pos_local++;
+			unsigned pos_global = pos_local + bounds[i];
+			float f_pos_global = (float)pos_global / rate*1000.0f;
+
+			while (i_pieceMap + 1 < piece_map.size() && f_pos_global >= piece_map[i_pieceMap + 1].dstPos)
+				i_pieceMap++;
+
+			float k_piece = (f_pos_global - piece_map[i_pieceMap].dstPos) / (piece_map[i_pieceMap + 1].dstPos - piece_map[i_pieceMap].dstPos);
+			Clamp01(k_piece);
+			float fPieceId = piece_map[i_pieceMap].value* (1.0f - k_piece) + piece_map[i_pieceMap + 1].value*k_piece;
+
+			unsigned pieceId0 = (unsigned)fPieceId;
+			float pieceId_frac = fPieceId - (float)pieceId0;
+			unsigned pieceId1 = (unsigned)fPieceId + 1;
+			if (pieceId0 >= (unsigned)pieces.size()) pieceId0 = (unsigned)pieces.size() - 1;
+			if (pieceId_frac == 0.0f || pieceId1 >= (unsigned)pieces.size())
+			{
+				pieceId1 = pieceId0;
+				pieceId_frac = 0.0f;
+			}
+
+			float destHalfWinLen = 1.0f / pFreqMap[pos_local];
+			// the temp buffer is compressed by tempHalfWinLen/destHalfWinLen afterwards
+			float stretch = tempHalfWinLen / destHalfWinLen;
+
+			unsigned pieceIds[2] = { pieceId0, pieceId1 };
+			float weights[2] = { 1.0f - pieceId_frac, pieceId_frac };
+			unsigned numPieces = pieceId1 > pieceId0 ? 2 : 1;
+
+			for (unsigned j = 0; j < numPieces; j++)
+			{
+				const GrainVec& grains = GrainVecs[pieceIds[j]];
+				if (grains.size() < 1 || weights[j] <= 0.0f) continue;
+
+				// nearest grain
+				unsigned& grainId0 = grainCursors[pieceIds[j]];
+				while (grainId0 + 1 < grains.size() && grains[grainId0 + 1].m_pos < (float)pos_global)
+					grainId0++;
+				unsigned grainId = grainId0;
+				if (grainId0 + 1 < grains.size() &&
+					(float)pos_global - grains[grainId0].m_pos > grains[grainId0 + 1].m_pos - (float)pos_global)
+					grainId = grainId0 + 1;
+
+				const Window& win = grains[grainId].win;
+				float gain = weights[j] * destHalfWinLen / win.m_halfWidth;
+
+				int u_halfWidth = (int)win.GetHalfWidthOfData();
+				float halfWidthTmp = (float)u_halfWidth*stretch;
+				int ipos1 = (int)ceilf(fTmpWinCenter - halfWidthTmp);
+				int ipos2 = (int)floorf(fTmpWinCenter + halfWidthTmp);
+				if (ipos1 < 0) ipos1 = 0;
+				if (ipos2 >= (int)uTempLen) ipos2 = (int)uTempLen - 1;
+				float invStretch = 1.0f / stretch;
+				for (int ipos = ipos1; ipos <= ipos2; ipos++)
+				{
+					float srcPos = ((float)ipos - fTmpWinCenter)*invStretch;
+					int isrc = (int)floorf(srcPos);
+					float frac = srcPos - (float)isrc;
+					float v = win.GetSample(isrc)*(1.0f - frac) + win.GetSample(isrc + 1)*frac;
+					tempBuf.m_data[ipos] += v*gain;
+				}
+			}
+		}
+		phase = (fTmpWinCenter - tempLen) / tempHalfWinLen;
+
+		for (unsigned pos = 0; pos < uSumLen; pos++)
+		{
+			unsigned pos_global = pos + bounds[i];
+			float f_pos_global = (float)pos_global / rate*1000.0f;
+			while (i_volumeMap + 1 < volume_map.size() && f_pos_global >= volume_map[i_volumeMap + 1].dstPos)
+				i_volumeMap++;
+			float k_volume = (f_pos_global - volume_map[i_volumeMap].dstPos) / (volume_map[i_volumeMap + 1].dstPos - volume_map[i_volumeMap].dstPos);
+			Clamp01(k_volume);
+			float volume = volume_map[i_volumeMap].value* (1.0f - k_volume) + volume_map[i_volumeMap + 1].value*k_volume;
+
+			float pos_tmpBuf = stretchingMap[pos];
+			float sampleFreq;
+			sampleFreq = pFreqMap[pos];
+
+			float speed = sampleFreq / minSampleFreq;
+
+			int ipos1 = (int)ceilf(pos_tmpBuf - speed*0.5f);
+			int ipos2 = (int)floorf(pos_tmpBuf + speed*0.5f);
+
+			if (ipos1 >= (int)uTempLen) ipos1 = (int)uTempLen - 1;
+			if (ipos2 >= (int)uTempLen) ipos2 = (int)uTempLen - 1;
+
+			float sum = 0.0f;
+			for (int ipos = ipos1; ipos <= ipos2; ipos++)
+			{
+				sum += tempBuf.GetSample(ipos);
+			}
+			float value = sum / (float)(ipos2 - ipos1 + 1);
+			outBuf[pos + bounds[i]] = value*volume;
+		}
+
+		delete[] stretchingMap;
+	}
+
+	delete[] freqMap;
+
+}
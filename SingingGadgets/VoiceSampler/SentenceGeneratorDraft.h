@@ -0,0 +1,9 @@
+#ifndef __SentenceGeneratorDraft_h
+#define __SentenceGeneratorDraft_h
+
+struct SentenceDescriptor;
+
+// Preview quality: TD-PSOLA over the same descriptor, same timing and alignment as GenerateSentenceCPU
+void GenerateSentenceDraft(const SentenceDescriptor* desc, float* outBuf, unsigned outBufLen);
+
+#endif
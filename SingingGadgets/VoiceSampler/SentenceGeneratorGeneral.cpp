@@ -42,6 +42,13 @@ static void _floatBufSmooth(float* buf, unsigned size)
 	float *buf2 = new float[size];
 	memset(buf2, 0, sizeof(float)*size);
 
+	float *window = new float[winSize];
+	for (int j = -(int)halfWinSize; j < (int)halfWinSize; j++)
+	{
+		float x = (float)j / (float)halfWinSize*(float)PI;
+		window[j + halfWinSize] = (cosf(x) + 1.0f)*0.5f;
+	}
+
 	for (unsigned i = 0; i < size + halfWinSize; i += halfWinSize)
 	{
 		float sum = 0.0f;
@@ -53,8 +60,7 @@ static void _floatBufSmooth(float* buf, unsigned size)
 			else if (bufPos >= (int)size) v = buf[size - 1];
 			else v = buf[bufPos];
 
-			float x = (float)j / (float)halfWinSize*(float)PI;
-			float w = (cosf(x) + 1.0f)*0.5f;
+			float w = window[j + halfWinSize];
 
 			sum += v*w;
 		}
@@ -64,8 +70,7 @@ static void _floatBufSmooth(float* buf, unsigned size)
 			int bufPos = (int)i + j;
 			if (bufPos < 0 || bufPos >= (int)size) continue;
 
-			float x = (float)j / (float)halfWinSize*(float)PI;
-			float w = (cosf(x) + 1.0f)*0.5f;
+			float w = window[j + halfWinSize];
 
 			buf2[bufPos] += w*ave;
 		}
@@ -73,6 +78,7 @@ static void _floatBufSmooth(float* buf, unsigned size)
 
 	memcpy(buf, buf2, sizeof(float)*size);
 	delete[] buf2;
+	delete[] window;
 }
 
 void PreprocessFreqMap(const SentenceDescriptor* desc, unsigned outBufLen, float* freqMap, std::vector<unsigned>& bounds)
@@ -2,12 +2,19 @@
 #include <WavBuf.h>
 #include "SentenceDescriptor.h"
 #include "SentenceGeneratorCPU.h"
+#include "SentenceGeneratorDraft.h"
 #ifdef HAVE_CUDA
 #include "SentenceGeneratorCUDA.h"
 #include <cuda_runtime.h>
 #endif
 #include <math.h>
 
+#include <cstdio>
+#include <string>
+#include "MappedFile.h"
+#include "WavFile.h"
+#include "ParallelFor.h"
+
 #include "VoiceUtil.h"
 #include "FrequencyDetection.h"
 using namespace VoiceUtil;
@@ -59,15 +66,32 @@ static SentenceDescriptor_Deferred CreateSentenceDescriptor(PyObject *input)
 			frq.key = PyFloat_AsDouble(PyDict_GetItemString(o_frq, "key"));
 
 			PyObject* o_data = PyDict_GetItemString(o_frq, "data");
-			ssize_t num_datapnts = PyList_Size(o_data);
 			std::vector<FrqDataPoint>& data = frq.data;
-			for (ssize_t j = 0; j < num_datapnts; j++)
+			if (PyBytes_Check(o_data))
+			{
+				// packed (freq, dyn) float64 pairs, as returned by the voicebank index
+				char* p_data; ssize_t len_data;
+				PyBytes_AsStringAndSize(o_data, &p_data, &len_data);
+				ssize_t num_datapnts = len_data / (ssize_t)(sizeof(double) * 2);
+				data.resize(num_datapnts);
+				const double* p_pnts = (const double*)p_data;
+				for (ssize_t j = 0; j < num_datapnts; j++)
+				{
+					data[j].freq = p_pnts[j * 2];
+					data[j].dyn = p_pnts[j * 2 + 1];
+				}
+			}
+			else
 			{
-				FrqDataPoint datapnt;
-				PyObject* o_datapnt = PyList_GetItem(o_data, j);
-				datapnt.freq = PyFloat_AsDouble(PyTuple_GetItem(o_datapnt, 0));
-				datapnt.dyn = PyFloat_AsDouble(PyTuple_GetItem(o_datapnt, 1));
-				data.push_back(datapnt);
+				ssize_t num_datapnts = PyList_Size(o_data);
+				for (ssize_t j = 0; j < num_datapnts; j++)
+				{
+					FrqDataPoint datapnt;
+					PyObject* o_datapnt = PyList_GetItem(o_data, j);
+					datapnt.freq = PyFloat_AsDouble(PyTuple_GetItem(o_datapnt, 0));
+					datapnt.dyn = PyFloat_AsDouble(PyTuple_GetItem(o_datapnt, 1));
+					data.push_back(datapnt);
+				}
 			}
 		}		
 
@@ -132,7 +156,14 @@ static SentenceDescriptor_Deferred CreateSentenceDescriptor(PyObject *input)
 	return sentence;
 }
 
-static PyObject* GenerateSentenceX(PyObject *self, PyObject *args, bool cuda)
+enum SentenceGenerator
+{
+	Generator_CPU,
+	Generator_CUDA,
+	Generator_Draft
+};
+
+static PyObject* GenerateSentenceX(PyObject *self, PyObject *args, SentenceGenerator generator)
 {
 	SentenceDescriptor_Deferred sentence =
 		CreateSentenceDescriptor(PyTuple_GetItem(args, 0));
@@ -176,8 +207,11 @@ static PyObject* GenerateSentenceX(PyObject *self, PyObject *args, bool cuda)
 	float* ptr;
 	res.GetDataPtrAndLen(ptr, len);	
 
+	if (generator == Generator_Draft)
+		GenerateSentenceDraft(sentence, ptr, (unsigned)len);
+	else
 #ifdef HAVE_CUDA
-	if (cuda && HaveCUDA())
+	if (generator == Generator_CUDA && HaveCUDA())
 		GenerateSentenceCUDA(sentence, ptr, (unsigned)len);
 	else
 #endif
@@ -188,12 +222,17 @@ static PyObject* GenerateSentenceX(PyObject *self, PyObject *args, bool cuda)
 
 static PyObject* GenerateSentence(PyObject *self, PyObject *args)
 {
-	return GenerateSentenceX(self, args, false);
+	return GenerateSentenceX(self, args, Generator_CPU);
 }
 
 static PyObject* GenerateSentenceCUDA(PyObject *self, PyObject *args)
 {
-	return GenerateSentenceX(self, args, true);
+	return GenerateSentenceX(self, args, Generator_CUDA);
+}
+
+static PyObject* GenerateSentenceDraft(PyObject *self, PyObject *args)
+{
+	return GenerateSentenceX(self, args, Generator_Draft);
 }
 
 static PyObject* HaveCUDA(PyObject *self, PyObject *args)
@@ -201,29 +240,76 @@ static PyObject* HaveCUDA(PyObject *self, PyObject *args)
 	return HaveCUDA() ? Py_True : Py_False;
 }
 
-void DetectFreqs(const Buffer& buf, std::vector<float>& frequencies, std::vector<float>& dynamics, unsigned step)
+static unsigned NumFreqFrames(const Buffer& buf, unsigned step)
+{
+	return ((unsigned)buf.m_data.size() + step - 1) / step;
+}
+
+static void DetectFreqFrames(const Buffer& buf, unsigned step, unsigned begin, unsigned end, float* frequencies, float* dynamics, FreqDetectMode mode)
 {
+	if (mode == FreqDetect_Fast)
+	{
+		detectFrequenciesFast(buf.m_data.data(), (unsigned)buf.m_data.size(), buf.m_sampleRate, step, begin, end, frequencies, dynamics);
+		return;
+	}
+
 	unsigned halfWinLen = 1024;
 	float* temp = new float[halfWinLen * 2];
 
-	for (unsigned center = 0; center < buf.m_data.size(); center += step)
+	Window win;
+	for (unsigned i = begin; i < end; i++)
 	{
-		Window win;
-		win.CreateFromBuffer(buf, (float)center, (float)halfWinLen);
-
-		for (int i = -(int)halfWinLen; i < (int)halfWinLen; i++)
-			temp[i + halfWinLen] = win.GetSample(i);
+		win.CreateFromBuffer(buf, (float)(i*step), (float)halfWinLen);
 
-		float freq;
-		float dyn;
-		fetchFrequency(halfWinLen * 2, temp, buf.m_sampleRate, freq, dyn);
+		for (int j = -(int)halfWinLen; j < (int)halfWinLen; j++)
+			temp[j + halfWinLen] = win.GetSample(j);
 
-		frequencies.push_back(freq);
-		dynamics.push_back(dyn);
+		fetchFrequency(halfWinLen * 2, temp, buf.m_sampleRate, frequencies[i], dynamics[i]);
 	}
 
 	delete[] temp;
+}
+
+void DetectFreqs(const Buffer& buf, std::vector<float>& frequencies, std::vector<float>& dynamics, unsigned step, FreqDetectMode mode = FreqDetect_FFT)
+{
+	unsigned numFrames = NumFreqFrames(buf, step);
+	frequencies.resize(numFrames);
+	dynamics.resize(numFrames);
+	DetectFreqFrames(buf, step, 0, numFrames, frequencies.data(), dynamics.data(), mode);
+}
 
+// "fft": legacy detector, "fast": batched detector, see detectFrequenciesFast()
+static bool ParseFreqDetectMode(PyObject* args, ssize_t pos, FreqDetectMode defaultMode, FreqDetectMode& mode)
+{
+	mode = defaultMode;
+	if (PyTuple_Size(args) <= pos) return true;
+	PyObject* o_mode = PyTuple_GetItem(args, pos);
+	if (o_mode == Py_None) return true;
+	const char* s_mode = PyUnicode_AsUTF8(o_mode);
+	if (s_mode == nullptr) return false;
+	if (strcmp(s_mode, "fft") == 0) mode = FreqDetect_FFT;
+	else if (strcmp(s_mode, "fast") == 0) mode = FreqDetect_Fast;
+	else
+	{
+		PyErr_Format(PyExc_ValueError, "unknown frequency detection mode: %s", s_mode);
+		return false;
+	}
+	return true;
+}
+
+static float AverageFreq(const std::vector<float>& frequencies)
+{
+	float ave = 0.0f;
+	float count = 0.0f;
+	for (unsigned i = 0; i < (unsigned)frequencies.size(); i++)
+	{
+		if (frequencies[i] > 55.0f)
+		{
+			count += 1.0f;
+			ave += frequencies[i];
+		}
+	}
+	return ave / count;
 }
 
 static PyObject* DetectFrq(PyObject *self, PyObject *args)
@@ -238,6 +324,9 @@ static PyObject* DetectFrq(PyObject *self, PyObject *args)
 
 	int interval = (int)PyLong_AsLong(PyTuple_GetItem(args, 1));
 
+	FreqDetectMode mode;
+	if (!ParseFreqDetectMode(args, 2, FreqDetect_FFT, mode)) return NULL;
+
 	Buffer buf;
 	buf.m_sampleRate = 44100;
 	buf.Allocate(len);
@@ -245,19 +334,9 @@ static PyObject* DetectFrq(PyObject *self, PyObject *args)
 
 	std::vector<float> frequencies;
 	std::vector<float> dynamics;
-	DetectFreqs(buf, frequencies, dynamics, interval);
+	DetectFreqs(buf, frequencies, dynamics, interval, mode);
 
-	float ave = 0.0f;
-	float count = 0.0f;
-	for (unsigned i = 0; i < (unsigned)frequencies.size(); i++)
-	{
-		if (frequencies[i] > 55.0f)
-		{
-			count += 1.0f;
-			ave += frequencies[i];
-		}
-	}
-	ave = ave / count;
+	float ave = AverageFreq(frequencies);
 
 	PyObject *ret = PyDict_New();
 	PyDict_SetItemString(ret, "interval", PyLong_FromLong((long)interval));
@@ -276,6 +355,218 @@ static PyObject* DetectFrq(PyObject *self, PyObject *args)
 	return ret;
 }
 
+struct FrqJob
+{
+	std::string wavPath;
+	std::string frqPath;
+	bool ok;
+	Buffer buf;
+	std::vector<float> frequencies;
+	std::vector<float> dynamics;
+	float key;
+	bool written;
+};
+
+static bool LoadWavF32(const std::string& path, Buffer& buf)
+{
+	MappedFile file;
+	if (!file.Open(path.c_str())) return false;
+	WavFileInfo info;
+	if (!ParseWavFile(file.Data(), file.Size(), info)) return false;
+	buf.m_sampleRate = info.sampleRate;
+	buf.m_data.resize(info.numFrames*info.numChannels);
+	return WavFileToF32(info, buf.m_data.data());
+}
+
+// UTAU .frq layout: "FREQ0003", samples per point, average frequency, 16 bytes unused, count, (freq, amp) pairs
+static bool WriteFrqFile(const std::string& path, int interval, float key, const std::vector<float>& frequencies, const std::vector<float>& dynamics)
+{
+	// written aside then renamed, a truncated file would be taken for a valid one by the voicebank index
+	std::string tmpPath = path + ".tmp";
+	FILE* fp = fopen(tmpPath.c_str(), "wb");
+	if (!fp) return false;
+
+	unsigned char header[40];
+	memset(header, 0, sizeof(header));
+	memcpy(header, "FREQ0003", 8);
+	int32_t i_interval = interval;
+	double d_key = (double)key;
+	int32_t count = (int32_t)frequencies.size();
+	memcpy(header + 8, &i_interval, 4);
+	memcpy(header + 12, &d_key, 8);
+	memcpy(header + 36, &count, 4);
+	bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+
+	std::vector<double> data(frequencies.size() * 2);
+	for (size_t i = 0; i < frequencies.size(); i++)
+	{
+		data[i * 2] = (double)frequencies[i];
+		data[i * 2 + 1] = (double)dynamics[i];
+	}
+	ok = fwrite(data.data(), sizeof(double), data.size(), fp) == data.size() && ok;
+	ok = fclose(fp) == 0 && ok;
+#ifdef _WIN32
+	if (ok) remove(path.c_str());
+#endif
+	if (ok && rename(tmpPath.c_str(), path.c_str()) == 0) return true;
+	remove(tmpPath.c_str());
+	return false;
+}
+
+static std::string FSPath(PyObject* o_path)
+{
+	std::string ret;
+	PyObject* bytes = PyUnicode_EncodeFSDefault(o_path);
+	if (bytes == nullptr)
+	{
+		PyErr_Clear();
+		return ret;
+	}
+	ret = std::string(PyBytes_AsString(bytes), (size_t)PyBytes_Size(bytes));
+	Py_DECREF(bytes);
+	return ret;
+}
+
+/*
+DetectFrqBatch(paths, interval, threads, write, returnData, mode="fast")
+paths: list of wav file names, or of (wav file name, frq file name) tuples. 
+       By default the frq file name is the UTAU one: xxx.wav -> xxx_wav.frq
+Files are processed in groups. Within a group, frames of all files are split into 
+small chunks and processed by the worker threads, so long files are also parallelized.
+Returns a list with one item per file: None if the wav cannot be read, otherwise 
+{interval, key, data}. data is packed (freq, dyn) float64 pairs when returnData is true, 
+None otherwise.
+*/
+static PyObject* DetectFrqBatch(PyObject *self, PyObject *args)
+{
+	PyObject* o_paths = PyTuple_GetItem(args, 0);
+	int interval = (int)PyLong_AsLong(PyTuple_GetItem(args, 1));
+	unsigned numThreads = (unsigned)PyLong_AsLong(PyTuple_GetItem(args, 2));
+	bool write = PyObject_IsTrue(PyTuple_GetItem(args, 3)) != 0;
+	bool returnData = PyObject_IsTrue(PyTuple_GetItem(args, 4)) != 0;
+	FreqDetectMode mode;
+	if (!ParseFreqDetectMode(args, 5, FreqDetect_Fast, mode)) return NULL;
+	if (interval <= 0)
+	{
+		PyErr_SetString(PyExc_ValueError, "interval must be positive");
+		return NULL;
+	}
+	if (numThreads == 0) numThreads = DefaultNumThreads();
+
+	ssize_t numFiles = PyList_Size(o_paths);
+	PyObject* ret = PyList_New(numFiles);
+
+	const unsigned chunkSize = 64;
+	unsigned groupSize = numThreads * 4;
+	for (ssize_t groupStart = 0; groupStart < numFiles; groupStart += groupSize)
+	{
+		unsigned count = (unsigned)min((ssize_t)groupSize, numFiles - groupStart);
+		std::vector<FrqJob> jobs(count);
+		for (unsigned i = 0; i < count; i++)
+		{
+			PyObject* o_item = PyList_GetItem(o_paths, groupStart + i);
+			FrqJob& job = jobs[i];
+			if (PyTuple_Check(o_item))
+			{
+				job.wavPath = FSPath(PyTuple_GetItem(o_item, 0));
+				job.frqPath = FSPath(PyTuple_GetItem(o_item, 1));
+			}
+			else
+			{
+				job.wavPath = FSPath(o_item);
+				if (job.wavPath.size() >= 4)
+					job.frqPath = job.wavPath.substr(0, job.wavPath.size() - 4) + "_wav.frq";
+			}
+		}
+
+		Py_BEGIN_ALLOW_THREADS
+
+		ParallelFor(count, numThreads, [&](unsigned i)
+		{
+			FrqJob& job = jobs[i];
+			job.ok = LoadWavF32(job.wavPath, job.buf);
+			if (job.ok)
+			{
+				unsigned numFrames = NumFreqFrames(job.buf, interval);
+				job.frequencies.resize(numFrames);
+				job.dynamics.resize(numFrames);
+			}
+		});
+
+		std::vector<std::pair<unsigned, unsigned> > chunks;
+		for (unsigned i = 0; i < count; i++)
+		{
+			if (!jobs[i].ok) continue;
+			unsigned numFrames = (unsigned)jobs[i].frequencies.size();
+			for (unsigned j = 0; j < numFrames; j += chunkSize)
+				chunks.push_back(std::pair<unsigned, unsigned>(i, j));
+		}
+
+		ParallelFor((unsigned)chunks.size(), numThreads, [&](unsigned i)
+		{
+			FrqJob& job = jobs[chunks[i].first];
+			unsigned begin = chunks[i].second;
+			unsigned end = min(begin + chunkSize, (unsigned)job.frequencies.size());
+			DetectFreqFrames(job.buf, interval, begin, end, job.frequencies.data(), job.dynamics.data(), mode);
+		});
+
+		ParallelFor(count, numThreads, [&](unsigned i)
+		{
+			FrqJob& job = jobs[i];
+			if (!job.ok) return;
+			job.key = AverageFreq(job.frequencies);
+			job.written = write && WriteFrqFile(job.frqPath, interval, job.key, job.frequencies, job.dynamics);
+			std::vector<float>().swap(job.buf.m_data);
+		});
+
+		Py_END_ALLOW_THREADS
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			FrqJob& job = jobs[i];
+			if (!job.ok)
+			{
+				Py_INCREF(Py_None);
+				PyList_SetItem(ret, groupStart + i, Py_None);
+				continue;
+			}
+			PyObject* item = PyDict_New();
+			PyDict_SetItemString(item, "interval", PyLong_FromLong((long)interval));
+			PyDict_SetItemString(item, "key", PyFloat_FromDouble((double)job.key));
+			if (write && !job.written)
+			{
+				PyObject* error = PyUnicode_FromFormat("failed to write %s", job.frqPath.c_str());
+				PyDict_SetItemString(item, "error", error);
+				Py_DECREF(error);
+			}
+			else
+			{
+				PyDict_SetItemString(item, "error", Py_None);
+			}
+			if (returnData)
+			{
+				size_t numFrames = job.frequencies.size();
+				PyObject* data = PyBytes_FromStringAndSize(nullptr, (ssize_t)(sizeof(double) * 2 * numFrames));
+				double* p_data = (double*)PyBytes_AsString(data);
+				for (size_t j = 0; j < numFrames; j++)
+				{
+					p_data[j * 2] = (double)job.frequencies[j];
+					p_data[j * 2 + 1] = (double)job.dynamics[j];
+				}
+				PyDict_SetItemString(item, "data", data);
+				Py_DECREF(data);
+			}
+			else
+			{
+				PyDict_SetItemString(item, "data", Py_None);
+			}
+			PyList_SetItem(ret, groupStart + i, item);
+		}
+	}
+
+	return ret;
+}
+
 static PyMethodDef s_Methods[] = {
 	{
 		"GenerateSentence",
@@ -289,6 +580,12 @@ static PyMethodDef s_Methods[] = {
 		METH_VARARGS,
 		""
 	},
+	{
+		"GenerateSentenceDraft",
+		GenerateSentenceDraft,
+		METH_VARARGS,
+		""
+	},
 	{
 		"HaveCUDA",
 		HaveCUDA,
@@ -301,6 +598,12 @@ static PyMethodDef s_Methods[] = {
 		METH_VARARGS,
 		""
 	},
+	{
+		"DetectFrqBatch",
+		DetectFrqBatch,
+		METH_VARARGS,
+		""
+	},
 	{ NULL, NULL, 0, NULL }
 };
 
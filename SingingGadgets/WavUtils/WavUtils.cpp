@@ -1,68 +1,67 @@
 #include <Python.h>
+#include <string.h>
+#include <vector>
+#include "WavKernels.h"
+#include "MappedFile.h"
+#include "WavFile.h"
 
-
-static PyObject* S16ToF32(PyObject *self, PyObject *args)
+// Read-only view of an object exporting a contiguous buffer: bytes, bytearray,
+// memoryview, array.array or numpy arrays.
+class BufferView
 {
-	char* p;
+public:
+	BufferView(PyObject* obj)
+	{
+		m_ok = PyObject_GetBuffer(obj, &m_view, PyBUF_SIMPLE) == 0;
+	}
+	~BufferView()
+	{
+		if (m_ok) PyBuffer_Release(&m_view);
+	}
 
-	PyObject* o_s16bytes = PyTuple_GetItem(args, 0);
-	ssize_t len;
-	PyBytes_AsStringAndSize(o_s16bytes, &p, &len);
-	len /= sizeof(short);
-	short* s16bytes = (short*)p;
+	bool Ok() const { return m_ok; }
+	const void* Data() const { return m_view.buf; }
+	size_t Size() const { return (size_t)m_view.len; }
 
-	PyObject* o_f32bytes = PyBytes_FromStringAndSize(nullptr, len*sizeof(float));
-	PyBytes_AsStringAndSize(o_f32bytes, &p, &len);
-	len /= sizeof(float);
-	float* f32bytes = (float*)p;
+private:
+	BufferView(const BufferView&);
+	void operator=(const BufferView&);
 
-	for (ssize_t i = 0; i < len; i++)
-		f32bytes[i] = (float)s16bytes[i] / 32767.0f;
+	Py_buffer m_view;
+	bool m_ok;
+};
 
+static PyObject* S16ToF32(PyObject *self, PyObject *args)
+{
+	BufferView s16(PyTuple_GetItem(args, 0));
+	if (!s16.Ok()) return NULL;
+	size_t len = s16.Size() / sizeof(short);
+
+	PyObject* o_f32bytes = PyBytes_FromStringAndSize(nullptr, len*sizeof(float));
+	ConvertS16ToF32((const int16_t*)s16.Data(), (float*)PyBytes_AsString(o_f32bytes), len);
 	return o_f32bytes;
 }
 
+// values out of the 16-bit range are saturated
 static PyObject* F32ToS16(PyObject *self, PyObject *args)
 {
-	char* p;
-
-	PyObject* o_f32bytes = PyTuple_GetItem(args, 0);
-	ssize_t len;
-	PyBytes_AsStringAndSize(o_f32bytes, &p, &len);
-	len /= sizeof(float);
-	float* f32bytes = (float*)p;
+	BufferView f32(PyTuple_GetItem(args, 0));
+	if (!f32.Ok()) return NULL;
+	size_t len = f32.Size() / sizeof(float);
 
 	float amplitude = (float)PyFloat_AsDouble(PyTuple_GetItem(args, 1));
+	if (PyErr_Occurred()) return NULL;
 
 	PyObject* o_s16bytes = PyBytes_FromStringAndSize(nullptr, len*sizeof(short));
-	PyBytes_AsStringAndSize(o_s16bytes, &p, &len);
-	len /= sizeof(short);
-	short* s16bytes = (short*)p;
-
-	for (ssize_t i = 0; i < len; i++)
-		s16bytes[i] = (short)(f32bytes[i] * 32767.0f*amplitude + 0.5f);
-
+	ConvertF32ToS16((const float*)f32.Data(), (int16_t*)PyBytes_AsString(o_s16bytes), len, amplitude);
 	return o_s16bytes;
 }
 
 static PyObject* MaxValueF32(PyObject *self, PyObject *args)
 {
-	char* p;
-
-	PyObject* o_f32bytes = PyTuple_GetItem(args, 0);
-	ssize_t len;
-	PyBytes_AsStringAndSize(o_f32bytes, &p, &len);
-	len /= sizeof(float);
-	float* f32bytes = (float*)p;
-
-	float maxV = 0.0f;
-	for (ssize_t i = 0; i < len; i++)
-	{
-		float v = fabsf(f32bytes[i]);
-		if (v > maxV) maxV = v;
-	}
-
-	return PyFloat_FromDouble((double)maxV);
+	BufferView f32(PyTuple_GetItem(args, 0));
+	if (!f32.Ok()) return NULL;
+	return PyFloat_FromDouble((double)MaxAbsF32((const float*)f32.Data(), f32.Size() / sizeof(float)));
 }
 
 static PyObject* ZeroBuf(PyObject *self, PyObject *args)
@@ -78,42 +77,203 @@ static PyObject* ZeroBuf(PyObject *self, PyObject *args)
 
 static PyObject* MixF32(PyObject *self, PyObject *args)
 {
-	PyObject* list = PyTuple_GetItem(args, 0);
-	unsigned numBufs = (unsigned)PyList_Size(list);
-	unsigned maxLen = 0;
-	for (unsigned i = 0; i < numBufs; i++)
-	{
-		PyObject* o_f32bytes = PyList_GetItem(list, i);
-		ssize_t len = PyBytes_Size(o_f32bytes);
-		len /= sizeof(float);
+	PyObject* list = PySequence_Fast(PyTuple_GetItem(args, 0), "MixF32 expects a sequence of buffers");
+	if (list == nullptr) return NULL;
 
-		if (maxLen < len)
-			maxLen = (unsigned)len;
+	ssize_t numBufs = PySequence_Fast_GET_SIZE(list);
+	std::vector<BufferView*> views;
+	size_t maxLen = 0;
+	bool ok = true;
+	for (ssize_t i = 0; i < numBufs; i++)
+	{
+		BufferView* view = new BufferView(PySequence_Fast_GET_ITEM(list, i));
+		if (!view->Ok())
+		{
+			delete view;
+			ok = false;
+			break;
+		}
+		views.push_back(view);
+		size_t len = view->Size() / sizeof(float);
+		if (maxLen < len) maxLen = len;
 	}
-	char* pOut;
-	PyObject* outBuf = PyBytes_FromStringAndSize(nullptr, maxLen*sizeof(float));
-	ssize_t outlen;
-	PyBytes_AsStringAndSize(outBuf, &pOut, &outlen);
-	outlen /= sizeof(float);
-	float* f32Out = (float*)pOut;
-	memset(f32Out, 0, maxLen*sizeof(float));
-
-	for (unsigned i = 0; i < numBufs; i++)
-	{
-		char* p;
-		PyObject* o_f32bytes = PyList_GetItem(list, i);
-		ssize_t len;
-		PyBytes_AsStringAndSize(o_f32bytes, &p, &len);
-		len /= sizeof(float);
-		float* f32bytes = (float*)p;
-
-		for (unsigned j = 0; j < len; j++)
-			f32Out[j] += f32bytes[j];
+
+	PyObject* outBuf = nullptr;
+	if (ok)
+	{
+		outBuf = PyBytes_FromStringAndSize(nullptr, maxLen*sizeof(float));
+		float* f32Out = (float*)PyBytes_AsString(outBuf);
+		memset(f32Out, 0, maxLen*sizeof(float));
+		for (size_t i = 0; i < views.size(); i++)
+			AccumulateF32(f32Out, (const float*)views[i]->Data(), views[i]->Size() / sizeof(float));
 	}
 
+	for (size_t i = 0; i < views.size(); i++)
+		delete views[i];
+	Py_DECREF(list);
 	return outBuf;
 }
 
+static bool s_GetChannels(PyObject* obj, unsigned& chn)
+{
+	long v = PyLong_AsLong(obj);
+	if (PyErr_Occurred()) return false;
+	if (v != 1 && v != 2)
+	{
+		PyErr_SetString(PyExc_ValueError, "number of channels must be 1 or 2");
+		return false;
+	}
+	chn = (unsigned)v;
+	return true;
+}
+
+/*
+(dst, dst_channels, [(buffer, gain, pan, offset, channels)...]) -> end frame of the furthest source
+Adds every source into dst in place, dst being any writable buffer of 'f' items (a
+float32 numpy array or array.array, or memoryview(bytearray).cast('f')). Trailing items of a source can be omitted: gain 1, pan 0, offset 0 and
+the channels of dst. offset is in frames of dst and may be negative, sources are clipped
+to dst, the returned end frame is not.
+*/
+static PyObject* MixF32Into(PyObject *self, PyObject *args)
+{
+	Py_buffer dstView;
+	if (PyObject_GetBuffer(PyTuple_GetItem(args, 0), &dstView, PyBUF_WRITABLE | PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0) return NULL;
+	const char* format = dstView.format != nullptr ? dstView.format : "B";
+	if (format[0] == '@' || format[0] == '=') format++;
+	if (strcmp(format, "f") != 0 || dstView.itemsize != sizeof(float))
+	{
+		PyBuffer_Release(&dstView);
+		PyErr_SetString(PyExc_TypeError, "MixF32Into expects a float32 ('f') destination buffer");
+		return NULL;
+	}
+
+	struct Source
+	{
+		BufferView* view;
+		float gain;
+		float pan;
+		long long offset;
+		unsigned chn;
+	};
+	std::vector<Source> sources;
+	long long maxEnd = 0;
+
+	unsigned dstChn = 0;
+	PyObject* list = nullptr;
+	bool ok = s_GetChannels(PyTuple_GetItem(args, 1), dstChn);
+	if (ok)
+	{
+		list = PySequence_Fast(PyTuple_GetItem(args, 2), "MixF32Into expects a sequence of sources");
+		ok = list != nullptr;
+	}
+	for (ssize_t i = 0; ok && i < PySequence_Fast_GET_SIZE(list); i++)
+	{
+		PyObject* item = PySequence_Fast_GET_ITEM(list, i);
+		PyObject* tuple = PySequence_Fast(item, "a source is a tuple (buffer, gain, pan, offset, channels)");
+		if (tuple == nullptr)
+		{
+			ok = false;
+			break;
+		}
+		ssize_t n = PySequence_Fast_GET_SIZE(tuple);
+		Source src;
+		src.view = nullptr;
+		src.gain = n > 1 ? (float)PyFloat_AsDouble(PySequence_Fast_GET_ITEM(tuple, 1)) : 1.0f;
+		src.pan = n > 2 ? (float)PyFloat_AsDouble(PySequence_Fast_GET_ITEM(tuple, 2)) : 0.0f;
+		src.offset = n > 3 ? PyLong_AsLongLong(PySequence_Fast_GET_ITEM(tuple, 3)) : 0;
+		src.chn = dstChn;
+		ok = n > 0 && !PyErr_Occurred() && (n < 5 || s_GetChannels(PySequence_Fast_GET_ITEM(tuple, 4), src.chn));
+		if (ok)
+		{
+			src.view = new BufferView(PySequence_Fast_GET_ITEM(tuple, 0));
+			ok = src.view->Ok();
+			if (!ok) delete src.view;
+		}
+		else if (n == 0)
+			PyErr_SetString(PyExc_ValueError, "a source needs a buffer");
+		Py_DECREF(tuple);
+		if (!ok) break;
+
+		sources.push_back(src);
+		long long end = src.offset + (long long)(src.view->Size() / (sizeof(float)*src.chn));
+		if (end > maxEnd) maxEnd = end;
+	}
+
+	if (ok)
+	{
+		float* dst = (float*)dstView.buf;
+		long long dstFrames = (long long)(dstView.len / (ssize_t)(sizeof(float)*dstChn));
+		Py_BEGIN_ALLOW_THREADS
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			const Source& src = sources[i];
+			long long begin = src.offset > 0 ? src.offset : 0;
+			long long end = src.offset + (long long)(src.view->Size() / (sizeof(float)*src.chn));
+			if (end > dstFrames) end = dstFrames;
+			if (end <= begin) continue;
+			const float* p = (const float*)src.view->Data() + (begin - src.offset)*src.chn;
+			MixFramesF32(dst + begin*dstChn, dstChn, p, src.chn, (size_t)(end - begin), src.gain, src.pan);
+		}
+		Py_END_ALLOW_THREADS
+	}
+
+	for (size_t i = 0; i < sources.size(); i++)
+		delete sources[i].view;
+	Py_XDECREF(list);
+	PyBuffer_Release(&dstView);
+	if (!ok) return NULL;
+	return PyLong_FromLongLong(maxEnd);
+}
+
+/*
+Loads a .wav file into float32 bytes: 8/16/24/32 bit PCM or float, unknown
+chunks skipped. Returns {nframes, nchannels, frames, framerate}, or None for
+the formats it doesn't handle.
+*/
+static PyObject* LoadWavF32(PyObject *self, PyObject *args)
+{
+	const char* filename;
+	if (!PyArg_ParseTuple(args, "s", &filename))
+		return NULL;
+
+	MappedFile file;
+	if (!file.Open(filename))
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename);
+
+	WavFileInfo info;
+	if (!ParseWavFile(file.Data(), file.Size(), info) || !WavFileFormatSupported(info))
+		Py_RETURN_NONE;
+
+	size_t count = info.numFrames * info.numChannels;
+	PyObject* frames = PyBytes_FromStringAndSize(nullptr, (Py_ssize_t)(count * sizeof(float)));
+	if (frames == NULL) return NULL;
+	float* out = (float*)PyBytes_AsString(frames);
+	Py_BEGIN_ALLOW_THREADS
+	WavFileToF32(info, out);
+	Py_END_ALLOW_THREADS
+
+	PyObject* ret = PyDict_New();
+	PyObject* o;
+	o = PyLong_FromSize_t(info.numFrames);
+	PyDict_SetItemString(ret, "nframes", o);
+	Py_DECREF(o);
+	o = PyLong_FromUnsignedLong(info.numChannels);
+	PyDict_SetItemString(ret, "nchannels", o);
+	Py_DECREF(o);
+	PyDict_SetItemString(ret, "frames", frames);
+	Py_DECREF(frames);
+	o = PyLong_FromUnsignedLong(info.sampleRate);
+	PyDict_SetItemString(ret, "framerate", o);
+	Py_DECREF(o);
+	return ret;
+}
+
+// name of the kernel version picked for this CPU: "scalar", "sse2", "avx2" or "avx512"
+static PyObject* WavKernelsISA(PyObject *self, PyObject *args)
+{
+	return PyUnicode_FromString(WavKernels().isa);
+}
+
 static PyMethodDef s_Methods[] = {
 	{
 		"S16ToF32",
@@ -145,6 +305,24 @@ static PyMethodDef s_Methods[] = {
 		METH_VARARGS,
 		""
 	},
+	{
+		"MixF32Into",
+		MixF32Into,
+		METH_VARARGS,
+		""
+	},
+	{
+		"LoadWavF32",
+		LoadWavF32,
+		METH_VARARGS,
+		""
+	},
+	{
+		"WavKernelsISA",
+		WavKernelsISA,
+		METH_VARARGS,
+		""
+	},
 	{ NULL, NULL, 0, NULL }
 };
 
@@ -159,5 +337,6 @@ static struct PyModuleDef cModPyDem =
 
 PyMODINIT_FUNC PyInit_PyWavUtils(void)
 {
+	WavKernels();
 	return PyModule_Create(&cModPyDem);
 }
@@ -1,12 +1,18 @@
 from .PyWavUtils import S16ToF32
 from .PyWavUtils import F32ToS16
 from .PyWavUtils import MaxValueF32
+from .PyWavUtils import MixF32Into
+from .PyWavUtils import LoadWavF32
 
 from .UTAUUtils import LoadFrq as LoadFrqUTAU
 from .UTAUUtils import LoadOtoINIPath as LoadOtoINIPathUTAU
 from .UTAUUtils import LoadPrefixMap as LoadPrefixMapUTAU
 from .UTAUUtils import LookUpPrefixMap as LookUpPrefixMapUTAU
 from .UTAUUtils import VoiceBank as VoiceBankUTAU
+from .UTAUUtils import LoadWav as LoadWavUTAU
+from .UTAUUtils import SetWavCacheBudget as SetWavCacheBudgetUTAU
+from .UTAUUtils import ClearWavCache as ClearWavCacheUTAU
+from .UTAUUtils import WavCacheInfo as WavCacheInfoUTAU
 
 from .TrackBuffer import setDefaultNumberOfChannels
 from .TrackBuffer import TrackBuffer
@@ -24,8 +30,25 @@ from .VoiceSampler import GenerateSentenceCUDA
 
 from . import VoiceSampler
 
-def DetectFrqVoice(wavF32, interval=256):
-	return VoiceSampler.DetectFrq(wavF32,interval)
+def DetectFrqVoice(wavF32, interval=256, mode='fft'):
+	'''
+	mode -- 'fft': one FFT autocorrelation per frame
+	        'fast': same detector, frames are batched 2 per FFT with a cached plan and window
+	'''
+	return VoiceSampler.DetectFrq(wavF32,interval, mode)
+
+def DetectFrqBatchVoice(paths, interval=256, threads=0, write=True, returnData=False, mode='fast'):
+	'''
+	Pitch detection for a list of wav files, running on 'threads' threads (0: one per core).
+	mode -- see DetectFrqVoice()
+	paths -- list of wav file names, or of (wav file name, frq file name) tuples
+	write -- write UTAU .frq files (xxx.wav -> xxx_wav.frq unless given)
+	returnData -- return the data of each file as packed float64 (freq, dyn) pairs,
+	              which can be viewed with numpy.frombuffer(data).reshape(-1,2)
+	Returns a list of {interval, key, data, error} dicts, None for the files that cannot be read.
+	error is None, or a message when the frq file could not be written.
+	'''
+	return VoiceSampler.DetectFrqBatch(paths, interval, threads, write, returnData, mode)
 
 
 # Instrument Samplers
@@ -39,8 +62,11 @@ STEREO_UNWEAVED = 1
 MONO = 2
 
 from .SF2 import LoadSF2
+from .SF2 import SF2Bank
 from .SF2Presets import LoadPresets as LoadPresetsSF2
 from .SF2Synth import SynthNote as SynthNoteSF2
+from .SF2Synth import SF2Preset
+from .SF2Synth import RenderNotes as RenderNotesSF2
 
 from .SimpleInstruments import GeneratePureSin
 from .SimpleInstruments import GenerateSquare
@@ -48,10 +74,21 @@ from .SimpleInstruments import GenerateTriangle
 from .SimpleInstruments import GenerateSawtooth
 from .SimpleInstruments import GenerateNaivePiano
 from .SimpleInstruments import GenerateBottleBlow
+from .SimpleInstruments import GenerateNotes
+from .SimpleInstruments import GenerateWavetable
+from .SimpleInstruments import AddWavetable
+from .SimpleInstruments import DelWavetable
 
 from .BasicSamplers import DetectBaseFreq
 from .BasicSamplers import InstrumentSingleSample
 from .BasicSamplers import InstrumentMultiSample
+from .BasicSamplers import SamplerHandle
 from .BasicSamplers import PercussionSample
 
 from .KarplusStrong import KarplusStrongGenerate
+from .KarplusStrong import KarplusStrongGenerateNotes
+
+from .NoteCache import SetNoteCacheBudget
+from .NoteCache import SetNoteCacheDir
+from .NoteCache import ClearNoteCache
+from .NoteCache import NoteCacheInfo
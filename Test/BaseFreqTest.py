@@ -0,0 +1,37 @@
+#!/usr/bin/python3
+
+# Checks DetectBaseFreq on tones it used to misdetect, and that samples of the
+# same content get the same, cached, result
+
+import math
+import array
+import SingingGadgets as sg
+
+def makeSample(wave, freq, rate, nchannels = 1):
+	frames = array.array('f', [wave(freq * (i // nchannels) / rate) for i in range(rate * nchannels)])
+	return {'nframes': rate, 'nchannels': nchannels, 'frames': frames.tobytes(), 'framerate': rate}
+
+def saw(x):
+	return (x % 1.0) - 0.5
+
+def sine(x):
+	return 0.5 * math.sin(2.0 * math.pi * x)
+
+# a 220 Hz sawtooth was detected at 30 Hz, 60 Hz and 1500 Hz at 48 kHz at 1920 Hz and 30.6 Hz
+for wave, freq, rate, nchannels in [(saw, 220.0, 44100, 1), (saw, 220.0, 44100, 2), (sine, 60.0, 48000, 1), (sine, 1500.0, 48000, 1)]:
+	sample = makeSample(wave, freq, rate, nchannels)
+	sg.DetectBaseFreq(sample)
+	print('%s %g Hz, %d channels: %g Hz' % (wave.__name__, freq, nchannels, sample['basefreq']))
+	assert abs(sample['basefreq'] / freq - 1.0) < 0.02
+
+	# a new dict and frames object of the same content
+	again = makeSample(wave, freq, rate, nchannels)
+	sg.DetectBaseFreq(again)
+	assert again['basefreq'] == sample['basefreq']
+
+# the same frames at half the rate: not served from the cache
+sample = makeSample(saw, 220.0, 44100)
+sample['framerate'] = 22050
+sg.DetectBaseFreq(sample)
+print('saw 220 Hz read at 22050 Hz: %g Hz' % sample['basefreq'])
+assert abs(sample['basefreq'] / 110.0 - 1.0) < 0.02
@@ -0,0 +1,33 @@
+#!/usr/bin/python3
+
+# Compares the 'fast' pitch detector with the reference 'fft' one
+
+import time
+import SingingGadgets as sg
+
+wav = sg.LoadWavUTAU('fa.wav')
+
+for interval in [64, 256, 1024]:
+	t0 = time.time()
+	ref = sg.DetectFrqVoice(wav, interval, 'fft')
+	t1 = time.time()
+	fast = sg.DetectFrqVoice(wav, interval, 'fast')
+	t2 = time.time()
+
+	assert len(ref['data']) == len(fast['data'])
+
+	maxFreqErr = 0.0
+	maxDynErr = 0.0
+	mismatch = 0
+	for (f0, d0), (f1, d1) in zip(ref['data'], fast['data']):
+		if f0 != f1:
+			mismatch += 1
+		maxFreqErr = max(maxFreqErr, abs(f0 - f1) / f0)
+		maxDynErr = max(maxDynErr, abs(d0 - d1) / max(d0, 1e-6))
+
+	print('interval %d: %d frames, %d pitch mismatches, max rel. freq err %g, max rel. dyn err %g, key %f / %f, %.3fs -> %.3fs' %
+		(interval, len(ref['data']), mismatch, maxFreqErr, maxDynErr, ref['key'], fast['key'], t1 - t0, t2 - t1))
+
+	assert mismatch == 0
+	assert maxDynErr < 1e-4
+	assert abs(ref['key'] - fast['key']) < 1e-3
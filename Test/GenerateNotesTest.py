@@ -0,0 +1,44 @@
+#!/usr/bin/python3
+
+# Checks that GenerateNotes mixes the notes of the single note generators,
+# placed at the sample renderNotes() of an SF2Preset places them at
+
+import math
+import array
+import SingingGadgets as sg
+
+def floats(buf):
+	return array.array('f', buf)
+
+def rejected(func, *args):
+	try:
+		func(*args)
+	except ValueError:
+		return True
+	return False
+
+def single(onset, freq, duration):
+	return floats(sg.GeneratePureSin(freq, duration, 44100.0)['data'])
+
+def mix(notes):
+	begins = [int(onset * 44100.0 * 0.001 + 0.5) for onset, freq, duration in notes]
+	singles = [single(*note) for note in notes]
+	mixed = [0.0] * max(b + len(s) for b, s in zip(begins, singles))
+	for begin, note in zip(begins, singles):
+		for j, v in enumerate(note):
+			mixed[begin + j] += v
+	return mixed
+
+# a chord, and onsets that a float product rounds to the sample before
+for notes in [[(0.0, 261.63, 400.0), (50.0, 329.63, 300.0), (100.0, 392.0, 200.0)],
+	[(1071.78, 440.0, 50.0), (1200.17, 550.0, 50.0), (1313.39, 660.0, 50.0)]]:
+	res = floats(sg.GenerateNotes(sg.SimpleInstruments.PURE_SIN, notes, 44100.0)['data'])
+	mixed = mix(notes)
+	assert len(res) == len(mixed)
+	err = max(abs(u - v) for u, v in zip(res, mixed))
+	print('GenerateNotes: %d samples, max err %g' % (len(res), err))
+	assert err < 1e-5
+
+assert rejected(sg.GenerateNotes, sg.SimpleInstruments.PURE_SIN, [(-10.0, 440.0, 100.0)], 44100.0)
+assert rejected(sg.GenerateNotes, sg.SimpleInstruments.PURE_SIN, [(0.0, 440.0, -100.0)], 44100.0)
+assert rejected(sg.GenerateNotes, sg.SimpleInstruments.PURE_SIN, [(float('nan'), 440.0, 100.0)], 44100.0)
@@ -0,0 +1,42 @@
+#!/usr/bin/python3
+
+# Checks that KarplusStrongGenerateNotes mixes the plucks of
+# KarplusStrongGenerate() with the same seeds, placed at the sample
+# renderNotes() of an SF2Preset places notes at
+
+import array
+import SingingGadgets as sg
+
+def floats(buf):
+	return array.array('f', buf)
+
+def rejected(func, *args):
+	try:
+		func(*args)
+	except ValueError:
+		return True
+	return False
+
+def mix(plucks):
+	begins = [int(onset * 44100.0 * 0.001 + 0.5) for onset, freq, duration, seed in plucks]
+	singles = [floats(sg.KarplusStrongGenerate(freq, duration, 44100.0, 10000.0, 0.99, 0.99, seed)['data']) for onset, freq, duration, seed in plucks]
+	mixed = [0.0] * max(b + len(s) for b, s in zip(begins, singles))
+	for begin, note in zip(begins, singles):
+		for j, v in enumerate(note):
+			mixed[begin + j] += v
+	return mixed
+
+# two plucks, and onsets that a float product rounds to the sample before
+for plucks in [[(0.0, 220.0, 300.0, 7), (100.0, 330.0, 300.0, 8)],
+	[(1071.78, 220.0, 100.0, 1), (1200.17, 330.0, 100.0, 2), (1313.39, 440.0, 100.0, 3)]]:
+	res = floats(sg.KarplusStrongGenerateNotes(plucks, 44100.0, 10000.0, 0.99, 0.99)['data'])
+	mixed = mix(plucks)
+	assert len(res) == len(mixed)
+	err = max(abs(u - v) for u, v in zip(res, mixed))
+	print('KarplusStrongGenerateNotes: %d samples, max err %g' % (len(res), err))
+	assert err < 1e-5
+
+assert rejected(sg.KarplusStrongGenerateNotes, [(-1.0, 220.0, 300.0)], 44100.0, 10000.0, 0.99, 0.99)
+assert rejected(sg.KarplusStrongGenerateNotes, [(0.0, 220.0, -300.0)], 44100.0, 10000.0, 0.99, 0.99)
+assert rejected(sg.KarplusStrongGenerateNotes, [(0.0, 0.0, 300.0)], 44100.0, 10000.0, 0.99, 0.99)
+assert rejected(sg.KarplusStrongGenerateNotes, [(float('nan'), 220.0, 300.0)], 44100.0, 10000.0, 0.99, 0.99)
@@ -0,0 +1,32 @@
+#!/usr/bin/python3
+
+# Checks the gains, pans, offsets and clipping of MixF32Into, and the buffers it accepts
+
+import array
+import SingingGadgets as sg
+
+# MixF32Into: mono into mono, clipped at both ends, with gain
+dst = array.array('f', [1.0] * 8)
+src = array.array('f', [1.0, 2.0, 3.0, 4.0])
+end = sg.MixF32Into(dst, 1, [(src, 0.5, 0.0, -1), (src.tobytes(), 1.0, 0.0, 6)])
+assert end == 10
+assert list(dst) == [2.0, 2.5, 3.0, 1.0, 1.0, 1.0, 2.0, 3.0]
+
+# a stereo source panned into a stereo destination, and a mono one centered
+dst = array.array('f', [0.0] * 8)
+stereo = array.array('f', [1.0, 1.0, 2.0, 2.0])
+end = sg.MixF32Into(dst, 2, [(stereo, 1.0, 0.5, 1), (array.array('f', [4.0]), 0.25, 0.0, 0, 1)])
+assert end == 3
+assert list(dst) == [1.0, 1.0, 0.5, 1.5, 1.0, 3.0, 0.0, 0.0]
+
+# bytearrays go through a float32 memoryview, other formats are rejected
+raw = bytearray(16)
+assert sg.MixF32Into(memoryview(raw).cast('f'), 1, [(src,)]) == 4
+assert array.array('f', raw).tolist() == [1.0, 2.0, 3.0, 4.0]
+for bad in [raw, array.array('d', [0.0] * 4), array.array('i', [0] * 4)]:
+	try:
+		sg.MixF32Into(bad, 1, [(src,)])
+		assert False
+	except TypeError:
+		pass
+print('MixF32Into: ok')
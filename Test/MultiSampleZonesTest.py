@@ -0,0 +1,50 @@
+#!/usr/bin/python3
+
+# Checks the velocity layers and round-robin groups of InstrumentMultiSample,
+# and that it rejects frequencies no zone can be selected for
+
+import math
+import array
+import random
+import SingingGadgets as sg
+
+# so that every note is rendered
+sg.SetNoteCacheBudget(0)
+
+def makeSample(baseFreq, seed, **extra):
+	random.seed(seed)
+	frames = array.array('f', [0.5 * math.sin(2.0 * math.pi * baseFreq * i / 44100.0) + 0.1 * random.uniform(-1.0, 1.0) for i in range(22050)])
+	sample = {'nframes': 22050, 'nchannels': 1, 'frames': frames.tobytes(), 'framerate': 44100, 'basefreq': baseFreq}
+	sample.update(extra)
+	return sample
+
+def play(samples, freq, velocity = 1.0):
+	return sg.InstrumentMultiSample(samples, freq, 200.0, 44100.0, velocity)['data']
+
+# a note uses the lowest layer whose velocity is at or above its own
+soft = makeSample(440.0, 1, velocity = 0.5)
+loud = makeSample(440.0, 2)
+layered = sg.SamplerHandle([loud, soft])
+for velocity, sample in [(0.1, soft), (0.5, soft), (0.6, loud), (1.0, loud)]:
+	assert play(layered, 500.0, velocity) == play([makeSample(440.0, 1 if sample is soft else 2)], 500.0)
+print('velocity layers: selected by note velocity')
+
+# samples of a round-robin group are played in turn, each at its own pitch,
+# samples outside the group are still crossfaded by pitch
+rr = sg.SamplerHandle([makeSample(440.0, 3, round_robin = 0), makeSample(445.0, 4, round_robin = 0), makeSample(880.0, 5)])
+first = play([makeSample(440.0, 3)], 430.0)
+second = play([makeSample(445.0, 4)], 430.0)
+assert first != second
+assert [play(rr, 430.0) for i in range(4)] == [first, second, first, second]
+mixed = play(rr, 600.0)
+assert mixed in [play([makeSample(440.0, 3), makeSample(880.0, 5)], 600.0), play([makeSample(445.0, 4), makeSample(880.0, 5)], 600.0)]
+print('round-robin: alternates within the group')
+
+for samples in [layered, [soft, loud]]:
+	for freq in [float('nan'), float('inf'), 0.0, -440.0]:
+		try:
+			play(samples, freq)
+			assert False
+		except ValueError:
+			pass
+print('invalid frequencies: ValueError')
@@ -0,0 +1,76 @@
+#!/usr/bin/python3
+
+# Checks that notes served by the memory and disk tiers of the note cache are
+# the rendered ones, and that damaged disk entries are rendered again
+
+import os
+import math
+import array
+import shutil
+import tempfile
+import SingingGadgets as sg
+
+cacheDir = tempfile.mkdtemp()
+sg.SetNoteCacheDir(cacheDir)
+sg.ClearNoteCache()
+
+bank = sg.SF2Bank('florestan-subset.sf2')
+preset = sg.SF2Preset(bank, 0)
+
+def info():
+	return sg.NoteCacheInfo()['SF2']
+
+ref = preset.synthNote(60, 0.8, 44100)
+assert info()['misses'] == 1
+
+# memory tier
+hits = info()['hits']
+assert preset.synthNote(60, 0.8, 44100) == ref
+assert info()['hits'] == hits + 1
+
+# disk tier
+files = [os.path.join(cacheDir, f) for f in os.listdir(cacheDir)]
+assert len(files) == 1 and not files[0].endswith('.tmp')
+size = os.path.getsize(files[0])
+sg.ClearNoteCache()
+hits = info()['hits']
+assert preset.synthNote(60, 0.8, 44100) == ref
+assert info()['hits'] == hits + 1
+
+# truncated, or claiming more data than the file holds: a miss, written again
+with open(files[0], 'r+b') as f:
+	f.truncate(size // 2)
+sg.ClearNoteCache()
+misses = info()['misses']
+assert preset.synthNote(60, 0.8, 44100) == ref
+assert info()['misses'] == misses + 1
+assert os.path.getsize(files[0]) == size
+
+with open(files[0], 'ab') as f:
+	f.write(b'\0' * 16)
+sg.ClearNoteCache()
+misses = info()['misses']
+assert preset.synthNote(60, 0.8, 44100) == ref
+assert info()['misses'] == misses + 1
+assert os.path.getsize(files[0]) == size
+
+# basic samplers, keyed by the content of the sample
+def sample(scale):
+	frames = array.array('f', [scale * math.sin(i * 0.1) for i in range(4410)])
+	return {'nframes': 4410, 'nchannels': 1, 'frames': frames.tobytes(), 'framerate': 44100, 'basefreq': 700.0}
+
+def samplerInfo():
+	return sg.NoteCacheInfo()['BasicSamplers']
+
+ref = sg.InstrumentSingleSample(sample(0.5), 440.0, 100.0, 44100.0)
+hits = samplerInfo()['hits']
+assert sg.InstrumentSingleSample(sample(0.5), 440.0, 100.0, 44100.0) == ref
+assert samplerInfo()['hits'] == hits + 1
+misses = samplerInfo()['misses']
+assert sg.InstrumentSingleSample(sample(0.25), 440.0, 100.0, 44100.0) != ref
+assert samplerInfo()['misses'] == misses + 1
+
+print('NoteCache: ok')
+
+sg.SetNoteCacheDir(None)
+shutil.rmtree(cacheDir)
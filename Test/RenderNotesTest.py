@@ -0,0 +1,30 @@
+#!/usr/bin/python3
+
+# Checks that RenderNotesSF2 doesn't depend on the thread count and rejects invalid notes
+
+import SingingGadgets as sg
+
+def rejected(func, *args):
+	try:
+		func(*args)
+	except ValueError:
+		return True
+	return False
+
+bank = sg.SF2Bank('florestan-subset.sf2')
+
+# high keys are played from the half-rate sample levels
+notes = [(i * 37.0, 40 + (i * 7) % 70, 0.3 + (i % 5) * 0.15, 200.0 + (i % 4) * 150.0) for i in range(200)]
+
+for i in range(len(bank.presetList)):
+	preset = sg.SF2Preset(bank, i)
+	ref = preset.renderNotes(notes, sg.STEREO_INTERLEAVED, 44100.0, 0.0, 1)
+	for threads in [0, 2, 5]:
+		res = preset.renderNotes(notes, sg.STEREO_INTERLEAVED, 44100.0, 0.0, threads)
+		assert res == ref
+	print('preset %d: %d samples, same for 0, 1, 2 and 5 threads' % (i, ref[0]))
+
+	assert rejected(preset.renderNotes, [(-1.0, 60, 1.0, 100.0)])
+	assert rejected(preset.renderNotes, [(0.0, 60, 1.0, -100.0)])
+	assert rejected(preset.renderNotes, [(float('nan'), 60, 1.0, 100.0)])
+	assert rejected(preset.renderNotes, [(1e12, 60, 1.0, 100.0)])
@@ -0,0 +1,49 @@
+#!/usr/bin/python3
+
+# Checks that an SF2Bank pins the sample ranges of living presets, keeps the
+# released ones within the residency budget and reads evicted ones back
+
+import gc
+import SingingGadgets as sg
+
+bank = sg.SF2Bank('florestan-subset.sf2')
+info = bank.residencyInfo()
+assert info['resident'] == 0 and info['ranges'] == 0
+
+presets = [sg.SF2Preset(bank, i) for i in range(len(bank.presetList))]
+ref = presets[0].synthNote(60, 0.8, 20000)
+full = bank.residencyInfo()
+print('all presets:', full)
+assert full['resident'] > 0 and full['pinned'] == full['ranges']
+
+# living presets stay resident whatever the budget
+bank.setResidencyBudget(0)
+assert bank.residencyInfo()['resident'] == full['resident']
+
+del presets[1:]
+gc.collect()
+one = bank.residencyInfo()
+print('first preset only:', one)
+assert 0 < one['resident'] < full['resident'] and one['pinned'] == one['ranges']
+
+del presets
+gc.collect()
+info = bank.residencyInfo()
+assert info['resident'] == 0 and info['ranges'] == 0
+
+# evicted ranges are read back from the file
+preset = sg.SF2Preset(bank, 0)
+assert bank.residencyInfo()['resident'] == one['resident']
+assert preset.synthNote(60, 0.8, 20000) == ref
+
+# without a limit released ranges stay resident, unpinned
+bank.setResidencyBudget()
+del preset
+gc.collect()
+info = bank.residencyInfo()
+print('released, no limit:', info)
+assert info['resident'] == one['resident'] and info['pinned'] == 0
+
+# lowering the budget evicts them
+bank.setResidencyBudget(0)
+assert bank.residencyInfo()['resident'] == 0
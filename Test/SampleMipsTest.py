@@ -0,0 +1,66 @@
+#!/usr/bin/python3
+
+# Checks SF2 notes played 2 or more times faster than their sample rate, which
+# are read from the half-rate sample levels
+
+import math
+import copy
+import array
+import SingingGadgets as sg
+
+sf2 = sg.LoadSF2('florestan-subset.sf2')
+presets = sg.LoadPresetsSF2(sf2)
+
+# a preset of one region over a float32 pool, key 60 plays the pool at its rate
+def regionPreset(pool, numSamples, loop):
+	region = copy.deepcopy(presets[0]['regions'][0])
+	region.update({'loop_mode': 1 if loop else 0, 'sample_rate': 44100, 'lokey': 0, 'hikey': 127,
+		'offset': 0, 'end': numSamples, 'loop_start': loop[0] if loop else 0, 'loop_end': loop[1] if loop else 0,
+		'transpose': 0, 'tune': 0, 'pitch_keycenter': 60, 'attenuation': 0.0, 'vibLfoToPitch': 0, 'modLfoToPitch': 0})
+	region['ampenv'].update({'decay': 0.0, 'sustain': 1.0, 'release': 0.0})
+	return sg.SF2Preset(pool, {'presetName': 'test', 'bank': 0, 'preset': 0, 'regionNum': 1, 'regions': [region]})
+
+def sinePool(period, numSamples):
+	return array.array('f', [0.5 * math.sin(2.0 * math.pi * i / period) for i in range(numSamples)]).tobytes()
+
+def render(preset, key, numSamples):
+	return array.array('f', preset.synthNote(key, 1.0, numSamples, sg.MONO)[1])
+
+# amplitude of the sine of angular frequency w in x, and max distance of x to that sine
+def fitSine(x, w):
+	s = sum(v * math.sin(w * i) for i, v in enumerate(x)) * 2.0 / len(x)
+	c = sum(v * math.cos(w * i) for i, v in enumerate(x)) * 2.0 / len(x)
+	return math.hypot(s, c), max(abs(v - s * math.sin(w * i) - c * math.cos(w * i)) for i, v in enumerate(x))
+
+# a 441 Hz sine, looped over its last 50 periods, 1, 2 and 3 octaves up: clean
+# sines, also where the filter of the levels reads across the loop points
+looped = regionPreset(sinePool(100, 10000), 10000, (5000, 9999))
+for key in [72, 84, 96]:
+	x = render(looped, key, 44100)[2000:40000]
+	amp, err = fitSine(x, 2.0 * math.pi * 441.0 * 2.0 ** ((key - 60) / 12.0) / 44100.0)
+	print('looped sine, key %d: amplitude %f, max err %g' % (key, amp, err))
+	assert abs(amp - 0.5) < 0.005
+	assert err < 1e-4
+
+# a sine at 0.35 times the sample rate ends up above Nyquist: the levels filter it out
+high = regionPreset(sinePool(44100.0 / 15435.0, 20000), 20000, None)
+for key in [72, 79, 90]:
+	x = render(high, key, 4000)[500:3500]
+	rms = math.sqrt(sum(v * v for v in x) / len(x))
+	print('sine above Nyquist, key %d: rms %g' % (key, rms))
+	assert rms < 1e-3
+
+# the levels of the 16-bit bank and of its float32 copy
+bank = sg.SF2Bank('florestan-subset.sf2')
+for i in range(4):
+	fromBank = sg.SF2Preset(bank, i)
+	fromPool = sg.SF2Preset(sf2[1], presets[i])
+	for key in [96, 108, 120]:
+		a = fromBank.synthNote(key, 0.8, 20000)
+		b = fromPool.synthNote(key, 0.8, 20000)
+		assert a[0] == b[0]
+		if a[1] is None:
+			continue
+		err = max(abs(u - v) for u, v in zip(array.array('f', a[1]), array.array('f', b[1])))
+		assert err < 1e-5
+print('bank and float32 pool: same levels')
@@ -0,0 +1,44 @@
+#!/usr/bin/python3
+
+# Checks that InstrumentMultiSample plays a SamplerHandle as it plays the list
+# of sample dicts the handle was built from
+
+import gc
+import math
+import array
+import random
+import SingingGadgets as sg
+
+# so that every note is rendered
+sg.SetNoteCacheBudget(0)
+
+random.seed(2)
+def makeSample(baseFreq, nchannels = 1, numFrames = 22050):
+	frames = array.array('f', [0.5 * math.sin(2.0 * math.pi * baseFreq * (i // nchannels) / 44100.0) + 0.1 * random.uniform(-1.0, 1.0) for i in range(numFrames * nchannels)])
+	return {'nframes': numFrames, 'nchannels': nchannels, 'frames': frames.tobytes(), 'framerate': 44100, 'basefreq': baseFreq}
+
+samples = [makeSample(f) for f in [220.0, 440.0, 880.0]]
+handle = sg.SamplerHandle(samples)
+
+# below, at, between and above the sample pitches
+freqs = [110.0, 220.0, 300.0, 440.0, 600.0, 880.0, 2000.0]
+ref = [sg.InstrumentMultiSample(samples, f, 300.0, 44100.0)['data'] for f in freqs]
+for f, data in zip(freqs, ref):
+	assert max(abs(v) for v in array.array('f', data)) > 0.0
+	assert sg.InstrumentMultiSample(handle, f, 300.0, 44100.0)['data'] == data
+print('handle and list: same output at %d pitches' % len(freqs))
+
+# the handle keeps the frames it plays alive
+handle2 = sg.SamplerHandle([makeSample(f) for f in [220.0, 440.0, 880.0]])
+ref2 = sg.InstrumentMultiSample(handle2, 300.0, 300.0, 44100.0)['data']
+gc.collect()
+random.seed(3)
+makeSample(440.0)
+assert sg.InstrumentMultiSample(handle2, 300.0, 300.0, 44100.0)['data'] == ref2
+
+# samples with different channel counts are rejected
+try:
+	sg.SamplerHandle([makeSample(220.0), makeSample(440.0, 2)])
+	assert False
+except ValueError:
+	print('channel mismatch: ValueError')
@@ -0,0 +1,44 @@
+#!/usr/bin/python3
+
+# Compares the samplers playing a sample 2 or more times faster with the box
+# filter they always used, evaluated here with the same float32 rounding
+
+import math
+import array
+import struct
+import random
+import SingingGadgets as sg
+
+def f32(x):
+	return struct.unpack('f', struct.pack('f', x))[0]
+
+random.seed(1)
+numFrames = 44100
+frames = array.array('f', [0.6 * math.sin(2.0 * math.pi * 440.0 * i / 44100.0) + 0.3 * random.uniform(-1.0, 1.0) for i in range(numFrames)])
+maxV = f32(max(abs(v) for v in frames))
+sample = {'nframes': numFrames, 'nchannels': 1, 'frames': frames.tobytes(), 'framerate': 44100, 'basefreq': 440.0, 'maxv': maxV}
+
+# output frame j averages the source frames in [(j-0.5)*sampleFreq/originFreq, (j+0.5)*sampleFreq/originFreq]
+def reference(freq, duration):
+	sampleFreq = f32(f32(freq) / 44100.0)
+	originFreq = f32(440.0 / 44100.0)
+	length = int(math.ceil(f32(f32(duration) * 44100.0 * f32(0.001))))
+	count = min(length, int(f32(f32(numFrames * originFreq) / sampleFreq)))
+	out = [0.0] * length
+	for j in range(count):
+		ipos1 = max(int(math.ceil(f32(f32(f32(j - 0.5) * sampleFreq) / originFreq))), 0)
+		ipos2 = min(int(math.floor(f32(f32(f32(j + 0.5) * sampleFreq) / originFreq))), numFrames - 1)
+		amplitude = 1.0 - math.exp((j / length - 1.0) * 10.0)
+		out[j] = amplitude * sum(frames[ipos1:ipos2 + 1]) / (ipos2 - ipos1 + 1) / maxV
+	return out
+
+for ratio in [2.0, 2.5, 4.0]:
+	ref = reference(440.0 * ratio, 400.0)
+	peak = max(abs(v) for v in ref)
+	for name, res in [('single', sg.InstrumentSingleSample(sample, 440.0 * ratio, 400.0, 44100.0)),
+		('multi', sg.InstrumentMultiSample([sample], 440.0 * ratio, 400.0, 44100.0))]:
+		out = array.array('f', res['data'])
+		assert len(out) == len(ref)
+		err = max(abs(u - v) for u, v in zip(out, ref))
+		print('ratio %g, %s: max err %g, peak %g' % (ratio, name, err, peak))
+		assert err < 1e-5 * peak
@@ -0,0 +1,60 @@
+#!/usr/bin/python3
+
+# Checks the .wav round trip of each sample format, and that failed writes raise OSError
+
+import os
+import math
+import array
+import tempfile
+import SingingGadgets as sg
+
+def maxDiff(a, b):
+	assert len(a) == len(b)
+	return max(abs(x - y) for x, y in zip(a, b))
+
+# .wav round trip, a stereo 441 Hz tone through a TrackBuffer
+numFrames = 4410
+frames = array.array('f')
+for i in range(numFrames):
+	v = 0.8 * math.sin(2.0 * math.pi * 441.0 * i / 44100.0)
+	frames.extend([v, -0.5 * v])
+
+track = sg.TrackBuffer(2)
+track.writeBlend({'sample_rate': 44100.0, 'num_channels': 2, 'data': frames.tobytes(), 'align_pos': 0, 'volume': 1.0, 'pan': 0.0})
+
+# files are written normalized to the peak of the track
+peak = max(abs(v) for v in frames)
+expected = array.array('f', [v / peak for v in frames])
+
+tmpDir = tempfile.mkdtemp()
+for fmt, tolerance in [('s16', 0.5 / 32767.0 + 1e-7), ('s24', 0.5 / 8388607.0 + 1e-7), ('f32', 1e-6)]:
+	path = os.path.join(tmpDir, 'roundtrip_%s.wav' % fmt)
+	sg.WriteTrackBufferToWav(track, path, fmt)
+	wav = sg.LoadWavF32(path)
+	assert wav['nframes'] == numFrames and wav['nchannels'] == 2 and wav['framerate'] == 44100
+	err = maxDiff(array.array('f', wav['frames']), expected)
+	assert err <= tolerance
+
+	# and back into a TrackBuffer, written again as float
+	reread = sg.TrackBuffer(2)
+	sg.ReadTrackBufferFromWav(reread, path)
+	assert reread.getNumberOfSamples() == numFrames
+	path2 = os.path.join(tmpDir, 'reread_%s.wav' % fmt)
+	sg.WriteTrackBufferToWav(reread, path2, 'f32')
+	assert sg.LoadWavF32(path2)['frames'] == wav['frames']
+	os.remove(path)
+	os.remove(path2)
+	print('%s round trip: max err %g' % (fmt, err))
+os.rmdir(tmpDir)
+
+# a missing directory fails to open, a full device fails to write or to close
+paths = [os.path.join(tmpDir, 'missing', 'out.wav')]
+if os.path.exists('/dev/full'):
+	paths.append('/dev/full')
+for path in paths:
+	for fmt in ['s16', 's24', 'f32']:
+		try:
+			sg.WriteTrackBufferToWav(track, path, fmt)
+			assert False
+		except OSError as e:
+			print('%s: %s' % (fmt, e))
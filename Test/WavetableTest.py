@@ -0,0 +1,39 @@
+#!/usr/bin/python3
+
+# Checks the built-in sine wavetable, a user table of one sine period, and the
+# deletion of user tables
+
+import math
+import array
+import SingingGadgets as sg
+
+def floats(buf):
+	return array.array('f', buf)
+
+def rejected(func, *args):
+	try:
+		func(*args)
+	except ValueError:
+		return True
+	return False
+
+sine = floats(sg.GenerateWavetable(sg.SimpleInstruments.WT_SINE, 441.0, 100.0, 44100.0)['data'])
+err = max(abs(v - math.sin(2.0 * math.pi * 441.0 * j / 44100.0)) for j, v in enumerate(sine))
+table = sg.AddWavetable([math.sin(2.0 * math.pi * j / 64) for j in range(64)])
+user = floats(sg.GenerateWavetable(table, 441.0, 100.0, 44100.0)['data'])
+diff = max(abs(u - v) for u, v in zip(sine, user))
+print('Wavetable: max err %g, user table max diff %g' % (err, diff))
+assert err < 1e-4
+assert diff < 1e-5
+
+# a deleted table can't be played, its id isn't reused
+sg.DelWavetable(table)
+assert rejected(sg.GenerateWavetable, table, 441.0, 100.0, 44100.0)
+assert rejected(sg.DelWavetable, table)
+assert sg.AddWavetable([0.0, 1.0, 0.0, -1.0]) != table
+
+# built-in tables stay
+assert rejected(sg.DelWavetable, sg.SimpleInstruments.WT_SINE)
+assert floats(sg.GenerateWavetable(sg.SimpleInstruments.WT_SINE, 441.0, 100.0, 44100.0)['data']) == sine
+assert rejected(sg.DelWavetable, 1000000)
+print('DelWavetable: deleted tables are rejected, built-in ones kept')
@@ -8,19 +8,24 @@ with open(os.path.join(here, 'README.md'), encoding='utf-8') as f:
     long_description = f.read()
 
 extra_compile_args=[]
+extra_link_args=[]
 if os.name != 'nt':
-	extra_compile_args = ['-std=c++11']
+	extra_compile_args = ['-std=c++11', '-pthread']
+	extra_link_args = ['-pthread']
 
 WavUtils_Src=[
+	'CPPUtils/DSPUtil/WavKernels.cpp',
 	'SingingGadgets/WavUtils/WavUtils.cpp',	
 ]
 
 module_WavUtils = Extension(
 	'SingingGadgets.PyWavUtils',
 	sources = WavUtils_Src,
+	include_dirs = ['CPPUtils/General', 'CPPUtils/DSPUtil'],
 	extra_compile_args=extra_compile_args)
 
 TrackBuffer_Src=[
+	'CPPUtils/DSPUtil/WavKernels.cpp',
 	'SingingGadgets/TrackBuffer/ReadWav.cpp',
 	'SingingGadgets/TrackBuffer/WriteWav.cpp',
 	'SingingGadgets/TrackBuffer/TrackBuffer.cpp',
@@ -29,7 +34,8 @@ TrackBuffer_Src=[
 
 TrackBuffer_IncludeDirs=[
 	'SingingGadgets/TrackBuffer',
-	'CPPUtils/General'
+	'CPPUtils/General',
+	'CPPUtils/DSPUtil'
 ]
 
 module_TrackBuffer = Extension(
@@ -38,12 +44,34 @@ module_TrackBuffer = Extension(
 	include_dirs = TrackBuffer_IncludeDirs,
 	extra_compile_args=extra_compile_args)
 
+UTAUUtils_Src=[
+	'CPPUtils/DSPUtil/WavKernels.cpp',
+	'SingingGadgets/UTAUUtils/VoiceBankIndex.cpp',
+	'SingingGadgets/UTAUUtils/WavCache.cpp',
+	'SingingGadgets/UTAUUtils/UTAUUtils_Module.cpp'
+]
+
+UTAUUtils_IncludeDirs=[
+	'SingingGadgets/UTAUUtils',
+	'CPPUtils/General',
+	'CPPUtils/DSPUtil'
+]
+
+module_UTAUUtils = Extension(
+	'SingingGadgets.PyUTAUUtils',
+	sources = UTAUUtils_Src,
+	include_dirs = UTAUUtils_IncludeDirs,
+	extra_compile_args=extra_compile_args)
+
 VoiceSampler_Src=[
 	'CPPUtils/DSPUtil/complex.cpp',
 	'CPPUtils/DSPUtil/fft.cpp',
+	'CPPUtils/DSPUtil/fftplan.cpp',
+	'CPPUtils/DSPUtil/WavKernels.cpp',
 	'SingingGadgets/VoiceSampler/VoiceSampler.cpp',
 	'SingingGadgets/VoiceSampler/SentenceGeneratorGeneral.cpp',
 	'SingingGadgets/VoiceSampler/SentenceGeneratorCPU.cpp',
+	'SingingGadgets/VoiceSampler/SentenceGeneratorDraft.cpp',
 	'SingingGadgets/VoiceSampler/FrequencyDetection.cpp'
 ]
 
@@ -57,14 +85,19 @@ module_VoiceSampler = Extension(
 	'SingingGadgets.PyVoiceSampler',
 	sources = VoiceSampler_Src,
 	include_dirs = VoiceSampler_IncludeDirs,
-	extra_compile_args=extra_compile_args)
+	extra_compile_args=extra_compile_args,
+	extra_link_args=extra_link_args)
 
 SF2Synth_Src=[
 	'SingingGadgets/SF2Synth/SF2Synth_Module.cpp',
 	'SingingGadgets/SF2Synth/SF2Synth.cpp',
+	'SingingGadgets/SF2Synth/SF2Bank.cpp',
+	'SingingGadgets/SF2Synth/SF2CompiledPreset.cpp',
+	'SingingGadgets/SF2Synth/SampleMips.cpp',
 	'SingingGadgets/SF2Synth/Synth.cpp']
 
 SF2Synth_IncludeDirs=[
+	'CPPUtils/General',
 	'SingingGadgets/SF2Synth'
 ]
 
@@ -72,21 +105,25 @@ module_SF2Synth = Extension(
 	'SingingGadgets.PySF2Synth',
 	sources = SF2Synth_Src,
 	include_dirs = SF2Synth_IncludeDirs,
-	extra_compile_args=extra_compile_args)
+	extra_compile_args=extra_compile_args,
+	extra_link_args=extra_link_args)
 
 module_SimpleInstruments = Extension(
 	'SingingGadgets.PySimpleInstruments',
-	sources = ['SingingGadgets/SimpleInstruments/SimpleInstruments.cpp'],
+	sources = ['SingingGadgets/SimpleInstruments/SimpleInstruments.cpp', 'SingingGadgets/SimpleInstruments/Oscillators.cpp', 'SingingGadgets/SimpleInstruments/Wavetable.cpp'],
 	include_dirs = ['CPPUtils/General'],
 	extra_compile_args=extra_compile_args)
 
 BasicSamplers_Src=[
 	'CPPUtils/DSPUtil/complex.cpp',
 	'CPPUtils/DSPUtil/fft.cpp',
+	'CPPUtils/DSPUtil/fftplan.cpp',
 	'SingingGadgets/BasicSamplers/BasicSamplers.cpp',
 	'SingingGadgets/BasicSamplers/PercussionSampler.cpp',
 	'SingingGadgets/BasicSamplers/InstrumentSingleSampler.cpp',
 	'SingingGadgets/BasicSamplers/InstrumentMultiSampler.cpp',
+	'SingingGadgets/BasicSamplers/InstrumentSampleSet.cpp',
+	'SingingGadgets/BasicSamplers/SampleRenderer.cpp',
 	'SingingGadgets/BasicSamplers/FrequencyDetection.cpp'
 ]
 
@@ -100,7 +137,8 @@ module_BasicSamplers = Extension(
 	'SingingGadgets.PyBasicSamplers',
 	sources = BasicSamplers_Src,
 	include_dirs = BasicSamplers_IncludeDirs,
-	extra_compile_args=extra_compile_args)
+	extra_compile_args=extra_compile_args,
+	extra_link_args=extra_link_args)
 
 MeteorGenerator_Src=[
 	'ScoreDraft/MeteorGenerator/MeteorGenerator.cpp',	
@@ -140,6 +178,7 @@ setup(
 	ext_modules=[
 		module_WavUtils, 
 		module_TrackBuffer, 
+		module_UTAUUtils,
 		module_VoiceSampler, 
 		module_SF2Synth, 
 		module_SimpleInstruments, 